@@ -0,0 +1,315 @@
+#include "BatchSolver.h"
+#include "Solver.h"		// LIN_SOLVE_ITERATIONS, the scalar solver's sweeps
+#include "Profiler.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Cell (i,j) of a group, its BATCH_LANES instances follow each other
+#define BX(i,j) (((i)+(N+2)*(j))*BATCH_LANES)
+#define FOR_EACH_LANE for ( l=0 ; l<BATCH_LANES ; l++ )
+
+////////////////////////////////////////////////////////////////
+// Batched Kernels
+// The scalar solver with every operation repeated across the lanes, in the same order, so
+// each lane rounds exactly like a scalar run. a/c/diff are per lane.
+
+static void batch_add_source ( int N, float * RESTRICT x, const float * RESTRICT s, float dt )
+{
+	int i, size=(N+2)*(N+2)*BATCH_LANES;
+	for ( i=0 ; i<size ; i++ ) x[i] += dt*s[i];
+}
+
+static void batch_set_bnd ( int N, int b, float * x )
+{
+	int i, l;
+	float sx = b==1 ? -1.0f : 1.0f;
+	float sy = b==2 ? -1.0f : 1.0f;
+
+	for ( i=1 ; i<=N ; i++ ) {
+		FOR_EACH_LANE {
+			x[BX(i,0  )+l] = sy*x[BX(i,1)+l];
+			x[BX(i,N+1)+l] = sy*x[BX(i,N)+l];
+			x[BX(0  ,i)+l] = sx*x[BX(1,i)+l];
+			x[BX(N+1,i)+l] = sx*x[BX(N,i)+l];
+		}
+	}
+	FOR_EACH_LANE {
+		x[BX(0  ,0  )+l] = 0.5f*(x[BX(1,0  )+l]+x[BX(0  ,1)+l]);
+		x[BX(0  ,N+1)+l] = 0.5f*(x[BX(1,N+1)+l]+x[BX(0  ,N)+l]);
+		x[BX(N+1,0  )+l] = 0.5f*(x[BX(N,0  )+l]+x[BX(N+1,1)+l]);
+		x[BX(N+1,N+1)+l] = 0.5f*(x[BX(N,N+1)+l]+x[BX(N+1,N)+l]);
+	}
+}
+
+static void batch_lin_solve ( int N, int b, float * RESTRICT x, const float * RESTRICT x0, const float * a, const float * c )
+{
+	int i, j, k, l;
+
+	for ( k=0 ; k<LIN_SOLVE_ITERATIONS ; k++ ) {
+		for ( j=1 ; j<=N ; j++ ) {
+			for ( i=1 ; i<=N ; i++ ) {
+				float * RESTRICT xc = x + BX(i,j);
+				const float * xl = x + BX(i-1,j), * xr = x + BX(i+1,j);
+				const float * xu = x + BX(i,j-1), * xd = x + BX(i,j+1);
+				const float * xs = x0 + BX(i,j);
+				FOR_EACH_LANE
+					xc[l] = (xs[l] + a[l]*(xl[l]+xr[l]+xu[l]+xd[l]))/c[l];
+			}
+		}
+		batch_set_bnd ( N, b, x );
+	}
+}
+
+static void batch_diffuse ( int N, int b, float * x, float * x0, const float * diff, float dt )
+{
+	int l;
+	float a[BATCH_LANES], c[BATCH_LANES];
+
+	FOR_EACH_LANE {
+		a[l] = dt*diff[l]*N*N;
+		c[l] = 1+4*a[l];
+	}
+	batch_lin_solve ( N, b, x, x0, a, c );
+}
+
+static void batch_advect ( int N, int b, float * RESTRICT d, const float * RESTRICT d0, const float * u, const float * v, float dt )
+{
+	int i, j, l, i0, j0, i1, j1;
+	float x, y, s0, t0, s1, t1, dt0;
+
+	dt0 = dt*N;
+	for ( j=1 ; j<=N ; j++ ) {
+		for ( i=1 ; i<=N ; i++ ) {
+			FOR_EACH_LANE {
+				x = i-dt0*u[BX(i,j)+l]; y = j-dt0*v[BX(i,j)+l];
+				if (x<0.5f) x=0.5f; if (x>N+0.5f) x=N+0.5f; i0=(int)x; i1=i0+1;
+				if (y<0.5f) y=0.5f; if (y>N+0.5f) y=N+0.5f; j0=(int)y; j1=j0+1;
+				s1 = x-i0; s0 = 1-s1; t1 = y-j0; t0 = 1-t1;
+				d[BX(i,j)+l] = s0*(t0*d0[BX(i0,j0)+l]+t1*d0[BX(i0,j1)+l])+
+							   s1*(t0*d0[BX(i1,j0)+l]+t1*d0[BX(i1,j1)+l]);
+			}
+		}
+	}
+	batch_set_bnd ( N, b, d );
+}
+
+static void batch_project ( int N, float * RESTRICT u, float * RESTRICT v, float * RESTRICT p, float * RESTRICT div )
+{
+	int i, j, l;
+	float one[BATCH_LANES], four[BATCH_LANES];
+
+	for ( j=1 ; j<=N ; j++ ) {
+		for ( i=1 ; i<=N ; i++ ) {
+			FOR_EACH_LANE {
+				div[BX(i,j)+l] = -0.5f*(u[BX(i+1,j)+l]-u[BX(i-1,j)+l]+v[BX(i,j+1)+l]-v[BX(i,j-1)+l])/N;
+				p[BX(i,j)+l] = 0;
+			}
+		}
+	}
+	batch_set_bnd ( N, 0, div ); batch_set_bnd ( N, 0, p );
+
+	FOR_EACH_LANE {
+		one[l]  = 1;
+		four[l] = 4;
+	}
+	batch_lin_solve ( N, 0, p, div, one, four );
+
+	for ( j=1 ; j<=N ; j++ ) {
+		for ( i=1 ; i<=N ; i++ ) {
+			FOR_EACH_LANE {
+				u[BX(i,j)+l] -= 0.5f*N*(p[BX(i+1,j)+l]-p[BX(i-1,j)+l]);
+				v[BX(i,j)+l] -= 0.5f*N*(p[BX(i,j+1)+l]-p[BX(i,j-1)+l]);
+			}
+		}
+	}
+	batch_set_bnd ( N, 1, u ); batch_set_bnd ( N, 2, v );
+}
+
+////////////////////////////////////////////////////////////////
+// CBatchSolver
+
+CBatchSolver::CBatchSolver(int N, int K)
+{
+	m_N		 = N;
+	m_K		 = K;
+	m_groups = (K + BATCH_LANES - 1) / BATCH_LANES;
+	m_cells	 = (N+2)*(N+2);
+
+	int size  = m_groups*m_cells*BATCH_LANES;
+	int lanes = m_groups*BATCH_LANES;
+
+	m_u = m_v = m_u_prev = m_v_prev = m_dens = m_dens_prev = 0;
+	m_diff = m_visc = m_force = m_source = 0;
+	m_stats = 0;
+
+	m_u			= (float *) malloc ( size*sizeof(float) );
+	m_v			= (float *) malloc ( size*sizeof(float) );
+	m_u_prev	= (float *) malloc ( size*sizeof(float) );
+	m_v_prev	= (float *) malloc ( size*sizeof(float) );
+	m_dens		= (float *) malloc ( size*sizeof(float) );
+	m_dens_prev	= (float *) malloc ( size*sizeof(float) );
+
+	m_diff		= (float *) calloc ( lanes, sizeof(float) );
+	m_visc		= (float *) calloc ( lanes, sizeof(float) );
+	m_force		= (float *) calloc ( lanes, sizeof(float) );
+	m_source	= (float *) calloc ( lanes, sizeof(float) );
+	m_stats		= (tBatchStats *) calloc ( lanes, sizeof(tBatchStats) );
+
+	if ( !m_u || !m_v || !m_u_prev || !m_v_prev || !m_dens || !m_dens_prev ||
+		 !m_diff || !m_visc || !m_force || !m_source || !m_stats ) {
+		freeData();
+		return;
+	}
+
+	clear();
+}
+
+CBatchSolver::~CBatchSolver(void)
+{
+	freeData();
+}
+
+void CBatchSolver::freeData(void)
+{
+	if ( m_u ) free ( m_u );
+	if ( m_v ) free ( m_v );
+	if ( m_u_prev ) free ( m_u_prev );
+	if ( m_v_prev ) free ( m_v_prev );
+	if ( m_dens )   free ( m_dens );
+	if ( m_dens_prev ) free ( m_dens_prev );
+	if ( m_diff )   free ( m_diff );
+	if ( m_visc )   free ( m_visc );
+	if ( m_force )  free ( m_force );
+	if ( m_source ) free ( m_source );
+	if ( m_stats )  free ( m_stats );
+	m_u = m_v = m_u_prev = m_v_prev = m_dens = m_dens_prev = 0;
+	m_diff = m_visc = m_force = m_source = 0;
+	m_stats = 0;
+}
+
+void CBatchSolver::setParams(int k, const tBatchParams &params)
+{
+	m_diff[k]	= params.diff;
+	m_visc[k]	= params.visc;
+	m_force[k]	= params.force;
+	m_source[k] = params.source;
+}
+
+void CBatchSolver::clear(void)
+{
+	size_t bytes = (size_t)m_groups*m_cells*BATCH_LANES*sizeof(float);
+
+	memset ( m_u, 0, bytes );		memset ( m_v, 0, bytes );
+	memset ( m_u_prev, 0, bytes );	memset ( m_v_prev, 0, bytes );
+	memset ( m_dens, 0, bytes );	memset ( m_dens_prev, 0, bytes );
+}
+
+// Lane k of cell (i,j) in its group
+#define LANE(k,i,j) ((size_t)((k)/BATCH_LANES)*m_cells*BATCH_LANES + ((i)+(m_N+2)*(j))*BATCH_LANES + (k)%BATCH_LANES)
+
+void CBatchSolver::splat(int i, int j, float density, float du, float dv)
+{
+	for(int k = 0; k < m_K; k++)
+	{
+		m_dens_prev[LANE(k,i,j)] += m_source[k] * density;
+		m_u_prev[LANE(k,i,j)]	 += m_force[k] * du;
+		m_v_prev[LANE(k,i,j)]	 += m_force[k] * dv;
+	}
+}
+
+void CBatchSolver::addDensity(int k, int i, int j, float amount)
+{
+	m_dens_prev[LANE(k,i,j)] += amount;
+}
+
+void CBatchSolver::addVelocity(int k, int i, int j, float du, float dv)
+{
+	m_u_prev[LANE(k,i,j)] += du;
+	m_v_prev[LANE(k,i,j)] += dv;
+}
+
+void CBatchSolver::getDensity(int k, float *out) const
+{
+	for(int c = 0; c < m_cells; c++)
+		out[c] = m_dens[(size_t)(k/BATCH_LANES)*m_cells*BATCH_LANES + c*BATCH_LANES + k%BATCH_LANES];
+}
+
+void CBatchSolver::step(float dt)
+{
+	int g;
+
+	#pragma omp parallel for schedule(dynamic)
+	for ( g=0 ; g<m_groups ; g++ ) {
+		stepGroup(g, dt);
+		gatherStats(g, dt);
+	}
+}
+
+// vel_step then dens_step, exactly as the demo's idle()
+void CBatchSolver::stepGroup(int group, float dt)
+{
+	PROFILE_ZONE("batch group");
+	int N = m_N;
+	size_t base = (size_t)group*m_cells*BATCH_LANES;
+	float *u  = m_u + base,		 *v  = m_v + base;
+	float *u0 = m_u_prev + base, *v0 = m_v_prev + base;
+	float *x  = m_dens + base,	 *x0 = m_dens_prev + base;
+	const float *visc = m_visc + group*BATCH_LANES;
+	const float *diff = m_diff + group*BATCH_LANES;
+
+	// vel_step
+	batch_add_source ( N, u, u0, dt ); batch_add_source ( N, v, v0, dt );
+	SWAP ( u0, u ); batch_diffuse ( N, 1, u, u0, visc, dt );
+	SWAP ( v0, v ); batch_diffuse ( N, 2, v, v0, visc, dt );
+	batch_project ( N, u, v, u0, v0 );
+	SWAP ( u0, u ); SWAP ( v0, v );
+	batch_advect ( N, 1, u, u0, u0, v0, dt ); batch_advect ( N, 2, v, v0, u0, v0, dt );
+	batch_project ( N, u, v, u0, v0 );
+
+	// dens_step
+	batch_add_source ( N, x, x0, dt );
+	SWAP ( x0, x ); batch_diffuse ( N, 0, x, x0, diff, dt );
+	SWAP ( x0, x ); batch_advect ( N, 0, x, x0, u, v, dt );
+
+	// The sources were used as scratch, start the next step from none
+	size_t bytes = (size_t)m_cells*BATCH_LANES*sizeof(float);
+	memset ( m_u_prev + base, 0, bytes );
+	memset ( m_v_prev + base, 0, bytes );
+	memset ( m_dens_prev + base, 0, bytes );
+}
+
+void CBatchSolver::gatherStats(int group, float dt)
+{
+	PROFILE_ZONE("batch stats");
+	int N = m_N;
+	int i, j, l;
+	size_t base = (size_t)group*m_cells*BATCH_LANES;
+	const float *u = m_u + base, *v = m_v + base, *d = m_dens + base;
+	double mass[BATCH_LANES], div2[BATCH_LANES];
+	float speed2[BATCH_LANES];
+
+	FOR_EACH_LANE {
+		mass[l] = div2[l] = 0.0;
+		speed2[l] = 0.0f;
+	}
+	for ( j=1 ; j<=N ; j++ ) {
+		for ( i=1 ; i<=N ; i++ ) {
+			FOR_EACH_LANE {
+				float uu = u[BX(i,j)+l], vv = v[BX(i,j)+l];
+				float dv = 0.5f*N*(u[BX(i+1,j)+l]-u[BX(i-1,j)+l]+v[BX(i,j+1)+l]-v[BX(i,j-1)+l]);
+				mass[l] += d[BX(i,j)+l];
+				div2[l] += dv*dv;
+				if ( uu*uu+vv*vv > speed2[l] ) speed2[l] = uu*uu+vv*vv;
+			}
+		}
+	}
+	FOR_EACH_LANE {
+		int k = group*BATCH_LANES + l;
+		m_stats[k].mass		  = (float)mass[l];
+		m_stats[k].maxSpeed	  = sqrtf(speed2[l]);
+		m_stats[k].cfl		  = m_stats[k].maxSpeed*dt*N;
+		m_stats[k].divergence = (float)sqrt(div2[l]/((double)N*N));
+	}
+}
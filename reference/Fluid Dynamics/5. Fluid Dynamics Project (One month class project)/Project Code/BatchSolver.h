@@ -0,0 +1,89 @@
+#pragma once
+
+#include "Def.h"	// definitions
+
+#define BATCH_LANES 8 // Instances stepped together, one per SIMD lane (AVX)
+
+// Per instance parameters, the knobs the demo tunes the look with
+struct tBatchParams
+{
+	float diff;
+	float visc;
+	float force;
+	float source;
+};
+
+// Per instance statistics, refreshed by every step
+struct tBatchStats
+{
+	float mass;			// Total density over the interior
+	float maxSpeed;		// Largest |(u,v)|
+	float cfl;			// maxSpeed*dt*N, cells travelled per step
+	float divergence;	// RMS divergence after the final projection
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Class:	CBatchSolver
+//
+// Purpose: Steps K independent grids of the same N together, for offline sweeps over the vel_step/dens_step parameters.
+//			The grids are stored structure-of-grids: each cell holds BATCH_LANES consecutive floats, one per instance,
+//			so every kernel's innermost loop runs across instances and vectorizes. K is split into groups of
+//			BATCH_LANES that are stepped in parallel across cores. Each instance gives the same result as the scalar
+//			solver run on its own.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class CBatchSolver
+{
+
+private:
+
+	int m_N;
+	int m_K;
+	int m_groups;
+	int m_cells; // (N+2)*(N+2)
+
+	// groups*cells*BATCH_LANES each, instance innermost
+	float *m_u;
+	float *m_v;
+	float *m_u_prev;
+	float *m_v_prev;
+	float *m_dens;
+	float *m_dens_prev;
+
+	// groups*BATCH_LANES each, unused lanes hold zeros
+	float *m_diff;
+	float *m_visc;
+	float *m_force;
+	float *m_source;
+
+	tBatchStats *m_stats;
+
+	CBatchSolver(const CBatchSolver&);
+	CBatchSolver&operator = (const CBatchSolver&);
+
+	void freeData(void);
+	void stepGroup(int group, float dt);
+	void gatherStats(int group, float dt);
+
+public:
+
+	CBatchSolver(int N, int K);
+	~CBatchSolver(void);
+
+	bool isValid(void) const { return m_u != 0; }
+	int  getN(void) const	 { return m_N; }
+	int  getK(void) const	 { return m_K; }
+
+	void setParams(int k, const tBatchParams &params);
+	void clear(void);
+
+	// Sources for the next step. splat hits every instance, scaled by each one's source and force,
+	// like a mouse drag in the demo; addDensity/addVelocity hit one instance unscaled
+	void splat(int i, int j, float density, float du, float dv);
+	void addDensity(int k, int i, int j, float amount);
+	void addVelocity(int k, int i, int j, float du, float dv);
+
+	void step(float dt);
+
+	const tBatchStats &getStats(int k) const { return m_stats[k]; }
+	void getDensity(int k, float *out) const; // (N+2)*(N+2) floats, row-major
+};
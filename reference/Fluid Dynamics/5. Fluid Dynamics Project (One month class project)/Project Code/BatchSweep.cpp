@@ -0,0 +1,69 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	"BatchSweep.cpp"
+//
+// Purpose: Offline parameter sweep on CBatchSolver. Every instance gets the same stirring (a density source and a
+//			rotating push at the centre, like holding both mouse buttons) and its own diff/visc/force from a grid,
+//			then the per instance statistics are printed as CSV.
+//
+// Usage:	batch_sweep [N] [K] [steps] [dt]
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "BatchSolver.h"
+#include "Timer.h"
+
+static const float diffs[]  = { 0.0f, 0.00001f, 0.0001f, 0.001f };
+static const float viscs[]  = { 0.0f, 0.0001f, 0.001f };
+static const float forces[] = { 2.5f, 5.0f, 10.0f, 20.0f };
+
+#define COUNT(a) (int)(sizeof(a)/sizeof(a[0]))
+
+int main(int argc, char *argv[])
+{
+	int N	  = argc > 1 ? atoi(argv[1]) : 64;
+	int K	  = argc > 2 ? atoi(argv[2]) : COUNT(diffs)*COUNT(viscs)*COUNT(forces);
+	int steps = argc > 3 ? atoi(argv[3]) : 200;
+	float dt  = argc > 4 ? (float)atof(argv[4]) : 0.1f;
+
+	CBatchSolver batch(N, K);
+	if(!batch.isValid())
+	{
+		fprintf ( stderr, "cannot allocate data\n" );
+		return 1;
+	}
+
+	for(int k = 0; k < K; k++)
+	{
+		tBatchParams params;
+		params.diff	  = diffs[k % COUNT(diffs)];
+		params.visc	  = viscs[(k / COUNT(diffs)) % COUNT(viscs)];
+		params.force  = forces[(k / (COUNT(diffs)*COUNT(viscs))) % COUNT(forces)];
+		params.source = 50.0f;
+		batch.setParams(k, params);
+	}
+
+	CTimer timer;
+	for(int s = 0; s < steps; s++)
+	{
+		float angle = 0.05f*s;
+		batch.splat(N/2, N/2, 1.0f, cosf(angle), sinf(angle));
+		batch.step(dt);
+	}
+	double seconds = timer.GetElapsedSeconds();
+
+	printf ( "k,diff,visc,force,source,mass,maxSpeed,cfl,divergence\n" );
+	for(int k = 0; k < K; k++)
+	{
+		const tBatchStats &stats = batch.getStats(k);
+		printf ( "%d,%g,%g,%g,%g,%g,%g,%g,%g\n", k,
+			diffs[k % COUNT(diffs)], viscs[(k / COUNT(diffs)) % COUNT(viscs)],
+			forces[(k / (COUNT(diffs)*COUNT(viscs))) % COUNT(forces)], 50.0f,
+			stats.mass, stats.maxSpeed, stats.cfl, stats.divergence );
+	}
+
+	fprintf ( stderr, "%d instances of %dx%d, %d steps in %.3fs: %.3g cells/s\n", K, N, N, steps, seconds,
+		(double)K*N*N*steps/seconds );
+	return 0;
+}
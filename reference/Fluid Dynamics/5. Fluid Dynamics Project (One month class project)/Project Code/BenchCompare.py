@@ -0,0 +1,64 @@
+#!/usr/bin/env python3
+#
+# BenchCompare.py
+# Checks a kernel_bench JSON run against a stored baseline. Points are matched on
+# (kernel, N, threads); a point regresses when its ns/cell is more than the tolerance
+# above the baseline. Exits 1 if anything regressed, so it can gate a build.
+#
+# Usage: BenchCompare.py [--tolerance 0.10] baseline.json current.json
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        run = json.load(f)
+    points = {}
+    for r in run["results"]:
+        points[(r["kernel"], r["N"], r["threads"])] = r
+    return run, points
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare kernel_bench results against a baseline")
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    parser.add_argument("--tolerance", type=float, default=0.10,
+                        help="allowed slowdown as a fraction of the baseline ns/cell (default 0.10)")
+    args = parser.parse_args()
+
+    base_run, base = load(args.baseline)
+    cur_run, cur = load(args.current)
+
+    for key in ("field_layout", "velocity_layout"):
+        if base_run.get(key) != cur_run.get(key):
+            print("warning: %s differs, baseline %s, current %s" % (key, base_run.get(key), cur_run.get(key)))
+
+    regressions = 0
+    print("%-19s %5s %7s %10s %10s %8s" % ("kernel", "N", "threads", "base ns", "ns", "change"))
+    for key in sorted(cur, key=lambda k: (k[1], k[2], k[0])):
+        if key not in base:
+            print("%-19s %5d %7d %10s %10.3f %8s" % (key + ("-", cur[key]["ns_per_cell"], "new")))
+            continue
+        was = base[key]["ns_per_cell"]
+        now = cur[key]["ns_per_cell"]
+        change = now / was - 1.0 if was > 0 else 0.0
+        slower = change > args.tolerance
+        regressions += slower
+        print("%-19s %5d %7d %10.3f %10.3f %+7.1f%%%s" % (key + (was, now, 100.0 * change, "  REGRESSED" if slower else "")))
+
+    missing = [k for k in base if k not in cur]
+    if missing:
+        print("%d baseline points were not run" % len(missing))
+
+    if regressions:
+        print("%d of %d points regressed by more than %.0f%%" % (regressions, len(cur), 100.0 * args.tolerance))
+        return 1
+    print("no regressions beyond %.0f%%" % (100.0 * args.tolerance))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,456 @@
+#include "Checkpoint.h"
+#include "Simulation.h"
+#include "Profiler.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+static void setError(const char **error, const char *reason)
+{
+	if(error)
+		*error = reason;
+}
+
+// Floats in a section at the current N, 0 for the ones this layout does not have
+static long long sectionFloats(int id)
+{
+	switch(id)
+	{
+	case eSectionU:
+	case eSectionUPrev:
+		return VEL_SIZE(N);
+	case eSectionV:
+	case eSectionVPrev:
+#if VELOCITY_LAYOUT == VELOCITY_LAYOUT_PLANAR
+		return VEL_SIZE(N);
+#else
+		return 0;	// Inside u's allocation
+#endif
+	case eSectionDensity:
+	case eSectionDensityPrev:
+		return FIELD_SIZE(N);
+	}
+	return 0;
+}
+
+static long long alignUp(long long bytes)
+{
+	return (bytes + CHECKPOINT_ALIGN - 1) / CHECKPOINT_ALIGN * CHECKPOINT_ALIGN;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// CCheckpoint
+
+CCheckpoint::CCheckpoint(void)
+{
+	m_data		= 0;
+	m_bytes		= 0;
+	m_handle	= 0;
+}
+
+CCheckpoint::~CCheckpoint(void)
+{
+	close();
+}
+
+int CCheckpoint::map(const char *path, bool writable, const char **error)
+{
+	close();
+
+	// Writable is copy-on-write: the sim steps in place and the file never changes
+#ifdef _WIN32
+	HANDLE file = CreateFileA ( path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if(file == INVALID_HANDLE_VALUE)
+	{
+		setError(error, "cannot open the file");
+		return 0;
+	}
+	DWORD high = 0;
+	DWORD low = GetFileSize ( file, &high );
+	m_bytes = ((long long)high << 32) | low;
+	HANDLE mapping = m_bytes ? CreateFileMappingA ( file, NULL, writable ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL ) : 0;
+	CloseHandle ( file );
+	if(!mapping)
+	{
+		setError(error, "cannot map the file");
+		return 0;
+	}
+	m_data = (char *) MapViewOfFile ( mapping, writable ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0 );
+	if(!m_data)
+	{
+		CloseHandle ( mapping );
+		setError(error, "cannot map the file");
+		return 0;
+	}
+	m_handle = mapping;
+#else
+	int fd = ::open ( path, O_RDONLY );
+	if(fd < 0)
+	{
+		setError(error, "cannot open the file");
+		return 0;
+	}
+	struct stat info;
+	void *view = MAP_FAILED;
+	if(!fstat ( fd, &info ) && info.st_size > 0)
+	{
+		m_bytes = info.st_size;
+		view = mmap ( 0, (size_t)m_bytes, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, fd, 0 );
+	}
+	::close ( fd );
+	if(view == MAP_FAILED)
+	{
+		m_bytes = 0;
+		setError(error, "cannot map the file");
+		return 0;
+	}
+	m_data = (char *) view;
+#endif
+
+	// Everything a reader relies on before touching a section
+	const tCheckpointHeader &header = getHeader();
+	const char *reason = 0;
+	if(m_bytes < (long long)sizeof(tCheckpointHeader) || memcmp(header.magic, CHECKPOINT_MAGIC, 8))
+		reason = "not a checkpoint";
+	else if(header.byteOrder != CHECKPOINT_BYTE_ORDER)
+		reason = "written on a machine with the other byte order";
+	else if(header.version != CHECKPOINT_VERSION || header.headerBytes != sizeof(tCheckpointHeader))
+		reason = "written by another version";
+	else if(header.fileBytes != m_bytes)
+		reason = "truncated";
+	else
+	{
+		for(int s = 0; s < totalCheckpointSectionCount && !reason; s++)
+		{
+			const tCheckpointSection &section = header.sections[s];
+			if(section.id < 0)
+				continue;
+			if(section.id != s || section.offset % CHECKPOINT_ALIGN || section.offset < (long long)sizeof(tCheckpointHeader)
+				|| section.bytes < 0 || section.offset + section.bytes > m_bytes)
+				reason = "corrupt section table";
+		}
+	}
+	if(reason)
+	{
+		close();
+		setError(error, reason);
+		return 0;
+	}
+	return 1;
+}
+
+int CCheckpoint::open(const char *path, const char **error)
+{
+	return map(path, false, error);
+}
+
+void CCheckpoint::close(void)
+{
+	if(!m_data)
+		return;
+
+#ifdef _WIN32
+	UnmapViewOfFile ( m_data );
+	CloseHandle ( (HANDLE)m_handle );
+#else
+	munmap ( m_data, (size_t)m_bytes );
+#endif
+	m_data		= 0;
+	m_bytes		= 0;
+	m_handle	= 0;
+}
+
+const char *CCheckpoint::getSection(int id) const
+{
+	const tCheckpointSection &section = getHeader().sections[id];
+	return section.id < 0 ? 0 : m_data + section.offset;
+}
+
+int CCheckpoint::verify(int id) const
+{
+	const tCheckpointSection &section = getHeader().sections[id];
+	return section.id < 0 || checksum(m_data + section.offset, section.bytes) == section.checksum;
+}
+
+void CCheckpoint::pack(const CFluidSim &sim, tCheckpointHeader &header)
+{
+	tSimRecord &s = header.sim;
+	s.diff				= sim.m_diff;
+	s.visc				= sim.m_visc;
+	s.force				= sim.m_force;
+	s.source			= sim.m_source;
+	s.decayRate			= sim.m_decayRate;
+	s.rain				= sim.m_bDrawRain;
+	s.wind				= sim.m_bDrawWind;
+	s.waves				= sim.m_bDrawWaves;
+	header.schedule		= sim.m_scheduler.getState();
+
+	const CShip &ship = sim.m_ship;
+	tShipRecord &p = header.ship;
+	p.x				= ship.m_fX;
+	p.z				= ship.m_fZ;
+	p.y				= ship.m_fY;
+	p.xLong			= ship.m_nXLong;
+	p.yLong			= ship.m_nYLong;
+	p.sideways		= ship.m_sideways;
+	p.xdForce		= ship.m_fXdForce;
+	p.ydForce		= ship.m_fYdForce;
+	p.zdForce		= ship.m_fZdForce;
+	p.xrForce		= ship.m_fXrForce;
+	p.yrForce		= ship.m_fYrForce;
+	p.zrForce		= ship.m_fZrForce;
+	p.xRoll			= ship.m_bXRoll;
+	memcpy ( p.starboard, ship.m_fStarboard, sizeof(p.starboard) );
+	memcpy ( p.port, ship.m_fPort, sizeof(p.port) );
+	p.zRoll			= ship.m_bZRoll;
+	memcpy ( p.bow, ship.m_fBow, sizeof(p.bow) );
+	memcpy ( p.stern, ship.m_fStern, sizeof(p.stern) );
+	p.heading		= ship.m_fHeading;
+	p.thrust		= ship.m_fThrust;
+	p.windDirection	= ship.m_nWindDirection;
+	p.sailsDown		= ship.m_bSailsDown;
+
+	const CWeather &weather = sim.m_weather;
+	tWeatherRecord &w = header.weather;
+	w.windDirection		= weather.m_windDirection;
+	w.windIntensity		= weather.m_windIntensity;
+	w.windTurbulence	= weather.m_windTurbulence;
+	w.rainIntensity		= weather.m_rainIntensity;
+	w.waveDirection		= weather.m_waveDirection;
+	w.waveIntensity		= weather.m_waveIntensity;
+	w.waveTurbulence	= weather.m_waveTurbulence;
+	w.deepWaves			= weather.m_deepWaves;
+
+	header.random.seed		= sim.m_random.getSeed();
+	header.random.counter	= sim.m_random.getCounter();
+	header.steps			= sim.m_steps;
+}
+
+void CCheckpoint::unpack(const tCheckpointHeader &header, CFluidSim &sim)
+{
+	const tSimRecord &s = header.sim;
+	sim.m_diff				= s.diff;
+	sim.m_visc				= s.visc;
+	sim.m_force				= s.force;
+	sim.m_source			= s.source;
+	sim.m_decayRate			= s.decayRate;
+	sim.m_bDrawRain			= s.rain != 0;
+	sim.m_bDrawWind			= s.wind != 0;
+	sim.m_bDrawWaves		= s.waves != 0;
+	sim.m_scheduler.setState(header.schedule);
+
+	CShip &ship = sim.m_ship;
+	const tShipRecord &p = header.ship;
+	ship.m_fX				= p.x;
+	ship.m_fZ				= p.z;
+	ship.m_fY				= p.y;
+	ship.m_nXLong			= p.xLong;
+	ship.m_nYLong			= p.yLong;
+	ship.m_sideways			= p.sideways != 0;
+	ship.m_fXdForce			= p.xdForce;
+	ship.m_fYdForce			= p.ydForce;
+	ship.m_fZdForce			= p.zdForce;
+	ship.m_fXrForce			= p.xrForce;
+	ship.m_fYrForce			= p.yrForce;
+	ship.m_fZrForce			= p.zrForce;
+	ship.m_bXRoll			= p.xRoll != 0;
+	memcpy ( ship.m_fStarboard, p.starboard, sizeof(p.starboard) );
+	memcpy ( ship.m_fPort, p.port, sizeof(p.port) );
+	ship.m_bZRoll			= p.zRoll != 0;
+	memcpy ( ship.m_fBow, p.bow, sizeof(p.bow) );
+	memcpy ( ship.m_fStern, p.stern, sizeof(p.stern) );
+	ship.m_fHeading			= p.heading;
+	ship.m_fThrust			= p.thrust;
+	ship.m_nWindDirection	= p.windDirection;
+	ship.m_bSailsDown		= p.sailsDown != 0;
+
+	CWeather &weather = sim.m_weather;
+	const tWeatherRecord &w = header.weather;
+	weather.m_windDirection		= w.windDirection;
+	weather.m_windIntensity		= w.windIntensity;
+	weather.m_windTurbulence	= w.windTurbulence;
+	weather.m_rainIntensity		= w.rainIntensity;
+	weather.m_waveDirection		= w.waveDirection;
+	weather.m_waveIntensity		= w.waveIntensity;
+	weather.m_waveTurbulence	= w.waveTurbulence;
+	weather.m_deepWaves			= w.deepWaves != 0;
+
+	// The sequence picks up at the draw after the last one saved
+	sim.m_random.seed(header.random.seed);
+	sim.m_random.setCounter(header.random.counter);
+	sim.m_steps = header.steps;
+}
+
+int CCheckpoint::save(const char *path, const CFluidSim &sim, const char **error)
+{
+	PROFILE_ZONE("checkpoint save");
+
+	if(!sim.m_u)
+	{
+		setError(error, "nothing allocated");
+		return 0;
+	}
+
+	const float *fields[totalCheckpointSectionCount] = { sim.m_u, sim.m_v, sim.m_u_prev, sim.m_v_prev, sim.m_dens,
+														 sim.m_dens_prev };
+
+	tCheckpointHeader header;
+	memset ( &header, 0, sizeof(header) );
+	memcpy ( header.magic, CHECKPOINT_MAGIC, 8 );
+	header.version			= CHECKPOINT_VERSION;
+	header.headerBytes		= sizeof(tCheckpointHeader);
+	header.byteOrder		= CHECKPOINT_BYTE_ORDER;
+	header.N				= N;
+	header.fieldLayout		= FIELD_LAYOUT;
+	header.velocityLayout	= VELOCITY_LAYOUT;
+	pack(sim, header);
+
+	long long offset = alignUp(sizeof(tCheckpointHeader));
+	for(int s = 0; s < totalCheckpointSectionCount; s++)
+	{
+		tCheckpointSection &section = header.sections[s];
+		long long bytes = sectionFloats(s) * (long long)sizeof(float);
+		if(!bytes)
+		{
+			section.id = -1;
+			continue;
+		}
+		section.id			= s;
+		section.offset		= offset;
+		section.bytes		= bytes;
+		section.checksum	= checksum(fields[s], bytes);
+		offset = alignUp(offset + bytes);
+	}
+	header.fileBytes = offset;
+
+	// Written to the side and renamed over, so a crash half way leaves the last good checkpoint alone
+	char temp[1024];
+	if(strlen(path) + 5 > sizeof(temp))
+	{
+		setError(error, "path too long");
+		return 0;
+	}
+	strcpy ( temp, path );
+	strcat ( temp, ".tmp" );
+
+	FILE *file = fopen ( temp, "wb" );
+	if(!file)
+	{
+		setError(error, "cannot create the file");
+		return 0;
+	}
+
+	static const char zeros[CHECKPOINT_ALIGN] = { 0 };
+	long long written = 0;
+	int ok = fwrite ( &header, sizeof(header), 1, file ) == 1;
+	written += sizeof(header);
+	for(int s = 0; s < totalCheckpointSectionCount && ok; s++)
+	{
+		const tCheckpointSection &section = header.sections[s];
+		if(section.id < 0)
+			continue;
+		ok = fwrite ( zeros, 1, (size_t)(section.offset - written), file ) == (size_t)(section.offset - written)
+			&& fwrite ( fields[s], 1, (size_t)section.bytes, file ) == (size_t)section.bytes;
+		written = section.offset + section.bytes;
+	}
+	if(ok && written < header.fileBytes)
+		ok = fwrite ( zeros, 1, (size_t)(header.fileBytes - written), file ) == (size_t)(header.fileBytes - written);
+	ok = (fclose ( file ) == 0) && ok;
+
+#ifdef _WIN32
+	if(ok)
+		remove ( path );	// rename will not replace a file here
+#endif
+	if(!ok || rename ( temp, path ))
+	{
+		remove ( temp );
+		setError(error, "cannot write the file");
+		return 0;
+	}
+	return 1;
+}
+
+int CCheckpoint::restore(const char *path, CFluidSim &sim, const char **error)
+{
+	PROFILE_ZONE("checkpoint restore");
+
+	CCheckpoint *checkpoint = new CCheckpoint;
+	if(!checkpoint->map(path, true, error))
+	{
+		delete checkpoint;
+		return 0;
+	}
+
+	// The sections are the allocations as they were, they only fit a build with the same layouts
+	const tCheckpointHeader &header = checkpoint->getHeader();
+	const char *reason = 0;
+	if(header.fieldLayout != FIELD_LAYOUT || header.velocityLayout != VELOCITY_LAYOUT)
+		reason = "saved with another FIELD_LAYOUT or VELOCITY_LAYOUT";
+	else if(header.N < 8)
+		reason = "bad grid size";
+	else
+	{
+		int n = N;
+		N = header.N;
+		for(int s = 0; s < totalCheckpointSectionCount && !reason; s++)
+		{
+			long long bytes = sectionFloats(s) * (long long)sizeof(float);
+			if((header.sections[s].id < 0 ? 0 : header.sections[s].bytes) != bytes)
+				reason = "sections do not match the grid size";
+		}
+		N = n;
+	}
+	if(reason)
+	{
+		delete checkpoint;
+		setError(error, reason);
+		return 0;
+	}
+
+	// Point the fields into the mapping, the sim unmaps it when they are freed
+	sim.freeFluid();
+	N = header.N;
+	sim.m_u			= (float *) checkpoint->getSection(eSectionU);
+	sim.m_u_prev	= (float *) checkpoint->getSection(eSectionUPrev);
+#if VELOCITY_LAYOUT == VELOCITY_LAYOUT_PLANAR
+	sim.m_v			= (float *) checkpoint->getSection(eSectionV);
+	sim.m_v_prev	= (float *) checkpoint->getSection(eSectionVPrev);
+#else
+	sim.m_v			= sim.m_u + VEL_V_OFFSET;
+	sim.m_v_prev	= sim.m_u_prev + VEL_V_OFFSET;
+#endif
+	sim.m_dens		= (float *) checkpoint->getSection(eSectionDensity);
+	sim.m_dens_prev	= (float *) checkpoint->getSection(eSectionDensityPrev);
+	sim.m_checkpoint = checkpoint;
+
+	unpack(header, sim);
+	return 1;
+}
+
+const char *CCheckpoint::sectionName(int id)
+{
+	static const char *names[totalCheckpointSectionCount] = { "u", "v", "u_prev", "v_prev", "dens", "dens_prev" };
+	return names[id];
+}
+
+unsigned long long CCheckpoint::checksum(const void *data, long long bytes)
+{
+	// FNV-1a, 64 bit
+	const unsigned char *p = (const unsigned char *)data;
+	unsigned long long hash = 14695981039346656037ULL;
+	for(long long b = 0; b < bytes; b++)
+	{
+		hash ^= p[b];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
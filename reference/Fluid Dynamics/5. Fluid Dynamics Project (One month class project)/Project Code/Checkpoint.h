@@ -0,0 +1,139 @@
+#pragma once
+
+#include "Def.h"
+#include "Scheduler.h"	// tSchedulerState
+
+class CFluidSim;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Class:	"CCheckpoint"
+//
+// Purpose: Versioned binary checkpoint of the whole simulation: every field, the solver parameters, the forcing's
+//			scheduler, CShip, CWeather and the random counter. The header and state records fill the first page and
+//			each field allocation follows on its own page boundary, byte for byte as it sits in memory, so a restart
+//			maps the file copy-on-write and points the fields straight into it: no parse and no copy, pages are read
+//			as the first step touches them.
+//
+// Usage:	CCheckpoint::save(path, sim) and CCheckpoint::restore(path, sim). A restore needs the same FIELD_LAYOUT and
+//			VELOCITY_LAYOUT as the save and sets N from the file; the sim owns the mapping until its fields are freed.
+//			open() maps a file read-only for looking at, checkpoint_tool prints and verifies them.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define CHECKPOINT_MAGIC		"LUMENCKP"
+#define CHECKPOINT_VERSION		2
+#define CHECKPOINT_BYTE_ORDER	0x01020304
+#define CHECKPOINT_ALIGN		4096	// Sections start on a page, any FIELD_ALIGN divides it
+
+// One per field allocation. In the paired velocity layouts v lives in u's allocation and has no section of its own
+enum eCheckpointSection{eSectionU = 0, eSectionV, eSectionUPrev, eSectionVPrev, eSectionDensity, eSectionDensityPrev,
+						totalCheckpointSectionCount};
+
+// Everything is fixed size so the header reads the same on any compiler
+struct tCheckpointSection
+{
+	int					id;			// eCheckpointSection, -1 when absent
+	int					pad;
+	long long			offset;		// From the start of the file, a multiple of CHECKPOINT_ALIGN
+	long long			bytes;
+	unsigned long long	checksum;	// FNV-1a over the bytes
+};
+
+struct tSimRecord
+{
+	float	diff, visc, force, source;
+	float	decayRate;
+	int		rain, wind, waves;		// On or off
+};
+
+struct tShipRecord
+{
+	float	x, z, y;
+	int		xLong, yLong;
+	int		sideways;
+	float	xdForce, ydForce, zdForce;
+	float	xrForce, yrForce, zrForce;
+	int		xRoll;
+	float	starboard[5], port[5];
+	int		zRoll;
+	float	bow[3], stern[3];
+	float	heading, thrust;
+	int		windDirection;
+	int		sailsDown;
+};
+
+struct tWeatherRecord
+{
+	int		windDirection, windIntensity, windTurbulence;
+	int		rainIntensity;
+	int		waveDirection;
+	float	waveIntensity;
+	int		waveTurbulence;
+	int		deepWaves;
+};
+
+struct tRandomRecord
+{
+	unsigned int	seed;
+	unsigned int	pad;
+	long long		counter;	// Draws since seeding, CRandom::getCounter
+};
+
+struct tCheckpointHeader
+{
+	char		magic[8];		// CHECKPOINT_MAGIC, no terminator
+	unsigned int version;
+	unsigned int headerBytes;
+	unsigned int byteOrder;		// CHECKPOINT_BYTE_ORDER as the writer saw it
+	int			N;
+	int			fieldLayout;
+	int			velocityLayout;
+	long long	steps;			// CFluidSim::step calls before the save
+	long long	fileBytes;
+
+	tSimRecord		sim;
+	tShipRecord		ship;
+	tWeatherRecord	weather;
+	tRandomRecord	random;
+	tSchedulerState	schedule;		// The timers, where they are and how often they fire
+
+	tCheckpointSection sections[totalCheckpointSectionCount];
+};
+
+class CCheckpoint
+{
+
+private:
+
+	char		*m_data;		// The whole file
+	long long	m_bytes;
+	void		*m_handle;		// Windows file mapping
+
+	CCheckpoint(const CCheckpoint&);
+	CCheckpoint&operator = (const CCheckpoint&);
+
+	int map(const char *path, bool writable, const char **error);
+
+	// The state records, CFluidSim, CShip and CWeather name this class a friend
+	static void pack(const CFluidSim &sim, tCheckpointHeader &header);
+	static void unpack(const tCheckpointHeader &header, CFluidSim &sim);
+
+public:
+
+	CCheckpoint(void);
+	~CCheckpoint(void);
+
+	// Both return 0 on failure, with the reason in error. A failed restore leaves the sim as it was
+	static int save(const char *path, const CFluidSim &sim, const char **error = 0);
+	static int restore(const char *path, CFluidSim &sim, const char **error = 0);
+
+	// Read-only view for tools, returns 0 if the file is not a checkpoint this build reads
+	int  open(const char *path, const char **error = 0);
+	void close(void);
+
+	const tCheckpointHeader &getHeader(void) const	{ return *(const tCheckpointHeader *)m_data; }
+	const char *getSection(int id) const;	// NULL when absent
+	int verify(int id) const;				// Checksum matches
+
+	static const char *sectionName(int id);
+	static unsigned long long checksum(const void *data, long long bytes);
+};
@@ -0,0 +1,249 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	"CheckpointTool.cpp"
+//
+// Purpose: Looks inside checkpoints (see Checkpoint.h) and checks that a save and restore round trip changes nothing.
+//
+// Usage:	checkpoint_tool info file		the header, the state records and the section table
+//			checkpoint_tool verify file		checksums every section, exits 1 if any is wrong
+//			checkpoint_tool roundtrip [N] [steps]
+//
+//			roundtrip runs a sim with stir, rain, wind and waves, saves it, restores the file into a second sim and
+//			compares the two bit for bit: the fields, a second save of the restored sim against the first file, and
+//			both again after stepping on, which the weather's random draws only match if the restore picked their
+//			sequence up where the save left it. Exits 1 on any difference.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "Simulation.h"
+#include "Checkpoint.h"
+#include "Timer.h"
+
+#define ROUNDTRIP_FILE		"roundtrip.lck"
+#define ROUNDTRIP_AGAIN		"roundtrip_again.lck"
+#define ROUNDTRIP_SEED		1234
+#define ROUNDTRIP_CONTINUE	50	// Steps after the restore
+
+static int usage(const char *name)
+{
+	fprintf ( stderr, "usage : %s info file | verify file | roundtrip [N] [steps]\n", name );
+	return 1;
+}
+
+static const char *layoutName(int field, int velocity)
+{
+	static char name[64];
+	static const char *fields[] = { "linear", "tiled", "padded" };
+	static const char *velocities[] = { "planar", "interleaved", "aosoa" };
+	sprintf ( name, "%s/%s", field >= 0 && field < 3 ? fields[field] : "?",
+		velocity >= 0 && velocity < 3 ? velocities[velocity] : "?" );
+	return name;
+}
+
+static int info(const char *path)
+{
+	CCheckpoint checkpoint;
+	const char *error = 0;
+	if(!checkpoint.open(path, &error))
+	{
+		fprintf ( stderr, "%s: %s\n", path, error );
+		return 1;
+	}
+
+	const tCheckpointHeader &h = checkpoint.getHeader();
+	printf ( "%s: version %u, %.0f bytes\n", path, h.version, (double)h.fileBytes );
+	printf ( "grid      N=%d, layout %s, %.0f steps\n", h.N, layoutName(h.fieldLayout, h.velocityLayout), (double)h.steps );
+	printf ( "solver    diff=%g visc=%g force=%g source=%g decay rate=%g\n", h.sim.diff, h.sim.visc, h.sim.force,
+		h.sim.source, h.sim.decayRate );
+
+	// Each timer as next/period in sim seconds
+	static const char *events[totalSimEventCount] = { "decay", "ship", "rain", "wind", "waves" };
+	const int on[totalSimEventCount] = { 1, 1, h.sim.rain, h.sim.wind, h.sim.waves };
+	CScheduler schedule;
+	schedule.setState(h.schedule);
+	printf ( "timers    at %.4f s:", (double)h.schedule.tick*SCHEDULER_TICK + h.schedule.remainder );
+	for(int e = 0; e < totalSimEventCount; e++)
+		printf ( "%s %s %s%g/%g", e ? "," : "", events[e], on[e] ? "" : "off ", schedule.getTimeUntil(e), schedule.getPeriod(e) );
+	printf ( "\n" );
+	printf ( "ship      at (%g, %g, %g) heading %g thrust %g, sails %s\n", h.ship.x, h.ship.y, h.ship.z, h.ship.heading,
+		h.ship.thrust, h.ship.sailsDown ? "down" : "up" );
+	printf ( "weather   wind %d/%d/%d, rain %d, waves %d/%g/%d%s\n", h.weather.windDirection, h.weather.windIntensity,
+		h.weather.windTurbulence, h.weather.rainIntensity, h.weather.waveDirection, h.weather.waveIntensity,
+		h.weather.waveTurbulence, h.weather.deepWaves ? " deep" : "" );
+	printf ( "random    seed %u, counter %.0f\n", h.random.seed, (double)h.random.counter );
+
+	printf ( "%-10s %12s %12s %18s\n", "section", "offset", "bytes", "checksum" );
+	for(int s = 0; s < totalCheckpointSectionCount; s++)
+	{
+		const tCheckpointSection &section = h.sections[s];
+		if(section.id < 0)
+			printf ( "%-10s %12s\n", CCheckpoint::sectionName(s), "(in u)" );
+		else
+			printf ( "%-10s %12.0f %12.0f   %016llx\n", CCheckpoint::sectionName(s), (double)section.offset,
+				(double)section.bytes, section.checksum );
+	}
+	return 0;
+}
+
+static int verify(const char *path)
+{
+	CCheckpoint checkpoint;
+	const char *error = 0;
+	if(!checkpoint.open(path, &error))
+	{
+		fprintf ( stderr, "%s: %s\n", path, error );
+		return 1;
+	}
+
+	int bad = 0;
+	for(int s = 0; s < totalCheckpointSectionCount; s++)
+	{
+		if(!checkpoint.verify(s))
+		{
+			printf ( "%s: section %s does not match its checksum\n", path, CCheckpoint::sectionName(s) );
+			bad++;
+		}
+	}
+	if(!bad)
+		printf ( "%s: ok\n", path );
+	return bad ? 1 : 0;
+}
+
+// Stir at the centre, splash and run the weather, like fluid_runner ... stir splash rain wind waves
+static void run(CFluidSim &sim, int steps, float dt)
+{
+	int n = N;
+	for(int s = 0; s < steps; s++)
+	{
+		sim.clearSources();
+		float angle = 0.05f*sim.getSteps();
+		sim.addDensitySource(n/2, n/2, sim.getSource());
+		sim.addVelocitySource(n/2, n/2, sim.getForce() * cosf(angle), sim.getForce() * sinf(angle));
+		if(sim.getSteps() % 10 == 0)
+		{
+			sim.injectDensity();
+			sim.injectVelocity();
+		}
+		sim.step(dt);
+		sim.applyForcing(dt);
+	}
+}
+
+static int sameFields(CFluidSim &a, CFluidSim &b)
+{
+	size_t field = FIELD_SIZE(N)*sizeof(float), velocity = VEL_SIZE(N)*sizeof(float);
+	int same = !memcmp(a.getU(), b.getU(), velocity) && !memcmp(a.getUPrev(), b.getUPrev(), velocity)
+		&& !memcmp(a.getDensity(), b.getDensity(), field) && !memcmp(a.getDensityPrev(), b.getDensityPrev(), field);
+#if VELOCITY_LAYOUT == VELOCITY_LAYOUT_PLANAR
+	same = same && !memcmp(a.getV(), b.getV(), velocity) && !memcmp(a.getVPrev(), b.getVPrev(), velocity);
+#endif
+	return same;
+}
+
+static int sameFiles(const char *a, const char *b)
+{
+	FILE *fa = fopen ( a, "rb" ), *fb = fopen ( b, "rb" );
+	int same = fa && fb;
+	char bufferA[65536], bufferB[65536];
+	while(same)
+	{
+		size_t ra = fread ( bufferA, 1, sizeof(bufferA), fa );
+		size_t rb = fread ( bufferB, 1, sizeof(bufferB), fb );
+		if(ra != rb || memcmp(bufferA, bufferB, ra))
+			same = 0;
+		else if(!ra)
+			break;
+	}
+	if(fa) fclose ( fa );
+	if(fb) fclose ( fb );
+	return same;
+}
+
+static int check(const char *what, int ok)
+{
+	printf ( "%-44s %s\n", what, ok ? "identical" : "DIFFERENT" );
+	return ok ? 0 : 1;
+}
+
+static int roundtrip(int n, int steps)
+{
+	const float dt = 0.1f;
+	const char *error = 0;
+
+	CFluidSim original;
+	if(!original.allocateFluid(n))
+	{
+		fprintf ( stderr, "cannot allocate data\n" );
+		return 1;
+	}
+	original.clearFluid();
+	original.setParams(0.0001f, 0.0f, 5.0f, 100.0f);
+	original.rainToggle();
+	original.windToggle();
+	original.wavesToggle();
+	original.seedRandom(ROUNDTRIP_SEED);
+	run(original, steps, dt);
+
+	CTimer timer;
+	if(!CCheckpoint::save(ROUNDTRIP_FILE, original, &error))
+	{
+		fprintf ( stderr, "save: %s\n", error );
+		return 1;
+	}
+	double saveSeconds = timer.GetElapsedSeconds();
+
+	CFluidSim restored;
+	timer.Reset();
+	if(!CCheckpoint::restore(ROUNDTRIP_FILE, restored, &error))
+	{
+		fprintf ( stderr, "restore: %s\n", error );
+		return 1;
+	}
+	double restoreSeconds = timer.GetElapsedSeconds();
+
+	printf ( "N=%d, %d steps, %s, saved in %.2f ms, restored in %.3f ms\n", n, steps,
+		layoutName(FIELD_LAYOUT, VELOCITY_LAYOUT), 1e3*saveSeconds, 1e3*restoreSeconds );
+
+	int failed = 0;
+	failed += check("fields after restore", sameFields(original, restored));
+	failed += check("steps after restore", original.getSteps() == restored.getSteps());
+	CCheckpoint::save(ROUNDTRIP_AGAIN, restored);
+	failed += check("restored sim saved again", sameFiles(ROUNDTRIP_FILE, ROUNDTRIP_AGAIN));
+
+	run(original, ROUNDTRIP_CONTINUE, dt);
+	timer.Reset();
+	run(restored, ROUNDTRIP_CONTINUE, dt);
+	double continueSeconds = timer.GetElapsedSeconds();
+
+	char what[64];
+	sprintf ( what, "fields %d steps on", ROUNDTRIP_CONTINUE );
+	failed += check(what, sameFields(original, restored));
+	CCheckpoint::save(ROUNDTRIP_FILE, original);
+	CCheckpoint::save(ROUNDTRIP_AGAIN, restored);
+	sprintf ( what, "whole state %d steps on", ROUNDTRIP_CONTINUE );
+	failed += check(what, sameFiles(ROUNDTRIP_FILE, ROUNDTRIP_AGAIN));
+	printf ( "stepping on from the mapping took %.2f ms\n", 1e3*continueSeconds );
+
+	remove ( ROUNDTRIP_FILE );
+	remove ( ROUNDTRIP_AGAIN );
+	return failed ? 1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+	if(argc >= 3 && !strcmp(argv[1], "info"))
+		return info(argv[2]);
+	if(argc >= 3 && !strcmp(argv[1], "verify"))
+		return verify(argv[2]);
+	if(argc >= 2 && !strcmp(argv[1], "roundtrip"))
+	{
+		int n = argc > 2 ? atoi(argv[2]) : 128;
+		int steps = argc > 3 ? atoi(argv[3]) : 200;
+		if(n < 8 || steps < 0)
+			return usage(argv[0]);
+		return roundtrip(n, steps);
+	}
+	return usage(argv[0]);
+}
@@ -3,11 +3,100 @@
 #define WINDOW_WIDTH	800
 #define WINDOW_HEIGHT	600
 
+// gluPerspective's, degrees and distances
+#define CAMERA_FOV		35.0f
+#define CAMERA_NEAR		1.0f
+#define CAMERA_FAR		500.0f
+
+// Field Layouts
+// Linear is the original row-major (N+2)x(N+2) grid. Tiled stores the grid in square
+// TILE_SIZE blocks so the four cells an advect backtrace reads share cache lines and
+// pages whatever the direction of the flow. Padded is row-major with each row padded to
+// a multiple of FIELD_VEC floats and shifted so the first interior cell of every row is
+// vector aligned. Pick one at build time with FIELD_LAYOUT.
+#define FIELD_LAYOUT_LINEAR	0
+#define FIELD_LAYOUT_TILED	1
+#define FIELD_LAYOUT_PADDED	2
+
+#ifndef FIELD_LAYOUT
+#define FIELD_LAYOUT FIELD_LAYOUT_LINEAR
+#endif
+
+#ifndef TILE_SHIFT
+#define TILE_SHIFT 4 // 16x16 tiles, each tile row is one 64 byte cache line
+#endif
+#define TILE_SIZE  (1<<TILE_SHIFT)
+#define TILE_MASK  (TILE_SIZE-1)
+#define TILE_COUNT(N) (((N)+2+TILE_MASK)>>TILE_SHIFT) // Tiles per side
+
+#define FIELD_VEC	 8	// Floats per vector (AVX)
+#define FIELD_ALIGN	 64	// Field allocations start on a cache line
+#define FIELD_ORIGIN (FIELD_VEC-1) // Puts cell (1,j) on a vector boundary
+#define FIELD_STRIDE(N) ((FIELD_ORIGIN+(N)+2+FIELD_VEC-1)&~(FIELD_VEC-1)) // Padded row length
+
+// No-alias hint for the streaming kernels, so their row loops vectorize (VC++ 7.1 has no __restrict)
+#if defined(_MSC_VER) && _MSC_VER < 1400
+#define RESTRICT
+#else
+#define RESTRICT __restrict
+#endif
+
 // Solver Macros (Taken from original source code)
+#if FIELD_LAYOUT == FIELD_LAYOUT_TILED
+#define IX(i,j) (((((((j)>>TILE_SHIFT)*TILE_COUNT(N)+((i)>>TILE_SHIFT))<<TILE_SHIFT)+((j)&TILE_MASK))<<TILE_SHIFT)+((i)&TILE_MASK))
+#define FIELD_SIZE(N) ((TILE_COUNT(N)*TILE_COUNT(N))<<(2*TILE_SHIFT))
+// Walks the cells tile by tile, in memory order
+#define FOR_EACH_CELL for ( int tj_=0 ; tj_<TILE_COUNT(N) ; tj_++ ) { for ( int ti_=0 ; ti_<TILE_COUNT(N) ; ti_++ ) { \
+	for ( j=tj_ ? tj_<<TILE_SHIFT : 1 ; j<=N && j<((tj_+1)<<TILE_SHIFT) ; j++ ) { \
+	for ( i=ti_ ? ti_<<TILE_SHIFT : 1 ; i<=N && i<((ti_+1)<<TILE_SHIFT) ; i++ ) {
+#define END_FOR }}}}
+#elif FIELD_LAYOUT == FIELD_LAYOUT_PADDED
+#define IX(i,j) (FIELD_ORIGIN+(i)+FIELD_STRIDE(N)*(j))
+#define FIELD_SIZE(N) (FIELD_STRIDE(N)*((N)+2))
+// Row by row, so the inner loop is unit stride from an aligned start
+#define FOR_EACH_CELL for ( j=1 ; j<=N ; j++ ) { for ( i=1 ; i<=N ; i++ ) {
+#define END_FOR }}
+#else
 #define IX(i,j) ((i)+(N+2)*(j))
-#define SWAP(x0,x) {float * tmp=x0;x0=x;x=tmp;}
+#define FIELD_SIZE(N) (((N)+2)*((N)+2))
 #define FOR_EACH_CELL for ( i=1 ; i<=N ; i++ ) { for ( j=1 ; j<=N ; j++ ) {
 #define END_FOR }}
+#endif
+#define SWAP(x0,x) {float * tmp=x0;x0=x;x=tmp;}
+
+// Velocity Layouts
+// Planar keeps u and v in two separate fields. Interleaved stores (u,v) pairs in one field so
+// an advect tap or a gradient update reads both components from one cache line. AoSoA stores
+// VEL_LANES u's then VEL_LANES v's, so either component is one aligned SIMD load.
+// In the paired layouts u and v point into the same allocation (v = u + VEL_V_OFFSET) and a
+// component is indexed with VX/VIX instead of IX. Pick one at build time with VELOCITY_LAYOUT.
+#define VELOCITY_LAYOUT_PLANAR		0
+#define VELOCITY_LAYOUT_INTERLEAVED	1
+#define VELOCITY_LAYOUT_AOSOA		2
+
+#ifndef VELOCITY_LAYOUT
+#define VELOCITY_LAYOUT VELOCITY_LAYOUT_PLANAR
+#endif
+
+#define VEL_LANES 4 // SSE width
+#define VEL_ROUND(n) (((n)+VEL_LANES-1)&~(VEL_LANES-1))
+
+#if VELOCITY_LAYOUT == VELOCITY_LAYOUT_INTERLEAVED
+#define VX(k) ((k)<<1)
+#define VEL_V_OFFSET 1
+#define VEL_SIZE(N) (2*VEL_ROUND(FIELD_SIZE(N))) // Floats per velocity allocation (both components)
+#elif VELOCITY_LAYOUT == VELOCITY_LAYOUT_AOSOA
+#define VX(k) ((((k)&~(VEL_LANES-1))<<1)+((k)&(VEL_LANES-1)))
+#define VEL_V_OFFSET VEL_LANES
+#define VEL_SIZE(N) (2*VEL_ROUND(FIELD_SIZE(N)))
+#else
+#define VX(k) (k)
+#define VEL_SIZE(N) FIELD_SIZE(N) // Floats per component, u and v are allocated separately
+#endif
+#define VIX(i,j) VX(IX(i,j))
+
+// Mesh index, the rendering arrays stay row-major whatever the field layout
+#define MX(i,j) ((i)+(N+2)*(j))
 
 // Color
 struct tColor
@@ -24,13 +113,13 @@ struct tColorScheme
 	tColor VelocityLayer;
 };
 
-#define DECAY_TIME 0.1f
+#define DECAY_TIME 0.1f	// Sim seconds between the decay's passes over the grid
 #define NUM_COLOR_SCHEMES 2
 
-#define A_SIZE 16900 //4356 // Array size: (N+2)*(N+2) ...error: expected constant expression crap
 #define WATER_SCALE 20.0f
 
 enum{center = 0, up, rightUp, right, down, leftDown, left, totalIndexCount};
 enum{leftUp = totalIndexCount, rightDown, totalDirectionCount};
 
-#define LIMIT_CUT 5.0f
\ No newline at end of file
+#define LIMIT_CUT 5.0f
+#define THIN_OUT_CELLS 1000	// Cells thinOut picks at random
\ No newline at end of file
@@ -7,15 +7,24 @@
 #include "Def.h"	    // definitions
 #include "CSingleton.h" // singleton tamplate
 #include <glFrame.h>    // Richard's frame class
-#include <stopWatch.h>  // Richard's time class
-#include <glSphere.h>   // Richard's sphere class
+#include "Timer.h"		// portable time class
 #include <ctime>		// randomize seed
 #include "TeaPot.h"		// The flying teapot from planet Gong
 #include <stdio.h>		// using sprintf for the fps timer display
-#include "Ship.h"
-#include "Weather.h"
-
-extern N;
+#include "Simulation.h"	// the water itself
+#include "Mesh.h"		// and its surface
+#include "Profiler.h"	// PROFILE_ZONE
+#include "FrameStats.h"	// frame time histograms
+#include "StatsServer.h"	// live stats
+#include "Checkpoint.h"	// save and restore
+#include "FieldRecorder.h"	// field recordings
+#include "InputLog.h"	// session logs for replay
+#include "RenderGL.h"	// what the scene is drawn through
+#include "VelocityGlyphs.h"	// the velocity view
+#include "FlowLic.h"	// the flow view
+#include "FieldResampler.h"	// the fields at the mesh's N
+
+extern int N;
 
 class CDemo :
 	public CSingleton<CDemo>
@@ -30,62 +39,38 @@ private:
 
 private:
 
-	CStopWatch	m_watch;
-	CStopWatch fpsTimer;
+	CTimer		m_watch;
+	CTimer		fpsTimer;
 	GLFrame		m_camera;
 	//CTeaPot	m_teaPot;
-	CShip		m_ship;
-	CWeather	m_weather;
+	CFluidSim	m_sim;
+	CWaterMesh	m_mesh;
+	CVelocityGlyphs	m_glyphs;
+	CFlowLic	m_flow;
+	CFieldResampler m_resampler;	// Between the sim and the mesh when their N differ
+	CGLRenderer	m_renderer;
+
+	// Frame times, recorded every frame at the end of render
+	CFrameStats	m_frameStats;
+	tFrameTimes	m_frameTimes;
+	CStatsServer m_stats;
+	CFieldRecorder m_recorder;
+	CInputLog	m_log;
 
 	// Per second timer
 	float	m_dt;
 	float	m_lastTime;
-	float   m_decay;
 
-	// Weather
-	bool	m_bDrawRain;
-	float	m_rainTimer;
-	float	m_rainTimerSpacing;
-	bool	m_bDrawWind;
-	float	m_windTimer;
-	float	m_windTimerSpacing;
-	bool	m_bDrawWaves;
-	float	m_wavesTimer;
-	float	m_wavesTimerSpacing;
-
-	// Rendering arrays
-	GLfloat vData[A_SIZE][3];
-	GLfloat nData[A_SIZE][3];
-	GLfloat cData[A_SIZE][3];
-	GLint	iData[A_SIZE][6];
-
-	// Fluid Simulation Variables
-	float	m_diff;
-	float	m_visc;
-	float	m_force;
-	float	m_source;
+	// Display
 	bool	m_bDrawVelocity;
-	bool	m_bDraw3d;
+	bool	m_bDrawFlow;		// The LIC image as the water's colours
 	bool	m_bDrawTeaPot;
 	bool	m_bLights;
 	bool	m_bWireFrame;
 
-	float *m_u;
-	float *m_v;
-	float *m_u_prev;
-	float *m_v_prev;
-	float *m_dens;
-	float *m_dens_prev;
 	int    m_cursorX;
 	int    m_cursorY;
 
-	float m_decayRate;
-
-	// Color Schemes
-	tColorScheme m_colors[2];
-	tColor		 m_backgroundColor;
-	int m_colorShceme;
-
 public:
 
 	// Mouse
@@ -93,52 +78,51 @@ public:
 	int omx, omy, mx, my;
 
 	~CDemo(void);
-	void freeFluid(void);
-	void clearFluid(void);
-	int  allocateFluid(void);
+	void clearFluid(void)	{ act(eInputClear); }
 
 	void render(void);
+	void resize(int width, int height);
 	void idle(void);
 	void keyboardInput(void);
-	tColor colorLerp(tColor start, tColor end, float range);
-	void thinOut(void);
-	void injectDensity(void);
-	void injectDensityHelper(int i, int j, float x);
-	void injectVelocity(void);
-	void changeColorScheme(void);
+	void act(int action, float value = 0.0f)	{ m_log.action(m_sim, action, value); }
+	void thinOut(void)			{ act(eInputThinOut); }
+	void injectDensity(void)	{ act(eInputInjectDensity); }
+	void injectVelocity(void)	{ act(eInputInjectVelocity); }
+	void changeColorScheme(void)	{ m_mesh.changeColorScheme(); }
 	void toggleWireFrame(void);
-	void drawSphere(float scale = 0.1f);
-	void get_from_UI ( float * d, float * u, float * v );
+	void toggleLod(void)	{ m_mesh.toggleLod(); }
+	void toggleFlow(void);
+	void saveFlow(void);
+	void cycleMeshSize(void);
+	void toggleResampleFilter(void);
+	void resizeMesh(int n);
+	void drawSphere(const float model[16], float scale = 0.1f);
+	void get_from_UI ( void );
+	void exportTrace(void);
+	void dumpFrameStats(void);
+	void saveCheckpoint(void);
+	void loadCheckpoint(void);
+	void toggleRecording(void);
+	void toggleInputLog(void);
 
 	// Rendering
-	void setIndices(void);
+	void setIndices(void)	{ m_mesh.setIndices(); }
 	void updateRenderingArrays(void);
 
 	// Weather
-	void rainIntensityIncreace(bool increace);
-	void rainSpreadIncreace(bool increace);
-	void rainToggle(void) { m_bDrawRain = !m_bDrawRain; }
-	int getWindDirection(void)	{ return m_weather.getWindDirection(); }
+	void rainIntensityIncreace(bool increace)	{ act(eInputRainIntensity, increace ? 1.0f : -1.0f); }
+	void rainSpreadIncreace(bool increace)		{ act(eInputRainSpread, increace ? 1.0f : -1.0f); }
+	void rainToggle(void)		{ act(eInputRainToggle); }
+	int getWindDirection(void)	{ return m_sim.getWindDirection(); }
 
 	// Ship
-	void changeHeading(float there)	{ m_ship.changeHeading(there); }
-	void engage(float go)			{ m_ship.engage(go); }
-	void toTheSails(void)			{ m_ship.toTheSails(); }
+	void changeHeading(float there)	{ act(eInputHeading, there); }
+	void engage(float go)			{ act(eInputEngage, go); }
+	void toTheSails(void)			{ act(eInputSails); }
 
 public:
 
 	////////////////////////////////////////////////////////////////
 	// Fluid Draw Functions	
 	void draw_fluid  ( void );
-
-	////////////////////////////////////////////////////////////////
-	// Solver Functions
-	void add_source	( int N, float * x, float * s, float dt );
-	void set_bnd	( int N, int b, float * x );
-	void lin_solve	( int N, int b, float * x, float * x0, float a, float c );
-	void diffuse	( int N, int b, float * x, float * x0, float diff, float dt );
-	void advect		( int N, int b, float * d, float * d0, float * u, float * v, float dt );
-	void project	( int N, float * u, float * v, float * p, float * div );
-	void dens_step	( int N, float * x, float * x0, float * u, float * v, float diff, float dt );
-	void vel_step	( int N, float * u, float * v, float * u0, float * v0, float visc, float dt );
 };
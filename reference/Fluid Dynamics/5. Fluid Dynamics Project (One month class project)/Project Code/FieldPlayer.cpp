@@ -0,0 +1,285 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	"FieldPlayer.cpp"
+//
+// Purpose: Reads the recordings CFieldRecorder writes (see FieldRecorder.h), and measures what recording costs.
+//
+// Usage:	field_player info file				header, frames, steps and the compression ratio
+//			field_player dump file frame		min, max and mean of each field in one frame, and the mass
+//			field_player scrub file [seeks]		random access and sequential playback speed
+//			field_player bench [N] [frames] [every] [dropBits]
+//
+//			bench stirs a sim at N, times the steps alone and then with a recorder on, and prints the sim thread's
+//			copy, the writer's encode rate in raw GB/s, the ratio and any dropped frames. A lossless recording is
+//			then checked bit for bit against the sim.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "Simulation.h"
+#include "FieldRecorder.h"
+#include "Timer.h"
+
+#define BENCH_FILE		"bench.lrec"
+#define BENCH_WARMUP	20		// Steps before timing, so the fields are not mostly zero
+
+static int usage(const char *name)
+{
+	fprintf ( stderr, "usage : %s info file | dump file frame | scrub file [seeks] | bench [N] [frames] [every] [dropBits]\n",
+		name );
+	return 1;
+}
+
+static int openPlayer(CFieldPlayer &player, const char *path)
+{
+	const char *error = 0;
+	if(!player.open(path, &error))
+	{
+		fprintf ( stderr, "%s: %s\n", path, error );
+		return 0;
+	}
+	return 1;
+}
+
+static double rawFrameBytes(const tRecordHeader &h)
+{
+	return (double)totalRecordFieldCount*(h.N+2)*(h.N+2)*sizeof(float);
+}
+
+static int info(const char *path)
+{
+	CFieldPlayer player;
+	if(!openPlayer(player, path))
+		return 1;
+
+	const tRecordHeader &h = player.getHeader();
+	long long frames = player.getFrameCount();
+	FILE *file = fopen ( path, "rb" );
+	double bytes = 0.0;
+	char buffer[65536];
+	size_t read;
+	while(file && (read = fread ( buffer, 1, sizeof(buffer), file )) > 0)
+		bytes += read;
+	if(file)
+		fclose ( file );
+
+	printf ( "%s: version %u, N=%d, %.0f frames every %d steps, keyframe every %d, %s\n", path, h.version, h.N,
+		(double)frames, h.every, h.keyframe, h.dropBits ? "lossy" : "lossless" );
+	if(h.dropBits)
+		printf ( "error     %d mantissa bits dropped, relative error under %g\n", h.dropBits, ldexp(1.0, h.dropBits - 23) );
+	if(!h.indexOffset)
+		printf ( "index     none, the recording was not closed or was cut short (frames found by walking them)\n" );
+	if(frames)
+		printf ( "steps     %.0f to %.0f\n", (double)player.getStep(0), (double)player.getStep(frames - 1) );
+	double raw = rawFrameBytes(h)*frames;
+	printf ( "size      %.1f MB for %.1f MB of fields, %.2fx\n", bytes/1e6, raw/1e6, bytes > 0.0 ? raw/bytes : 0.0 );
+	return 0;
+}
+
+static int dump(const char *path, long long frame)
+{
+	CFieldPlayer player;
+	if(!openPlayer(player, path))
+		return 1;
+	if(!player.seek(frame))
+	{
+		fprintf ( stderr, "%s: no frame %.0f (%.0f frames)\n", path, (double)frame, (double)player.getFrameCount() );
+		return 1;
+	}
+
+	static const char *names[totalRecordFieldCount] = { "dens", "u", "v" };
+	int n = player.getHeader().N;
+	printf ( "frame %.0f, step %.0f\n", (double)frame, (double)player.getStep(frame) );
+	for(int f = 0; f < totalRecordFieldCount; f++)
+	{
+		const float *x = player.getField(f);
+		double sum = 0.0, lo = x[0], hi = x[0];
+		for(int k = 0; k < (n+2)*(n+2); k++)
+		{
+			sum += x[k];
+			if(x[k] < lo) lo = x[k];
+			if(x[k] > hi) hi = x[k];
+		}
+		printf ( "%-5s min %12g  max %12g  mean %12g\n", names[f], lo, hi, sum/((n+2)*(n+2)) );
+	}
+
+	double mass = 0.0;
+	const float *d = player.getField(eRecordDensity);
+	for(int j = 1; j <= n; j++)
+		for(int i = 1; i <= n; i++)
+			mass += d[i + (n+2)*j];
+	printf ( "mass  %g\n", mass );
+	return 0;
+}
+
+static int scrub(const char *path, int seeks)
+{
+	CFieldPlayer player;
+	if(!openPlayer(player, path))
+		return 1;
+	long long frames = player.getFrameCount();
+	if(!frames)
+	{
+		printf ( "%s: no frames\n", path );
+		return 0;
+	}
+
+	CTimer timer;
+	srand ( 1 );
+	for(int s = 0; s < seeks; s++)
+	{
+		if(!player.seek(rand() % frames))
+		{
+			fprintf ( stderr, "%s: frame %.0f will not decode\n", path, (double)player.getFrame() );
+			return 1;
+		}
+	}
+	double random = timer.GetElapsedSeconds();
+
+	timer.Reset();
+	for(long long f = 0; f < frames; f++)
+	{
+		if(!player.seek(f))
+		{
+			fprintf ( stderr, "%s: frame %.0f will not decode\n", path, (double)f );
+			return 1;
+		}
+	}
+	double sequential = timer.GetElapsedSeconds();
+
+	printf ( "random    %d seeks, %.2f ms each\n", seeks, 1e3*random/seeks );
+	printf ( "playback  %.0f frames, %.2f ms each, %.2f GB/s of fields\n", (double)frames, 1e3*sequential/frames,
+		rawFrameBytes(player.getHeader())*frames/sequential/1e9 );
+	return 0;
+}
+
+static void stir(CFluidSim &sim, float dt)
+{
+	int n = N;
+	float angle = 0.05f*sim.getSteps();
+	sim.clearSources();
+	sim.addDensitySource(n/2, n/2, sim.getSource());
+	sim.addVelocitySource(n/2, n/2, sim.getForce() * cosf(angle), sim.getForce() * sinf(angle));
+	sim.step(dt);
+}
+
+// The sim's fields in row order equal to the player's, bit for bit
+static int sameAsSim(CFluidSim &sim, const CFieldPlayer &player)
+{
+	int i, j, n = N;
+	const float *fields[totalRecordFieldCount] = { sim.getDensity(), sim.getU(), sim.getV() };
+	for(int f = 0; f < totalRecordFieldCount; f++)
+	{
+		const float *x = player.getField(f);
+		for ( j=0 ; j<n+2 ; j++ ) {
+			for ( i=0 ; i<n+2 ; i++ ) {
+				float value = f == eRecordDensity ? fields[f][IX(i,j)] : fields[f][VIX(i,j)];
+				if ( memcmp ( &value, &x[i+(n+2)*j], sizeof(float) ) ) return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+static int bench(int n, int frames, int every, int dropBits)
+{
+	const float dt = 0.1f;
+	CFluidSim sim;
+	if(!sim.allocateFluid(n))
+	{
+		fprintf ( stderr, "cannot allocate data\n" );
+		return 1;
+	}
+	sim.clearFluid();
+	sim.setParams(0.0001f, 0.0f, 5.0f, 100.0f);
+	for(int s = 0; s < BENCH_WARMUP; s++)
+		stir(sim, dt);
+
+	CTimer timer;
+	for(int s = 0; s < frames; s++)
+		stir(sim, dt);
+	double alone = timer.GetElapsedSeconds();
+
+	CFieldRecorder recorder;
+	if(!recorder.open(BENCH_FILE, every, dropBits))
+	{
+		fprintf ( stderr, "cannot record to %s\n", BENCH_FILE );
+		return 1;
+	}
+	timer.Reset();
+	for(int s = 0; s < frames; s++)
+	{
+		stir(sim, dt);
+		recorder.record(sim);
+	}
+	double recording = timer.GetElapsedSeconds();
+	timer.Reset();
+	int ok = recorder.close();
+	double draining = timer.GetElapsedSeconds();
+	if(!ok)
+	{
+		fprintf ( stderr, "the recorder failed to write %s\n", BENCH_FILE );
+		return 1;
+	}
+
+	long long recorded = recorder.getFrames();
+	double raw = (double)recorder.getRawBytes();
+	printf ( "N=%d, %d steps, every %d, %s\n", n, frames, every, dropBits ? "lossy" : "lossless" );
+	printf ( "step      %.2f ms alone, %.2f ms recording (%+.1f%%)\n", 1e3*alone/frames, 1e3*recording/frames,
+		100.0*(recording - alone)/alone );
+	printf ( "frames    %.0f recorded, %.0f dropped, %.1f ms to drain at close\n", (double)recorded,
+		(double)recorder.getDropped(), 1e3*draining );
+	if(!recorded)
+		return 1;
+	printf ( "copy      %.2f ms a frame on the sim thread, %.2f GB/s\n", 1e3*recorder.getCopySeconds()/recorded,
+		raw/recorder.getCopySeconds()/1e9 );
+	printf ( "encode    %.2f ms a frame on the writer, %.2f GB/s of fields\n", 1e3*recorder.getEncodeSeconds()/recorded,
+		raw/recorder.getEncodeSeconds()/1e9 );
+	printf ( "write     %.2f ms a frame, %.2f GB/s of fields\n", 1e3*recorder.getWriteSeconds()/recorded,
+		raw/recorder.getWriteSeconds()/1e9 );
+	printf ( "ratio     %.2fx, %.1f MB for %.1f MB\n", raw/recorder.getPackedBytes(), recorder.getPackedBytes()/1e6,
+		raw/1e6 );
+
+	CFieldPlayer player;
+	if(!openPlayer(player, BENCH_FILE))
+		return 1;
+	timer.Reset();
+	if(!player.seek(recorded - 1))
+	{
+		fprintf ( stderr, "the last frame will not decode\n" );
+		return 1;
+	}
+	printf ( "decode    %.2f ms a frame\n", 1e3*timer.GetElapsedSeconds()/(recorded - (recorded - 1)/RECORD_KEYFRAME*RECORD_KEYFRAME) );
+
+	int failed = 0;
+	if(!dropBits && player.getStep(recorded - 1) == sim.getSteps())
+	{
+		failed = !sameAsSim(sim, player);
+		printf ( "last frame against the sim: %s\n", failed ? "DIFFERENT" : "identical" );
+	}
+	player.close();
+	remove ( BENCH_FILE );
+	return failed;
+}
+
+int main(int argc, char *argv[])
+{
+	if(argc >= 3 && !strcmp(argv[1], "info"))
+		return info(argv[2]);
+	if(argc >= 4 && !strcmp(argv[1], "dump"))
+		return dump(argv[2], atol(argv[3]));
+	if(argc >= 3 && !strcmp(argv[1], "scrub"))
+		return scrub(argv[2], argc > 3 ? atoi(argv[3]) : 100);
+	if(argc >= 2 && !strcmp(argv[1], "bench"))
+	{
+		int n = argc > 2 ? atoi(argv[2]) : 256;
+		int frames = argc > 3 ? atoi(argv[3]) : 50;
+		int every = argc > 4 ? atoi(argv[4]) : 1;
+		int dropBits = argc > 5 ? atoi(argv[5]) : 0;
+		if(n < 8 || frames < 1 || every < 1 || dropBits < 0 || dropBits > 23)
+			return usage(argv[0]);
+		return bench(n, frames, every, dropBits);
+	}
+	return usage(argv[0]);
+}
@@ -0,0 +1,765 @@
+#include "FieldRecorder.h"
+#include "Simulation.h"
+#include "Profiler.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <process.h>	// _beginthreadex, the writer uses the CRT
+#else
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/types.h>
+#include <time.h>
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Threads, semaphores and 64 bit seeks
+
+#ifdef _WIN32
+
+static unsigned __stdcall writerThread(void *recorder)
+{
+	((CFieldRecorder *)recorder)->writer();
+	return 0;
+}
+
+static void *threadStart(CFieldRecorder *recorder)
+{
+	return (void *) _beginthreadex ( NULL, 0, writerThread, recorder, 0, NULL );
+}
+
+static void threadJoin(void *thread)
+{
+	WaitForSingleObject ( (HANDLE)thread, INFINITE );
+	CloseHandle ( (HANDLE)thread );
+}
+
+// The writer shares the cores with the sim, its own CPU time is what the encode costs
+static double threadSeconds(void)
+{
+	FILETIME created, exited, kernel, user;
+	if(!GetThreadTimes(GetCurrentThread(), &created, &exited, &kernel, &user))
+		return 0.0;
+	ULARGE_INTEGER k, u;
+	k.LowPart = kernel.dwLowDateTime; k.HighPart = kernel.dwHighDateTime;
+	u.LowPart = user.dwLowDateTime;	  u.HighPart = user.dwHighDateTime;
+	return (double)(k.QuadPart + u.QuadPart) * 1e-7;
+}
+
+static void *semCreate(int count)	{ return CreateSemaphoreA ( NULL, count, RECORD_QUEUE, NULL ); }
+static void semDestroy(void *sem)	{ CloseHandle ( (HANDLE)sem ); }
+static void semWait(void *sem)		{ WaitForSingleObject ( (HANDLE)sem, INFINITE ); }
+static int  semTryWait(void *sem)	{ return WaitForSingleObject ( (HANDLE)sem, 0 ) == WAIT_OBJECT_0; }
+static void semPost(void *sem)		{ ReleaseSemaphore ( (HANDLE)sem, 1, NULL ); }
+
+static int seekTo(FILE *file, long long offset)
+{
+	fpos_t position = offset;	// __int64 here, and the 2003 CRT has no _fseeki64
+	return fsetpos ( file, &position ) == 0;
+}
+
+#else
+
+static void *writerThread(void *recorder)
+{
+	((CFieldRecorder *)recorder)->writer();
+	return 0;
+}
+
+static void *threadStart(CFieldRecorder *recorder)
+{
+	pthread_t *thread = new pthread_t;
+	if(pthread_create(thread, NULL, writerThread, recorder))
+	{
+		delete thread;
+		return 0;
+	}
+	return thread;
+}
+
+static void threadJoin(void *thread)
+{
+	pthread_join ( *(pthread_t *)thread, NULL );
+	delete (pthread_t *)thread;
+}
+
+static double threadSeconds(void)
+{
+	timespec now;
+	if(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now))
+		return 0.0;
+	return now.tv_sec + 1e-9*now.tv_nsec;
+}
+
+static void *semCreate(int count)
+{
+	sem_t *sem = new sem_t;
+	if(sem_init(sem, 0, count))
+	{
+		delete sem;
+		return 0;
+	}
+	return sem;
+}
+
+static void semDestroy(void *sem)	{ sem_destroy ( (sem_t *)sem ); delete (sem_t *)sem; }
+static void semWait(void *sem)		{ while(sem_wait((sem_t *)sem) && errno == EINTR); }
+static int  semTryWait(void *sem)	{ return sem_trywait ( (sem_t *)sem ) == 0; }
+static void semPost(void *sem)		{ sem_post ( (sem_t *)sem ); }
+
+static int seekTo(FILE *file, long long offset)
+{
+	return fseeko ( file, (off_t)offset, SEEK_SET ) == 0;
+}
+
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Codec
+//
+// A control byte, then: 0x00-0x7E, that many plus one literal bytes follow. 0x7F, a little endian 32 bit count and
+// that many literal bytes. 0x80-0xFE, that many minus 0x7F zeros. 0xFF, a 32 bit count of zeros. The XOR of two
+// frames split into byte planes is long zero runs in the exponent and high mantissa planes and noise in the low ones,
+// which this packs at memcpy and memset speed.
+
+static unsigned char *putCount(unsigned char *out, unsigned int count)
+{
+	out[0] = (unsigned char)(count);
+	out[1] = (unsigned char)(count >> 8);
+	out[2] = (unsigned char)(count >> 16);
+	out[3] = (unsigned char)(count >> 24);
+	return out + 4;
+}
+
+static unsigned char *putLiterals(unsigned char *out, const unsigned char *in, long long count)
+{
+	while(count > 0)
+	{
+		unsigned int run = count < 0xFFFFFFFFLL ? (unsigned int)count : 0xFFFFFFFFu;
+		if(run < 0x80)
+			*out++ = (unsigned char)(run - 1);
+		else
+		{
+			*out++ = 0x7F;
+			out = putCount(out, run);
+		}
+		memcpy ( out, in, run );
+		out		+= run;
+		in		+= run;
+		count	-= run;
+	}
+	return out;
+}
+
+static unsigned char *putZeros(unsigned char *out, long long count)
+{
+	while(count > 0)
+	{
+		unsigned int run = count < 0xFFFFFFFFLL ? (unsigned int)count : 0xFFFFFFFFu;
+		if(run < 0x80)
+			*out++ = (unsigned char)(0x7F + run);
+		else
+		{
+			*out++ = 0xFF;
+			out = putCount(out, run);
+		}
+		count -= run;
+	}
+	return out;
+}
+
+long long packBound(long long n)
+{
+	return n + n/8 + 16;	// At worst a literal and a zero run for every 9 bytes
+}
+
+static int countZeros(const unsigned char *in, int n)
+{
+	int zeros = 0;
+	for(int k = 0; k < n; k++)
+		zeros += in[k] == 0;
+	return zeros;
+}
+
+long long packBytes(const unsigned char *in, long long n, unsigned char *out)
+{
+	unsigned char *o = out;
+	long long i = 0, literal = 0;
+	unsigned long long w;
+
+	while(i < n)
+	{
+		// A block with next to no zeros is noise (the low mantissa planes), it stays in the literal unscanned
+		long long block = n - i < RECORD_BLOCK ? n - i : RECORD_BLOCK;
+		if(countZeros(in + i, (int)block) < block/RECORD_SPARSE)
+		{
+			i += block;
+			continue;
+		}
+
+		// Runs are found a word at a time, then widened to the zero bytes either side
+		long long blockEnd = i + block;
+		while(i < blockEnd)
+		{
+			if(i + 8 > n)
+			{
+				i = n;
+				break;
+			}
+			memcpy ( &w, in + i, 8 );
+			if(w)
+			{
+				i += 8;
+				continue;
+			}
+
+			long long z = i + 8;
+			while(z + 8 <= n)
+			{
+				memcpy ( &w, in + z, 8 );
+				if(w)
+					break;
+				z += 8;
+			}
+			while(z < n && !in[z])
+				z++;
+			while(i > literal && !in[i-1])
+				i--;
+
+			o = putLiterals(o, in + literal, i - literal);
+			o = putZeros(o, z - i);
+			i = literal = z;
+		}
+	}
+	o = putLiterals(o, in + literal, n - literal);
+	return o - out;
+}
+
+int unpackBytes(const unsigned char *in, long long bytes, unsigned char *out, long long n)
+{
+	const unsigned char *end = in + bytes;
+	long long done = 0;
+
+	while(in < end)
+	{
+		unsigned int c = *in++;
+		long long run = (c & 0x7F) + 1;
+		if(c == 0x7F || c == 0xFF)
+		{
+			if(end - in < 4)
+				return 0;
+			run = in[0] | (in[1] << 8) | (in[2] << 16) | ((long long)in[3] << 24);
+			in += 4;
+		}
+		if(done + run > n)
+			return 0;
+
+		if(c < 0x80)
+		{
+			if(run > end - in)
+				return 0;
+			memcpy ( out + done, in, (size_t)run );
+			in += run;
+		}
+		else
+			memset ( out + done, 0, (size_t)run );
+		done += run;
+	}
+	return done == n;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// CFieldRecorder
+
+CFieldRecorder::CFieldRecorder(void)
+{
+	m_file = 0;
+	memset ( &m_header, 0, sizeof(m_header) );
+	memset ( m_slots, 0, sizeof(m_slots) );
+	for(int f = 0; f < totalRecordFieldCount; f++)
+	{
+		m_previous[f]	= 0;
+		m_packed[f]		= 0;
+	}
+	m_planes	= 0;
+	m_row		= 0;
+	m_index		= 0;
+	m_thread	= 0;
+	m_free		= 0;
+	m_full		= 0;
+	m_written = m_read = m_calls = 0;
+	m_indexSize = m_offset = 0;
+	m_failed	= 0;
+	m_dropped	= 0;
+	m_copySeconds = m_encodeSeconds = m_writeSeconds = 0.0;
+	m_packedBytes = 0;
+}
+
+CFieldRecorder::~CFieldRecorder(void)
+{
+	close();
+}
+
+void CFieldRecorder::freeBuffers(void)
+{
+	for(int s = 0; s < RECORD_QUEUE; s++)
+	{
+		free ( m_slots[s].density );
+		free ( m_slots[s].velocity );
+		free ( m_slots[s].v );
+	}
+	memset ( m_slots, 0, sizeof(m_slots) );
+	for(int f = 0; f < totalRecordFieldCount; f++)
+	{
+		free ( m_previous[f] );
+		free ( m_packed[f] );
+		m_previous[f] = 0;
+		m_packed[f] = 0;
+	}
+	free ( m_planes );
+	free ( m_row );
+	free ( m_index );
+	m_planes	= 0;
+	m_row		= 0;
+	m_index		= 0;
+	m_indexSize	= 0;
+
+	if(m_free)
+		semDestroy(m_free);
+	if(m_full)
+		semDestroy(m_full);
+	m_free = m_full = 0;
+}
+
+int CFieldRecorder::open(const char *path, int every, int dropBits)
+{
+	close();
+	if(every < 1 || dropBits < 0 || dropBits > 23)
+		return 0;
+
+	memset ( &m_header, 0, sizeof(m_header) );
+	memcpy ( m_header.magic, RECORD_MAGIC, 8 );
+	m_header.version		= RECORD_VERSION;
+	m_header.headerBytes	= sizeof(tRecordHeader);
+	m_header.N				= N;
+	m_header.every			= every;
+	m_header.keyframe		= RECORD_KEYFRAME;
+	m_header.dropBits		= dropBits;
+
+	// Everything the writer needs is allocated up front, a frame costs no allocation on either thread
+	long long cells = (long long)(N+2)*(N+2);
+	int ok = 1;
+	for(int s = 0; s < RECORD_QUEUE; s++)
+	{
+		m_slots[s].density	= (float *) malloc ( FIELD_SIZE(N)*sizeof(float) );
+		m_slots[s].velocity	= (float *) malloc ( VEL_SIZE(N)*sizeof(float) );
+		ok = ok && m_slots[s].density && m_slots[s].velocity;
+#if VELOCITY_LAYOUT == VELOCITY_LAYOUT_PLANAR
+		m_slots[s].v		= (float *) malloc ( VEL_SIZE(N)*sizeof(float) );
+		ok = ok && m_slots[s].v;
+#endif
+	}
+	for(int f = 0; f < totalRecordFieldCount; f++)
+	{
+		m_previous[f]	= (unsigned int *) calloc ( (size_t)cells, sizeof(unsigned int) );
+		m_packed[f]		= (unsigned char *) malloc ( (size_t)packBound(4*cells) );
+		ok = ok && m_previous[f] && m_packed[f];
+	}
+	m_planes	= (unsigned char *) malloc ( (size_t)(4*cells) );
+	m_row		= (float *) malloc ( (N+2)*sizeof(float) );
+	m_indexSize	= 1024;
+	m_index		= (tRecordIndex *) malloc ( (size_t)m_indexSize*sizeof(tRecordIndex) );
+	m_free		= semCreate(RECORD_QUEUE);
+	m_full		= semCreate(0);
+	if(!ok || !m_planes || !m_row || !m_index || !m_free || !m_full)
+	{
+		freeBuffers();
+		return 0;
+	}
+
+	m_file = fopen ( path, "wb" );
+	if(!m_file)
+	{
+		freeBuffers();
+		return 0;
+	}
+	// Rewritten with the frame count and index at close
+	fwrite ( &m_header, sizeof(m_header), 1, m_file );
+
+	m_offset	= sizeof(m_header);
+	m_written	= m_read = m_calls = 0;
+	m_failed	= 0;
+	m_dropped	= 0;
+	m_copySeconds = m_encodeSeconds = m_writeSeconds = 0.0;
+	m_packedBytes = 0;
+
+	m_thread = threadStart(this);
+	if(!m_thread)
+	{
+		fclose ( m_file );
+		m_file = 0;
+		remove ( path );
+		freeBuffers();
+		return 0;
+	}
+	return 1;
+}
+
+int CFieldRecorder::record(CFluidSim &sim)
+{
+	if(!m_file || m_calls++ % m_header.every)
+		return 0;
+
+	// A full queue means the writer is behind, drop this one rather than wait for it
+	if(N != m_header.N || !semTryWait(m_free))
+	{
+		m_dropped++;
+		return 0;
+	}
+
+	PROFILE_ZONE("record copy");
+	CTimer copy;
+	tSlot &slot = m_slots[m_written % RECORD_QUEUE];
+	memcpy ( slot.density, sim.getDensity(), FIELD_SIZE(N)*sizeof(float) );
+	memcpy ( slot.velocity, sim.getU(), VEL_SIZE(N)*sizeof(float) );
+#if VELOCITY_LAYOUT == VELOCITY_LAYOUT_PLANAR
+	memcpy ( slot.v, sim.getV(), VEL_SIZE(N)*sizeof(float) );
+#endif
+	slot.step = sim.getSteps();
+	slot.stop = 0;
+	m_written++;
+	semPost(m_full);
+	m_copySeconds += copy.GetElapsedSeconds();
+	return 1;
+}
+
+int CFieldRecorder::close(void)
+{
+	if(!m_file)
+		return 1;
+
+	// The stop goes through the queue behind the frames still in it
+	semWait(m_free);
+	m_slots[m_written % RECORD_QUEUE].stop = 1;
+	m_written++;
+	semPost(m_full);
+	threadJoin(m_thread);
+	m_thread = 0;
+
+	m_header.indexOffset = m_offset;
+	int ok = !m_failed
+		&& fwrite ( m_index, sizeof(tRecordIndex), (size_t)m_header.frames, m_file ) == (size_t)m_header.frames
+		&& seekTo(m_file, 0)
+		&& fwrite ( &m_header, sizeof(m_header), 1, m_file ) == 1;
+	ok = (fclose ( m_file ) == 0) && ok;
+	m_file = 0;
+
+	freeBuffers();
+	return ok;
+}
+
+void CFieldRecorder::writer(void)
+{
+	PROFILE_THREAD_NAME("recorder");
+	for(;;)
+	{
+		semWait(m_full);
+		const tSlot &slot = m_slots[m_read % RECORD_QUEUE];
+		if(slot.stop)
+			break;
+		encode(slot);
+		m_read++;
+		semPost(m_free);
+	}
+}
+
+// XOR one row against the last frame as stored and split it into byte planes
+static void shuffleRow(const float * RESTRICT row, unsigned int * RESTRICT previous, unsigned char * RESTRICT p0,
+					   unsigned char * RESTRICT p1, unsigned char * RESTRICT p2, unsigned char * RESTRICT p3, int count,
+					   unsigned int mask, unsigned int keep)
+{
+	for(int i = 0; i < count; i++)
+	{
+		unsigned int bits;
+		memcpy ( &bits, &row[i], 4 );
+		bits &= mask;
+		unsigned int d = bits ^ (previous[i] & keep);
+		previous[i] = bits;
+		p0[i] = (unsigned char)d;
+		p1[i] = (unsigned char)(d >> 8);
+		p2[i] = (unsigned char)(d >> 16);
+		p3[i] = (unsigned char)(d >> 24);
+	}
+}
+
+void CFieldRecorder::encode(const tSlot &slot)
+{
+	PROFILE_ZONE("record encode");
+	double cpu = threadSeconds();
+
+	// IX and VIX read this N rather than the global one, which a restore could change under the writer
+	const int N = m_header.N;
+	int i, j, n = N;
+	long long cells = (long long)(n+2)*(n+2);
+	int key = m_header.frames % RECORD_KEYFRAME == 0;
+	unsigned int keep = key ? 0 : ~0u;	// Of the last frame, a keyframe XORs against nothing
+	unsigned int mask = ~((1u << m_header.dropBits) - 1);
+
+#if VELOCITY_LAYOUT == VELOCITY_LAYOUT_PLANAR
+	const float *fields[totalRecordFieldCount] = { slot.density, slot.velocity, slot.v };
+#else
+	const float *fields[totalRecordFieldCount] = { slot.density, slot.velocity, slot.velocity + VEL_V_OFFSET };
+#endif
+
+	tRecordFrame frame;
+	memset ( &frame, 0, sizeof(frame) );
+	frame.step		= slot.step;
+	frame.keyframe	= key;
+
+	// Rows are gathered first so the shuffle runs on contiguous memory whatever the layout
+	float *row = m_row;
+	for(int f = 0; f < totalRecordFieldCount; f++)
+	{
+		const float *x = fields[f];
+		for ( j=0 ; j<n+2 ; j++ ) {
+			if ( f == eRecordDensity ) {
+				for ( i=0 ; i<n+2 ; i++ ) row[i] = x[IX(i,j)];
+			} else {
+				for ( i=0 ; i<n+2 ; i++ ) row[i] = x[VIX(i,j)];
+			}
+			long long start = (long long)(n+2)*j;
+			shuffleRow(m_row, m_previous[f] + start, m_planes + start, m_planes + cells + start,
+				m_planes + 2*cells + start, m_planes + 3*cells + start, n+2, mask, keep);
+		}
+		frame.bytes[f] = packBytes(m_planes, 4*cells, m_packed[f]);
+	}
+	m_encodeSeconds += threadSeconds() - cpu;
+
+	CTimer timer;
+	long long bytes = sizeof(frame);
+	int ok = !m_failed && fwrite ( &frame, sizeof(frame), 1, m_file ) == 1;
+	for(int f = 0; f < totalRecordFieldCount && ok; f++)
+	{
+		ok = fwrite ( m_packed[f], 1, (size_t)frame.bytes[f], m_file ) == (size_t)frame.bytes[f];
+		bytes += frame.bytes[f];
+	}
+	m_writeSeconds += timer.GetElapsedSeconds();
+	if(!ok)
+	{
+		m_failed = 1;
+		return;
+	}
+
+	if(m_header.frames == m_indexSize)
+	{
+		tRecordIndex *index = (tRecordIndex *) realloc ( m_index, (size_t)(2*m_indexSize)*sizeof(tRecordIndex) );
+		if(!index)
+		{
+			m_failed = 1;
+			return;
+		}
+		m_index = index;
+		m_indexSize *= 2;
+	}
+	m_index[m_header.frames].offset	= m_offset;
+	m_index[m_header.frames].step	= slot.step;
+	m_header.frames++;
+	m_offset		+= bytes;
+	m_packedBytes	+= bytes;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// CFieldPlayer
+
+CFieldPlayer::CFieldPlayer(void)
+{
+	m_file = 0;
+	memset ( &m_header, 0, sizeof(m_header) );
+	m_index = 0;
+	m_frame = -1;
+	for(int f = 0; f < totalRecordFieldCount; f++)
+		m_fields[f] = 0;
+	m_planes = 0;
+	m_packed = 0;
+	m_packedSize = 0;
+}
+
+CFieldPlayer::~CFieldPlayer(void)
+{
+	close();
+}
+
+void CFieldPlayer::close(void)
+{
+	if(m_file)
+		fclose ( m_file );
+	m_file = 0;
+	free ( m_index );
+	m_index = 0;
+	for(int f = 0; f < totalRecordFieldCount; f++)
+	{
+		free ( m_fields[f] );
+		m_fields[f] = 0;
+	}
+	free ( m_planes );
+	free ( m_packed );
+	m_planes = 0;
+	m_packed = 0;
+	m_packedSize = 0;
+	m_frame = -1;
+}
+
+void CFieldPlayer::walk(void)
+{
+	// Never closed or cut short, index the frames up to the first one that is not all there
+	long long size = 0, offset = sizeof(tRecordHeader);
+	free ( m_index );
+	m_index = 0;
+	m_header.frames = 0;
+	for(;;)
+	{
+		tRecordFrame frame;
+		char last;
+		if(!seekTo(m_file, offset) || fread ( &frame, sizeof(frame), 1, m_file ) != 1)
+			break;
+		long long bytes = sizeof(frame);
+		for(int f = 0; f < totalRecordFieldCount; f++)
+			bytes += frame.bytes[f] < 0 ? 0 : frame.bytes[f];
+		if(!seekTo(m_file, offset + bytes - 1) || fread ( &last, 1, 1, m_file ) != 1)
+			break;
+
+		if(m_header.frames == size)
+		{
+			size = size ? 2*size : 1024;
+			tRecordIndex *index = (tRecordIndex *) realloc ( m_index, (size_t)size*sizeof(tRecordIndex) );
+			if(!index)
+				break;
+			m_index = index;
+		}
+		m_index[m_header.frames].offset	= offset;
+		m_index[m_header.frames].step	= frame.step;
+		m_header.frames++;
+		offset += bytes;
+	}
+}
+
+int CFieldPlayer::open(const char *path, const char **error)
+{
+	close();
+
+	const char *reason = 0;
+	m_file = fopen ( path, "rb" );
+	if(!m_file)
+		reason = "cannot open the file";
+	else if(fread ( &m_header, sizeof(m_header), 1, m_file ) != 1 || memcmp(m_header.magic, RECORD_MAGIC, 8))
+		reason = "not a recording";
+	else if(m_header.version != RECORD_VERSION || m_header.headerBytes != sizeof(tRecordHeader))
+		reason = "written by another version";
+	else if(m_header.N < 1 || m_header.keyframe < 1 || m_header.frames < 0)
+		reason = "corrupt header";
+	else
+	{
+		int indexed = 0;
+		if(m_header.indexOffset)
+		{
+			m_index = (tRecordIndex *) malloc ( (size_t)(m_header.frames ? m_header.frames : 1)*sizeof(tRecordIndex) );
+			indexed = m_index && seekTo(m_file, m_header.indexOffset)
+				&& fread ( m_index, sizeof(tRecordIndex), (size_t)m_header.frames, m_file ) == (size_t)m_header.frames;
+		}
+		if(!indexed)
+		{
+			m_header.indexOffset = 0;
+			walk();
+		}
+	}
+
+	if(!reason)
+	{
+		long long cells = (long long)(m_header.N+2)*(m_header.N+2);
+		for(int f = 0; f < totalRecordFieldCount; f++)
+		{
+			m_fields[f] = (unsigned int *) calloc ( (size_t)cells, sizeof(unsigned int) );
+			if(!m_fields[f])
+				reason = "cannot allocate the fields";
+		}
+		m_planes = (unsigned char *) malloc ( (size_t)(4*cells) );
+		if(!m_planes)
+			reason = "cannot allocate the fields";
+	}
+
+	if(reason)
+	{
+		close();
+		if(error)
+			*error = reason;
+		return 0;
+	}
+	return 1;
+}
+
+int CFieldPlayer::decode(long long frame)
+{
+	long long cells = (long long)(m_header.N+2)*(m_header.N+2);
+	tRecordFrame record;
+	if(!seekTo(m_file, m_index[frame].offset) || fread ( &record, sizeof(record), 1, m_file ) != 1)
+		return 0;
+
+	unsigned char *p0 = m_planes, *p1 = p0 + cells, *p2 = p1 + cells, *p3 = p2 + cells;
+	for(int f = 0; f < totalRecordFieldCount; f++)
+	{
+		long long bytes = record.bytes[f];
+		if(bytes < 0 || bytes > packBound(4*cells))
+			return 0;
+		if(bytes > m_packedSize)
+		{
+			unsigned char *packed = (unsigned char *) realloc ( m_packed, (size_t)bytes );
+			if(!packed)
+				return 0;
+			m_packed = packed;
+			m_packedSize = bytes;
+		}
+		if(fread ( m_packed, 1, (size_t)bytes, m_file ) != (size_t)bytes || !unpackBytes(m_packed, bytes, m_planes, 4*cells))
+			return 0;
+
+		unsigned int *x = m_fields[f];
+		if(record.keyframe)
+		{
+			for(long long k = 0; k < cells; k++)
+				x[k] = p0[k] | (p1[k] << 8) | (p2[k] << 16) | ((unsigned int)p3[k] << 24);
+		}
+		else
+		{
+			for(long long k = 0; k < cells; k++)
+				x[k] ^= p0[k] | (p1[k] << 8) | (p2[k] << 16) | ((unsigned int)p3[k] << 24);
+		}
+	}
+	return 1;
+}
+
+int CFieldPlayer::seek(long long frame)
+{
+	if(!m_file || frame < 0 || frame >= m_header.frames)
+		return 0;
+	if(frame == m_frame)
+		return 1;
+
+	// From the keyframe, or on from here when it is between that and the frame
+	long long start = frame - frame % m_header.keyframe;
+	if(m_frame >= start && m_frame < frame)
+		start = m_frame + 1;
+
+	for(long long f = start; f <= frame; f++)
+	{
+		if(!decode(f))
+		{
+			m_frame = -1;
+			return 0;
+		}
+	}
+	m_frame = frame;
+	return 1;
+}
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <stdio.h>
+#include "Def.h"
+#include "Timer.h"
+
+class CFluidSim;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Class:	"CFieldRecorder"
+//
+// Purpose: Streams the density and velocity to disk every frame (or every k frames) for replay and offline analysis.
+//			The sim thread only copies the fields into one of RECORD_QUEUE slots and carries on; a writer thread turns
+//			each copy into the article's (N+2)*(N+2) row order, XORs it against the frame before, splits the floats
+//			into byte planes and packs the zero runs that leaves, then writes it. When the writer falls behind a frame
+//			is dropped rather than waiting, so queue memory is fixed and the sim never blocks on the disk. Every
+//			RECORD_KEYFRAME frames is stored whole, and a frame index at the end makes any frame a seek and at most
+//			RECORD_KEYFRAME-1 deltas away.
+//
+//			Lossless by default. Dropping the low mantissa bits bounds the relative error of every value to
+//			2^(dropBits-23) and gives the codec many more zeros to pack.
+//
+// Usage:	open(path, every, dropBits), then record(sim) after every step and close() at the end (the destructor
+//			does too). CFieldPlayer reads a recording back, field_player prints, scrubs and benchmarks them.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define RECORD_MAGIC		"LUMENREC"
+#define RECORD_VERSION		1
+#define RECORD_QUEUE		4		// Frames copied and waiting for the writer, more are dropped
+#define RECORD_KEYFRAME		32		// Frames between whole frames
+#define RECORD_BLOCK		4096	// Bytes the packer looks at before scanning them for runs
+#define RECORD_SPARSE		64		// A block with under 1/64 zeros is left as a literal
+
+enum eRecordField{eRecordDensity = 0, eRecordU, eRecordV, totalRecordFieldCount};
+
+// Fixed size types only, the same file reads on any compiler
+struct tRecordHeader
+{
+	char		magic[8];		// RECORD_MAGIC, no terminator
+	unsigned int version;
+	unsigned int headerBytes;
+	int			N;
+	int			every;			// Sim steps between recorded frames
+	int			keyframe;		// RECORD_KEYFRAME when written
+	int			dropBits;		// Low mantissa bits zeroed, 0 is lossless
+	long long	frames;
+	long long	indexOffset;	// 0 until close() writes the index
+};
+
+// Before every frame, then the packed fields in eRecordField order
+struct tRecordFrame
+{
+	long long	step;			// CFluidSim::getSteps when recorded
+	int			keyframe;		// Stored whole, not as a delta
+	int			pad;
+	long long	bytes[totalRecordFieldCount];
+};
+
+struct tRecordIndex
+{
+	long long	offset;			// Of the tRecordFrame
+	long long	step;
+};
+
+// The codec, exposed for the benchmark. Zero runs and literal runs of bytes, packBytes needs packBound(n) of output
+long long packBound(long long n);
+long long packBytes(const unsigned char *in, long long n, unsigned char *out);
+int		  unpackBytes(const unsigned char *in, long long bytes, unsigned char *out, long long n);	// Checks the sizes
+
+class CFieldRecorder
+{
+
+private:
+
+	struct tSlot
+	{
+		float		*density;
+		float		*velocity;	// u, and v in the paired layouts
+		float		*v;			// Planar only
+		long long	step;
+		int			stop;		// Tells the writer to finish
+	};
+
+	FILE			*m_file;
+	tRecordHeader	m_header;
+	tSlot			m_slots[RECORD_QUEUE];
+	long long		m_written;	// Slots handed to the writer, it takes them in the same order
+	long long		m_read;
+	long long		m_calls;
+
+	// Writer side
+	unsigned int	*m_previous[totalRecordFieldCount];	// Last frame, row order, as stored
+	float			*m_row;		// One row gathered from the slot
+	unsigned char	*m_planes;
+	unsigned char	*m_packed[totalRecordFieldCount];
+	tRecordIndex	*m_index;
+	long long		m_indexSize;
+	long long		m_offset;
+	int				m_failed;
+
+	void			*m_thread;
+	void			*m_free;	// Semaphores, slots free and slots full
+	void			*m_full;
+
+	// Counters, the writer's are only read once it has stopped
+	long long		m_dropped;
+	double			m_copySeconds;
+	double			m_encodeSeconds;
+	double			m_writeSeconds;
+	long long		m_packedBytes;
+
+	void encode(const tSlot &slot);
+	void freeBuffers(void);
+
+	CFieldRecorder(const CFieldRecorder&);
+	CFieldRecorder&operator = (const CFieldRecorder&);
+
+public:
+
+	CFieldRecorder(void);
+	~CFieldRecorder(void);
+
+	int  open(const char *path, int every = 1, int dropBits = 0);
+	int  close(void);	// Waits for the writer, returns 0 if anything failed to write
+	bool isOpen(void) const	{ return m_file != 0; }
+
+	// Returns 1 if the frame was queued, 0 if it was not its turn, the queue was full or N changed
+	int  record(CFluidSim &sim);
+
+	// The writer thread's part of the loop
+	void writer(void);
+
+	long long getFrames(void) const			{ return m_header.frames; }
+	long long getDropped(void) const		{ return m_dropped; }
+	long long getRawBytes(void) const		{ return m_header.frames*totalRecordFieldCount*(long long)((m_header.N+2)*(m_header.N+2))*4; }
+	long long getPackedBytes(void) const	{ return m_packedBytes; }
+	double getCopySeconds(void) const		{ return m_copySeconds; }	// Sim thread
+	double getEncodeSeconds(void) const		{ return m_encodeSeconds; }	// CPU time on the writer thread
+	double getWriteSeconds(void) const		{ return m_writeSeconds; }	// Wall time on the writer thread
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Class:	"CFieldPlayer"
+//
+// Purpose: Random access into a recording. seek() decodes from the keyframe at or before the frame, or straight on from
+//			the frame it is on when that is closer, and the fields come back in row order, (N+2)*(N+2) floats indexed
+//			i+(N+2)*j whatever layout recorded them. A recording whose writer never closed it (or that was cut short)
+//			has no index to read, the frames are found by walking them instead.
+//
+// Usage:	open(path), seek(frame), getField(eRecordDensity) and so on.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class CFieldPlayer
+{
+
+private:
+
+	FILE			*m_file;
+	tRecordHeader	m_header;
+	tRecordIndex	*m_index;
+	long long		m_frame;	// Decoded into m_fields, -1 for none
+	unsigned int	*m_fields[totalRecordFieldCount];
+	unsigned char	*m_planes;
+	unsigned char	*m_packed;
+	long long		m_packedSize;
+
+	int  decode(long long frame);
+	void walk(void);
+
+	CFieldPlayer(const CFieldPlayer&);
+	CFieldPlayer&operator = (const CFieldPlayer&);
+
+public:
+
+	CFieldPlayer(void);
+	~CFieldPlayer(void);
+
+	// Returns 0 (with the reason in error) if the file is not a recording this build reads
+	int  open(const char *path, const char **error = 0);
+	void close(void);
+
+	const tRecordHeader &getHeader(void) const	{ return m_header; }
+	long long getFrameCount(void) const			{ return m_header.frames; }
+	long long getStep(long long frame) const	{ return m_index[frame].step; }
+
+	int seek(long long frame);		// Returns 0 if it is out of range or will not decode
+	long long getFrame(void) const	{ return m_frame; }
+	const float *getField(int field) const	{ return (const float *)m_fields[field]; }
+};
@@ -0,0 +1,231 @@
+#include "FieldResampler.h"
+#include "Solver.h"		// allocate_field, allocate_velocity
+#include "Profiler.h"
+
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RESAMPLE_SSE
+#endif
+
+// The weights of the taps around a point f of the way from one cell to the next: bilinear's on those two, Catmull-Rom's
+// on the one before to the one after. f is 0 to 1 but for the boundary cells of a coarser output, where either
+// filter's weights extrapolate, and still reproduce a linear field
+static void tapWeights(int filter, float f, float w[RESAMPLE_TAPS])
+{
+	if(filter == eResampleBicubic)
+	{
+		float f2 = f*f, f3 = f2*f;
+		w[0] = 0.5f*(-f3 + 2.0f*f2 - f);
+		w[1] = 0.5f*(3.0f*f3 - 5.0f*f2 + 2.0f);
+		w[2] = 0.5f*(-3.0f*f3 + 4.0f*f2 + f);
+		w[3] = 0.5f*(f3 - f2);
+	}
+	else
+	{
+		w[0] = 1.0f - f;
+		w[1] = f;
+		w[2] = w[3] = 0.0f;
+	}
+}
+
+CFieldResampler::CFieldResampler(void)
+{
+	m_dens = m_u = m_v = NULL;
+	m_source	= NULL;
+	m_rows		= NULL;
+	m_first		= NULL;
+	m_weights	= NULL;
+	m_taps = m_size = m_from = 0;
+	m_filter	= eResampleBicubic;
+}
+
+CFieldResampler::~CFieldResampler(void)
+{
+	freeResampler();
+}
+
+void CFieldResampler::freeSource(void)
+{
+	free ( m_source );
+	free ( m_rows );
+	free ( m_first );
+	free ( m_weights );
+	m_source	= NULL;
+	m_rows		= NULL;
+	m_first		= NULL;
+	m_weights	= NULL;
+	m_from		= 0;
+}
+
+void CFieldResampler::freeResampler(void)
+{
+	freeSource();
+	free_field ( m_dens );
+	free_velocity ( m_u, m_v );
+	m_dens = m_u = m_v = NULL;
+	m_size = 0;
+}
+
+int CFieldResampler::allocate(int size, int filter)
+{
+	freeResampler();
+
+	m_dens = allocate_field ( size );
+	allocate_velocity ( size, &m_u, &m_v );
+	if ( !m_dens || !m_u || !m_v ) {
+		freeResampler();
+		return ( 0 );
+	}
+
+	m_size		= size;
+	m_filter	= filter;
+	return ( 1 );
+}
+
+// The source rows and the taps for resampling from a grid from cells a side, when they are not already for it
+int CFieldResampler::prepare(int from)
+{
+	if(from == m_from)
+		return ( 1 );
+	freeSource();
+
+	// The rows are read four floats from each output's first tap, bilinear's two past its own on the last
+	size_t width = from + 2, rowLength = from + RESAMPLE_TAPS, outputs = m_size + 2;
+	m_source	= (float *) malloc ( width*width*sizeof(*m_source) );
+	m_rows		= (float *) calloc ( outputs*rowLength, sizeof(*m_rows) );
+	m_first		= (int *) malloc ( outputs*sizeof(*m_first) );
+	m_weights	= (float (*)[RESAMPLE_TAPS]) malloc ( outputs*sizeof(*m_weights) );
+	if ( !m_source || !m_rows || !m_first || !m_weights ) {
+		freeSource();
+		return ( 0 );
+	}
+
+	// Output cell k's centre in source cells, and the taps around it. A tap past either edge cell is the line through
+	// that cell and the next one in, so the edges keep their slope. A coarser output's boundary cells lie past the
+	// source's, there f goes outside 0 to 1 and the weights extrapolate along the same line
+	m_taps = m_filter == eResampleBicubic ? 4 : 2;
+	for (int k = 0; k <= m_size + 1; k++)
+	{
+		float at = (k - 0.5f)*from/m_size + 0.5f;
+		int cell = at < 0.0f ? 0 : ((int)at < from ? (int)at : from);
+		float w[RESAMPLE_TAPS];
+		tapWeights(m_filter, at - cell, w);
+
+		int lowest = cell - (m_taps/2 - 1);
+		int first = lowest < 0 ? 0 : (lowest > from + 2 - m_taps ? from + 2 - m_taps : lowest);
+		memset ( m_weights[k], 0, sizeof(m_weights[k]) );
+		for (int t = 0; t < m_taps; t++)
+		{
+			int tap = lowest + t, edge = tap < 0 ? 0 : (tap > from + 1 ? from + 1 : tap);
+			if(edge == tap)
+				m_weights[k][tap - first] += w[t];
+			else
+			{
+				int inside = edge == 0 ? 1 : from;
+				m_weights[k][edge - first] += 2.0f*w[t];
+				m_weights[k][inside - first] -= w[t];
+			}
+		}
+		m_first[k] = first;
+	}
+	m_from = from;
+	return ( 1 );
+}
+
+int CFieldResampler::resample(const float *dens, const float *u, const float *v)
+{
+	PROFILE_ZONE("resample");
+	if(!m_dens || !prepare(N))
+		return ( 0 );
+
+	resampleField(dens, m_dens, false);
+	resampleField(u, m_u, true);
+	resampleField(v, m_v, true);
+	return ( 1 );
+}
+
+void CFieldResampler::resampleField(const float *field, float *out, bool velocity)
+{
+	int i, j;
+
+	// Out of the solver's layout into plain rows
+	#pragma omp parallel for private(i)
+	for (j = 0; j <= N + 1; j++)
+	{
+		float *row = m_source + (size_t)j*(N + 2);
+		if(velocity)
+			for (i = 0; i <= N + 1; i++)
+				row[i] = field[VIX(i,j)];
+		else
+			for (i = 0; i <= N + 1; i++)
+				row[i] = field[IX(i,j)];
+	}
+
+	#pragma omp parallel for
+	for (j = 0; j <= m_size + 1; j++)
+		resampleRow(j, out, velocity, !velocity && m_filter == eResampleBicubic);
+}
+
+void CFieldResampler::resampleRow(int j, float *out, bool velocity, bool positive)
+{
+	const int width = m_from + 2, taps = m_taps;
+	const float *source = m_source + (size_t)m_first[j]*width, *down = m_weights[j];
+	float *row = m_rows + (size_t)j*(m_from + RESAMPLE_TAPS);
+	int i = 0;
+
+	// Down, the source rows this one reads weighed across their whole width
+#ifdef RESAMPLE_SSE
+	for ( ; i + 4 <= width; i += 4)
+	{
+		__m128 sum = _mm_mul_ps(_mm_set1_ps(down[0]), _mm_loadu_ps(source + i));
+		for (int t = 1; t < taps; t++)
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(down[t]), _mm_loadu_ps(source + t*width + i)));
+		_mm_storeu_ps(row + i, sum);
+	}
+#endif
+	for ( ; i < width; i++)
+	{
+		float sum = down[0]*source[i];
+		for (int t = 1; t < taps; t++)
+			sum += down[t]*source[t*width + i];
+		row[i] = sum;
+	}
+
+	// Across, into the output's layout at its own N
+	int N = m_size;
+	i = 0;
+#ifdef RESAMPLE_SSE
+	// Each output's taps times its weights is one vector; four of them transposed and summed are four outputs
+	for ( ; i + 4 <= N + 2; i += 4)
+	{
+		__m128 p0 = _mm_mul_ps(_mm_loadu_ps(row + m_first[i]),		_mm_loadu_ps(m_weights[i]));
+		__m128 p1 = _mm_mul_ps(_mm_loadu_ps(row + m_first[i + 1]),	_mm_loadu_ps(m_weights[i + 1]));
+		__m128 p2 = _mm_mul_ps(_mm_loadu_ps(row + m_first[i + 2]),	_mm_loadu_ps(m_weights[i + 2]));
+		__m128 p3 = _mm_mul_ps(_mm_loadu_ps(row + m_first[i + 3]),	_mm_loadu_ps(m_weights[i + 3]));
+		_MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+		__m128 sum = _mm_add_ps(_mm_add_ps(p0, p1), _mm_add_ps(p2, p3));
+		if(positive)
+			sum = _mm_max_ps(sum, _mm_setzero_ps());
+		float values[4];
+		_mm_storeu_ps(values, sum);
+		for (int k = 0; k < 4; k++)
+			out[velocity ? VIX(i + k,j) : IX(i + k,j)] = values[k];
+	}
+#endif
+	for ( ; i <= N + 1; i++)
+	{
+		const float *tap = row + m_first[i], *across = m_weights[i];
+		float sum = (tap[0]*across[0] + tap[1]*across[1]) + (tap[2]*across[2] + tap[3]*across[3]);
+		if(positive && sum < 0.0f)
+			sum = 0.0f;
+		out[velocity ? VIX(i,j) : IX(i,j)] = sum;
+	}
+}
+
+const char *CFieldResampler::filterName(int filter)
+{
+	static const char *names[totalResampleFilterCount] = { "bilinear", "bicubic" };
+	return filter >= 0 && filter < totalResampleFilterCount ? names[filter] : "unknown";
+}
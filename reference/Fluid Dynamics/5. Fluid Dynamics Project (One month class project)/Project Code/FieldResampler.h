@@ -0,0 +1,77 @@
+#pragma once
+
+#include "Def.h"	    // definitions
+
+extern int N;
+
+enum eResampleFilter{eResampleBilinear = 0, eResampleBicubic, totalResampleFilterCount};
+
+#define RESAMPLE_TAPS	4	// Source cells a destination one reads along each axis at most, bicubic's
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Class:	"CFieldResampler"
+//
+// Purpose: The sim's density and velocity at another N, for a mesh coarser or finer than the grid (CWaterMesh takes
+//			any N). The cell centres are lined up, cell i of n at (i - 0.5)/n, and the boundary cells are resampled
+//			with the rest. Bilinear weighs the two cells either side, bicubic the four with Catmull-Rom weights,
+//			which pass through the cells' values and keep the surface's slopes continuous when upsampling. Taps past
+//			the grid's edge read the line through the edge cell and the next one in, and a coarser output's boundary
+//			cells, which lie past the grid's, extrapolate along it; either way a linear field comes through exactly,
+//			ring and all (resample_tool check tests it). At exactly half the resolution
+//			bilinear is the 2x2 box; further down both skip cells and alias, the mesh is a view and nothing more.
+//
+//			The filter is separable. Each field is copied out of the solver's layout into plain rows, then every
+//			output row is one pass down the source rows it reads (whole rows, four cells at a time in SSE) and one
+//			across, four outputs at a time: each output's taps are one load, multiplied by its weights, and four
+//			of those transposed and summed. The rows run in parallel. The taps and weights are worked out once per
+//			pair of sizes. The output is in the solver's own layout at getSize(), IX/VIX indexed with that N, which
+//			is what CWaterMesh::build reads. Bicubic's overshoot is clamped off the density, where it would read as
+//			dry water, and kept in the velocity.
+//
+// Usage:	allocate for the mesh's N, then resample from the sim's fields each frame before the mesh is built.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class CFieldResampler
+{
+
+private:
+
+	float	*m_dens;			// The results, as allocate_field and allocate_velocity lay them out at m_size
+	float	*m_u;
+	float	*m_v;
+	float	*m_source;			// One sim field as N+2 plain rows of N+2
+	float	*m_rows;			// Each output row's pass down the source, m_size+2 rows of N+2 and a little over
+	int		*m_first;			// Each output cell's first source cell along an axis, the same for rows and columns
+	float	(*m_weights)[RESAMPLE_TAPS];	// And its taps' weights, 0 past the filter's own
+	int		m_taps;
+	int		m_size;				// Output N
+	int		m_from;				// The sim's N the taps and m_source are for, 0 before the first resample
+	int		m_filter;
+
+	int  prepare(int from);
+	void resampleField(const float *field, float *out, bool velocity);
+	void resampleRow(int j, float *out, bool velocity, bool positive);
+	void freeSource(void);
+	void freeResampler(void);
+
+	CFieldResampler(const CFieldResampler&);
+	CFieldResampler&operator = (const CFieldResampler&);
+
+public:
+
+	CFieldResampler(void);
+	~CFieldResampler(void);
+
+	// The output arrays for size cells a side, 0 when out of memory
+	int allocate(int size, int filter);
+	// Density and velocity as CFluidSim holds them (IX/VIX at N) to getSize(), 0 when out of memory
+	int resample(const float *dens, const float *u, const float *v);
+
+	void setFilter(int filter)			{ if(filter != m_filter) { m_filter = filter; m_from = 0; } }
+	int  getFilter(void) const			{ return m_filter; }
+	int  getSize(void) const			{ return m_size; }
+	const float *getDensity(void) const	{ return m_dens; }
+	const float *getU(void) const		{ return m_u; }
+	const float *getV(void) const		{ return m_v; }
+
+	static const char *filterName(int filter);
+};
@@ -0,0 +1,307 @@
+#include "FlowLic.h"
+#include "Random.h"
+#include "Mesh.h"			// packColor
+#include "SoftRenderer.h"	// the image writer
+#include "Profiler.h"
+
+#include <stdlib.h>
+#include <math.h>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LIC_SSE
+#endif
+
+#define LIC_SAMPLES		(2*LIC_REACH + 1)	// The texel's own noise and each step's
+#define LIC_TINY		1e-12f				// Squared speeds below it have no direction
+#define LIC_QUADS		2					// Groups of four neighbouring texels stepped together
+
+// The velocity at texel x, y, bilinear between the centres of the cells around it. Cell i's centre is at texel
+// (i - 0.5)*scale - 0.5, toCell is 1/scale
+static inline void velocityAt(const float (*velocity)[2], int stride, float toCell, float x, float y, float &vx, float &vy)
+{
+	float cx = (x + 0.5f)*toCell + 0.5f, cy = (y + 0.5f)*toCell + 0.5f;
+	int i = (int)cx, j = (int)cy;
+	float fx = cx - i, fy = cy - j;
+	const float *a = velocity[i + stride*j], *b = a + 2*stride;
+	float x0 = a[0] + fy*(b[0] - a[0]), x1 = a[2] + fy*(b[2] - a[2]);
+	float y0 = a[1] + fy*(b[1] - a[1]), y1 = a[3] + fy*(b[3] - a[3]);
+	vx = x0 + fx*(x1 - x0);
+	vy = y0 + fx*(y1 - y0);
+}
+
+#ifdef LIC_SSE
+// The same for four texels. Each lane's two cell rows are two loads of u, v pairs, lerped in y and transposed
+static inline void velocityAt(const float (*velocity)[2], int stride, __m128 toCell, __m128 x, __m128 y, __m128 &vx, __m128 &vy)
+{
+	const __m128 half = _mm_set1_ps(0.5f);
+	__m128 cx = _mm_add_ps(_mm_mul_ps(_mm_add_ps(x, half), toCell), half);
+	__m128 cy = _mm_add_ps(_mm_mul_ps(_mm_add_ps(y, half), toCell), half);
+	__m128 ix = _mm_cvtepi32_ps(_mm_cvttps_epi32(cx)), iy = _mm_cvtepi32_ps(_mm_cvttps_epi32(cy));
+	__m128 fx = _mm_sub_ps(cx, ix), fy = _mm_sub_ps(cy, iy);
+
+	// The index is exact in a float up to 4094 cells a side
+	int at[4];
+	_mm_storeu_si128((__m128i *)at, _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(iy, _mm_set1_ps((float)stride)), ix)));
+	__m128 t[4] = { _mm_shuffle_ps(fy, fy, _MM_SHUFFLE(0, 0, 0, 0)), _mm_shuffle_ps(fy, fy, _MM_SHUFFLE(1, 1, 1, 1)),
+					_mm_shuffle_ps(fy, fy, _MM_SHUFFLE(2, 2, 2, 2)), _mm_shuffle_ps(fy, fy, _MM_SHUFFLE(3, 3, 3, 3)) };
+	__m128 rows[4];
+	for(int k = 0; k < 4; k++)
+	{
+		const float *a = velocity[at[k]];
+		__m128 low = _mm_loadu_ps(a), high = _mm_loadu_ps(a + 2*stride);	// u, v here and one cell on
+		rows[k] = _mm_add_ps(low, _mm_mul_ps(t[k], _mm_sub_ps(high, low)));
+	}
+	_MM_TRANSPOSE4_PS(rows[0], rows[1], rows[2], rows[3]);	// u0, v0, u1, v1 of the four lanes
+	vx = _mm_add_ps(rows[0], _mm_mul_ps(fx, _mm_sub_ps(rows[2], rows[0])));
+	vy = _mm_add_ps(rows[1], _mm_mul_ps(fx, _mm_sub_ps(rows[3], rows[1])));
+}
+
+// A unit step along vx, vy times sign, none where the water is still. rsqrt's 12 bits are plenty for a texel's step
+static inline void unit(__m128 vx, __m128 vy, __m128 sign, __m128 &dx, __m128 &dy)
+{
+	__m128 speed2 = _mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy));
+	__m128 r = _mm_and_ps(_mm_mul_ps(_mm_rsqrt_ps(speed2), sign), _mm_cmpgt_ps(speed2, _mm_set1_ps(LIC_TINY)));
+	dx = _mm_mul_ps(vx, r);
+	dy = _mm_mul_ps(vy, r);
+}
+
+// The noise at the texel nearest each lane's x, y
+static inline __m128 noiseAt(const float *noise, int side, __m128 x, __m128 y)
+{
+	const __m128 half = _mm_set1_ps(0.5f);
+	__m128 nx = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_add_ps(x, half)));
+	__m128 ny = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_add_ps(y, half)));
+	int at[4];
+	_mm_storeu_si128((__m128i *)at, _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(ny, _mm_set1_ps((float)side)), nx)));
+	return _mm_setr_ps(noise[at[0]], noise[at[1]], noise[at[2]], noise[at[3]]);
+}
+#endif
+
+CFlowLic::CFlowLic(void)
+{
+	m_velocity	= NULL;
+	m_noise		= NULL;
+	m_image		= NULL;
+	m_colors	= NULL;
+	m_n = m_scale = m_side = m_colorN = 0;
+}
+
+CFlowLic::~CFlowLic(void)
+{
+	freeLic();
+}
+
+void CFlowLic::freeLic(void)
+{
+	free ( m_velocity );
+	free ( m_noise );
+	free ( m_image );
+	free ( m_colors );
+	m_velocity	= NULL;
+	m_noise		= NULL;
+	m_image		= NULL;
+	m_colors	= NULL;
+	m_n = m_scale = m_side = m_colorN = 0;
+}
+
+int CFlowLic::allocate(int n)
+{
+	freeLic();
+
+	int scale = (LIC_MIN_SIDE + n - 1)/n;
+	int side = n*scale;
+	size_t texels = (size_t)side*side, cells = (size_t)(n + 2)*(n + 2);
+	m_velocity	= (float (*)[2]) malloc ( cells*sizeof(*m_velocity) );
+	m_noise		= (float *) malloc ( texels*sizeof(*m_noise) );
+	m_image		= (float *) malloc ( texels*sizeof(*m_image) );
+	if ( !m_velocity || !m_noise || !m_image ) {
+		freeLic();
+		return ( 0 );
+	}
+
+	CRandom random;
+	random.seed(LIC_SEED);
+	unsigned int draws[RANDOM_BATCH];
+	for (size_t t = 0; t < texels; t += RANDOM_BATCH)
+	{
+		int count = texels - t < RANDOM_BATCH ? (int)(texels - t) : RANDOM_BATCH;
+		random.fill((long long)t, draws, count);
+		for (int k = 0; k < count; k++)
+			m_noise[t + k] = CRandom::uniform(draws[k]);
+	}
+
+	m_n		= n;
+	m_scale	= scale;
+	m_side	= side;
+	return ( 1 );
+}
+
+void CFlowLic::convolveRow(int y)
+{
+	const int side = m_side, stride = m_n + 2;
+	const float toCell = 1.0f/m_scale, last = (float)(side - 1);
+	const float toFade = m_n/LIC_STILL, spread = LIC_GAIN/LIC_SAMPLES;
+	const float *noise = m_noise;
+	float *out = m_image + (size_t)y*side;
+	int x = 0;
+
+#ifdef LIC_SSE
+	const __m128 toCell4 = _mm_set1_ps(toCell), last4 = _mm_set1_ps(last), zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+	const __m128 y4 = _mm_set1_ps((float)y), back = _mm_set1_ps(-1.0f);
+	for (; x + 4*LIC_QUADS <= side; x += 4*LIC_QUADS)
+	{
+		__m128 fade[LIC_QUADS], sum[LIC_QUADS], vx, vy;
+		__m128 fx[LIC_QUADS], fy[LIC_QUADS], fdx[LIC_QUADS], fdy[LIC_QUADS];	// Forward
+		__m128 bx[LIC_QUADS], by[LIC_QUADS], bdx[LIC_QUADS], bdy[LIC_QUADS];	// Back
+		int q;
+		for (q = 0; q < LIC_QUADS; q++)
+		{
+			fx[q] = bx[q] = _mm_add_ps(_mm_set1_ps((float)(x + 4*q)), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+			fy[q] = by[q] = y4;
+			velocityAt(m_velocity, stride, toCell4, fx[q], fy[q], vx, vy);
+			unit(vx, vy, one, fdx[q], fdy[q]);
+			bdx[q] = _mm_sub_ps(zero, fdx[q]);
+			bdy[q] = _mm_sub_ps(zero, fdy[q]);
+			__m128 speed = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)));
+			fade[q] = _mm_mul_ps(_mm_min_ps(_mm_mul_ps(speed, _mm_set1_ps(toFade)), one), _mm_set1_ps(spread));
+			sum[q] = noiseAt(noise, side, fx[q], fy[q]);
+		}
+
+		// Every streamline forward and back in step. Each step's fetches depend on the last one's, so it is the
+		// independent chains side by side that keep the core busy
+		for (int s = 1; s <= LIC_REACH; s++)
+		{
+			for (q = 0; q < LIC_QUADS; q++)
+			{
+				fx[q] = _mm_min_ps(_mm_max_ps(_mm_add_ps(fx[q], fdx[q]), zero), last4);
+				fy[q] = _mm_min_ps(_mm_max_ps(_mm_add_ps(fy[q], fdy[q]), zero), last4);
+				bx[q] = _mm_min_ps(_mm_max_ps(_mm_add_ps(bx[q], bdx[q]), zero), last4);
+				by[q] = _mm_min_ps(_mm_max_ps(_mm_add_ps(by[q], bdy[q]), zero), last4);
+				sum[q] = _mm_add_ps(sum[q], _mm_add_ps(noiseAt(noise, side, fx[q], fy[q]), noiseAt(noise, side, bx[q], by[q])));
+			}
+			if(s % LIC_STRIDE || s == LIC_REACH)
+				continue;
+			for (q = 0; q < LIC_QUADS; q++)
+			{
+				velocityAt(m_velocity, stride, toCell4, fx[q], fy[q], vx, vy);
+				unit(vx, vy, one, fdx[q], fdy[q]);
+				velocityAt(m_velocity, stride, toCell4, bx[q], by[q], vx, vy);
+				unit(vx, vy, back, bdx[q], bdy[q]);
+			}
+		}
+
+		// Mid grey plus the mean's difference from it, scaled up
+		for (q = 0; q < LIC_QUADS; q++)
+		{
+			__m128 value = _mm_mul_ps(_mm_sub_ps(sum[q], _mm_set1_ps(0.5f*LIC_SAMPLES)), fade[q]);
+			value = _mm_add_ps(value, _mm_set1_ps(0.5f));
+			_mm_storeu_ps(out + x + 4*q, _mm_min_ps(_mm_max_ps(value, zero), one));
+		}
+	}
+#endif
+
+	for (; x < side; x++)
+	{
+		float vx, vy;
+		velocityAt(m_velocity, stride, toCell, (float)x, (float)y, vx, vy);
+		float speed = sqrtf(vx*vx + vy*vy);
+		float r = speed*speed > LIC_TINY ? 1.0f/speed : 0.0f;
+		float dx0 = vx*r, dy0 = vy*r;
+		float fade = (speed*toFade < 1.0f ? speed*toFade : 1.0f)*spread;
+
+		float sum = noise[(size_t)y*side + x];
+		for (int way = 0; way < 2; way++)
+		{
+			float px = (float)x, py = (float)y;
+			float dx = way ? -dx0 : dx0, dy = way ? -dy0 : dy0;
+			for (int s = 1; s <= LIC_REACH; s++)
+			{
+				px += dx;	px = px < 0.0f ? 0.0f : (px > last ? last : px);
+				py += dy;	py = py < 0.0f ? 0.0f : (py > last ? last : py);
+				sum += noise[(size_t)(int)(py + 0.5f)*side + (int)(px + 0.5f)];
+				if(s % LIC_STRIDE || s == LIC_REACH)
+					continue;
+
+				velocityAt(m_velocity, stride, toCell, px, py, vx, vy);
+				float speed2 = vx*vx + vy*vy;
+				r = speed2 > LIC_TINY ? (way ? -1.0f : 1.0f)/sqrtf(speed2) : 0.0f;
+				dx = vx*r;
+				dy = vy*r;
+			}
+		}
+
+		float value = (sum - 0.5f*LIC_SAMPLES)*fade + 0.5f;
+		out[x] = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+	}
+}
+
+int CFlowLic::compute(const float *u, const float *v, int meshN)
+{
+	PROFILE_ZONE("flow lic");
+	if(m_n != N && !allocate(N))
+		return ( 0 );
+	if(m_colorN != meshN)
+	{
+		// The old colours stay until the new ones are there
+		unsigned int *colors = (unsigned int *) malloc ( (size_t)(meshN + 2)*(meshN + 2)*sizeof(*colors) );
+		if ( !colors )
+			return ( 0 );
+		free ( m_colors );
+		m_colors = colors;
+		m_colorN = meshN;
+	}
+
+	int i, j, y;
+
+	// The velocity out of whatever layout the fields are in, u and v side by side for the bilinear fetches
+	#pragma omp parallel for private(i)
+	for (j = 0; j <= N + 1; j++)
+	{
+		for (i = 0; i <= N + 1; i++)
+		{
+			m_velocity[MX(i,j)][0] = u[VIX(i,j)];
+			m_velocity[MX(i,j)][1] = v[VIX(i,j)];
+		}
+	}
+
+	#pragma omp parallel for
+	for (y = 0; y < m_side; y++)
+		convolveRow(y);
+
+	// Each vertex takes the texel at its cell's centre, the boundary ones their edge cell's. The mesh's cells
+	// line up with the sim's as CFieldResampler's do, so at the sim's N that is the middle of the cell's square
+	const int meshSide = meshN, toTexel = m_side;
+	#pragma omp parallel for private(i)
+	for (j = 0; j <= meshSide + 1; j++)
+	{
+		int N = meshSide;
+		int ty = (int)(((j < 1 ? 1 : (j > N ? N : j)) - 0.5f)*toTexel/N);
+		for (i = 0; i <= N + 1; i++)
+		{
+			int tx = (int)(((i < 1 ? 1 : (i > N ? N : i)) - 0.5f)*toTexel/N);
+			float grey = m_image[(size_t)ty*toTexel + tx];
+			tColor color = { grey, grey, grey };
+			m_colors[MX(i,j)] = CWaterMesh::packColor(color);
+		}
+	}
+	return ( 1 );
+}
+
+int CFlowLic::save(const char *path) const
+{
+	if(!m_image)
+		return ( 0 );
+	size_t texels = (size_t)m_side*m_side;
+	unsigned int *pixels = (unsigned int *) malloc ( texels*sizeof(*pixels) );
+	if(!pixels)
+		return ( 0 );
+	for (size_t t = 0; t < texels; t++)
+	{
+		tColor color = { m_image[t], m_image[t], m_image[t] };
+		pixels[t] = CWaterMesh::packColor(color);
+	}
+	// Row 0 is the y = 0 edge, the image's top
+	int ok = CSoftRenderer::save(path, pixels, m_side, m_side);
+	free ( pixels );
+	return ( ok );
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Def.h"	    // definitions
+
+extern int N;
+
+#define LIC_MIN_SIDE	256		// Texels a side at least, below it each cell is an integer square of texels
+#define LIC_REACH		12		// Unit steps, a texel long, the kernel takes each way along the streamline
+#define LIC_STRIDE		2		// Steps taken along each velocity fetch, which is most of a step's time
+#define LIC_GAIN		3.0f	// Contrast around mid grey, the kernel's mean of uniform noise spreads 0.29/sqrt(25)
+#define LIC_STILL		0.1f	// Speeds under this many cells a unit of time fade the streaks to flat grey
+#define LIC_SEED		0x11c	// The noise is the same every run
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Class:	"CFlowLic"
+//
+// Purpose: The flow debug view, a line integral convolution of the velocity: white noise averaged along each texel's
+//			streamline, LIC_REACH steps forward and back, so the noise smears into streaks that follow the flow at any
+//			N. The image is N texels a side, more when N is under LIC_MIN_SIDE. The streamlines are Euler steps a texel
+//			long, along the velocity sampled bilinearly and normalized every LIC_STRIDE steps; the noise is read at
+//			the nearest texel after each one. compute() runs the texel rows in parallel and steps four neighbouring
+//			streamlines at a time in the SSE lanes, with the velocity and noise fetched lane by lane. Each step's
+//			fetch waits on the last one's, so a row's streamlines go forward and back together, eight texels at a
+//			time, for independent fetches to overlap. Still water, under LIC_STILL, fades to grey rather than showing
+//			the raw noise. The noise comes from CRandom with a fixed seed, so the image is a function of the velocity
+//			alone. No GL in here.
+//
+// Usage:	compute from the solver's velocity each frame the view is on. getImage() is the image, save() writes it
+//			out, and getVertexColors() is a grey per mesh vertex (MX indexed at the mesh's N, which may not be the
+//			sim's) for CWaterMesh::setColorSource.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class CFlowLic
+{
+
+private:
+
+	float	(*m_velocity)[2];	// u and v of each cell, MX indexed whatever the fields' layout
+	float	*m_noise;			// Uniform [0, 1), m_side rows of m_side
+	float	*m_image;			// The convolution, 0 to 1, as m_noise
+	unsigned int *m_colors;		// Grey RGBA8 per mesh vertex
+	int		m_n;				// The N the arrays are for
+	int		m_colorN;			// And the mesh's N m_colors is for
+	int		m_scale;			// Texels a cell side
+	int		m_side;				// N*m_scale
+
+	int  allocate(int n);
+	void freeLic(void);
+	void convolveRow(int y);
+
+	CFlowLic(const CFlowLic&);
+	CFlowLic&operator = (const CFlowLic&);
+
+public:
+
+	CFlowLic(void);
+	~CFlowLic(void);
+
+	// The image for velocity u, v (VIX indexed) and the vertex colours for a mesh meshN a side, 0 when out of memory.
+	// The colours from before may be freed then, so a mesh drawing them must let go of them
+	int compute(const float *u, const float *v, int meshN);
+	// The image as grey, PNG when the path ends in .png and PPM otherwise, 0 when it could not be written
+	int save(const char *path) const;
+
+	const float *getImage(void) const			{ return m_image; }
+	int getSide(void) const						{ return m_side; }
+	const unsigned int *getVertexColors(void) const	{ return m_colors; }
+};
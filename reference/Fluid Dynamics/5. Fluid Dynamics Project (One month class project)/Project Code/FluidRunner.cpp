@@ -0,0 +1,272 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	"FluidRunner.cpp"
+//
+// Purpose: Headless runner for CFluidSim, for machines with no window to open. Arguments are read the way the
+//			article's demo.c reads them, with the step count and a scenario on the end. Prints the final mass and
+//			the throughput of the solver (and of the forcing, when any is switched on) in cells/second.
+//
+// Usage:	fluid_runner [N dt diff visc force source steps [scenario...]]
+//
+//			stir		density and a rotating push at the centre every step, like holding both mouse buttons
+//			splash		injectDensity and injectVelocity every 10 steps, like the 'd' and 'v' keys
+//			rain		weather rain
+//			wind		weather wind
+//			waves		weather waves
+//			ship		decay and ship physics (implied by rain, wind and waves)
+//			seed=n		seeds the sim's random sequence, default 1 so runs repeat
+//			trace=path	write the profiler zones as a Chrome trace (needs a PROFILE=1 build)
+//			stats		print the step time percentiles per stage and the steps over budget
+//			budget=ms	the budget for stats, default 16.7
+//			serve[=port]	live stats over HTTP on 127.0.0.1 (default 7007) and in shared memory, see StatsServer.h
+//			load=path	start from a checkpoint: its N, parameters, weather and ship replace the arguments and the
+//						forcing runs. Tokens after it still apply (rain, wind and waves toggle what it saved) and its
+//						seed is kept unless seed=n is given
+//			save=path	write a checkpoint after the last step
+//			record=path	record the density and velocity after every step, see FieldRecorder.h
+//			every=k		record every k steps instead
+//			lossy=b		drop b low mantissa bits from the recording, 0 (lossless) to 23
+//			log=path	log the sources, keys and dt of every step for input_replay, see InputLog.h
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "Simulation.h"
+#include "Timer.h"
+#include "Profiler.h"
+#include "FrameStats.h"
+#include "StatsServer.h"
+#include "Checkpoint.h"
+#include "FieldRecorder.h"
+#include "InputLog.h"
+
+static void usage ( const char *name )
+{
+	fprintf ( stderr, "usage : %s N dt diff visc force source steps [scenario...]\n", name );
+	fprintf ( stderr, "where:\n" );
+	fprintf ( stderr, "\t N      : grid resolution\n" );
+	fprintf ( stderr, "\t dt     : time step\n" );
+	fprintf ( stderr, "\t diff   : diffusion rate of the density\n" );
+	fprintf ( stderr, "\t visc   : viscosity of the fluid\n" );
+	fprintf ( stderr, "\t force  : scales the stirring and splash velocity\n" );
+	fprintf ( stderr, "\t source : amount of density added by stir and splash\n" );
+	fprintf ( stderr, "\t steps  : number of steps to run\n" );
+	fprintf ( stderr, "\t scenario : any of stir splash rain wind waves ship seed=n trace=path stats budget=ms serve[=port]\n" );
+	fprintf ( stderr, "\t            load=path save=path record=path every=k lossy=b log=path\n" );
+}
+
+int main ( int argc, char ** argv )
+{
+	int n, steps;
+	float dt, diff, visc, force, source;
+
+	if ( argc != 1 && argc < 8 ) {
+		usage ( argv[0] );
+		return 1;
+	}
+
+	if ( argc == 1 ) {
+		n = 64;
+		dt = 0.1f;
+		diff = 0.0f;
+		visc = 0.0f;
+		force = 5.0f;
+		source = 100.0f;
+		steps = 1000;
+		fprintf ( stderr, "Using defaults : N=%d dt=%g diff=%g visc=%g force=%g source=%g steps=%d stir\n",
+			n, dt, diff, visc, force, source, steps );
+	} else {
+		n = atoi(argv[1]);
+		dt = (float)atof(argv[2]);
+		diff = (float)atof(argv[3]);
+		visc = (float)atof(argv[4]);
+		force = (float)atof(argv[5]);
+		source = (float)atof(argv[6]);
+		steps = atoi(argv[7]);
+	}
+
+	if ( n < 8 || steps < 1 ) {
+		fprintf ( stderr, "N must be at least 8 and steps at least 1\n" );
+		return 1;
+	}
+
+	CFluidSim sim;
+	if ( !sim.allocateFluid ( n ) ) {
+		fprintf ( stderr, "cannot allocate data\n" );
+		return 1;
+	}
+	sim.clearFluid ();
+	sim.setParams ( diff, visc, force, source );
+
+	// Scenario
+	bool stir = argc == 1, splash = false, forcing = false, stats = false;
+	CFrameStats frameStats;
+	tFrameTimes frameTimes;
+	CStatsServer server;
+	int port = 0;
+	unsigned int seed = 1;
+	bool seeded = false, loaded = false;
+	const char *tracePath = NULL, *savePath = NULL, *recordPath = NULL, *logPath = NULL;
+	int recordEvery = 1, recordBits = 0;
+	for ( int a = 8 ; a < argc ; a++ ) {
+		if ( !strcmp ( argv[a], "stir" ) )			stir = true;
+		else if ( !strcmp ( argv[a], "splash" ) )	splash = true;
+		else if ( !strcmp ( argv[a], "rain" ) )		{ sim.rainToggle(); forcing = true; }
+		else if ( !strcmp ( argv[a], "wind" ) )		{ sim.windToggle(); forcing = true; }
+		else if ( !strcmp ( argv[a], "waves" ) )	{ sim.wavesToggle(); forcing = true; }
+		else if ( !strcmp ( argv[a], "ship" ) )		forcing = true;
+		else if ( !strncmp ( argv[a], "seed=", 5 ) )	{ seed = (unsigned int)atoi(argv[a]+5); seeded = true; }
+		else if ( !strncmp ( argv[a], "trace=", 6 ) )	tracePath = argv[a]+6;
+		else if ( !strcmp ( argv[a], "stats" ) )		stats = true;
+		else if ( !strncmp ( argv[a], "budget=", 7 ) )	frameStats.setBudget ( 1e-3*atof(argv[a]+7) );
+		else if ( !strcmp ( argv[a], "serve" ) )		port = STATS_PORT;
+		else if ( !strncmp ( argv[a], "serve=", 6 ) )	port = atoi(argv[a]+6);
+		else if ( !strncmp ( argv[a], "save=", 5 ) )	savePath = argv[a]+5;
+		else if ( !strncmp ( argv[a], "record=", 7 ) )	recordPath = argv[a]+7;
+		else if ( !strncmp ( argv[a], "every=", 6 ) )	recordEvery = atoi(argv[a]+6);
+		else if ( !strncmp ( argv[a], "lossy=", 6 ) )	recordBits = atoi(argv[a]+6);
+		else if ( !strncmp ( argv[a], "log=", 4 ) )		logPath = argv[a]+4;
+		else if ( !strncmp ( argv[a], "load=", 5 ) ) {
+			const char *error = NULL;
+			if ( !CCheckpoint::restore ( argv[a]+5, sim, &error ) ) {
+				fprintf ( stderr, "cannot load %s: %s\n", argv[a]+5, error );
+				return 1;
+			}
+			n = N;
+			loaded = forcing = true;
+		}
+		else {
+			fprintf ( stderr, "unknown scenario '%s'\n", argv[a] );
+			usage ( argv[0] );
+			return 1;
+		}
+	}
+	if ( seeded || !loaded ) sim.seedRandom ( seed );
+	PROFILE_THREAD_NAME ( "main" );
+	frameTimes.clear ();
+	if ( port ) {
+		if ( server.open ( port, STATS_SHM_NAME ) < 2 )
+			fprintf ( stderr, "stats only partly open, is port %d in use?\n", port );
+		else
+			printf ( "serving stats on http://127.0.0.1:%d/ and shared memory %s\n", port, STATS_SHM_NAME );
+	}
+	CFieldRecorder recorder;
+	if ( recordPath && !recorder.open ( recordPath, recordEvery, recordBits ) ) {
+		fprintf ( stderr, "cannot record to %s\n", recordPath );
+		return 1;
+	}
+	CInputLog log;
+	if ( logPath ) {
+		const char *error = NULL;
+		if ( !log.open ( logPath, sim, &error ) ) {
+			fprintf ( stderr, "cannot log to %s: %s\n", logPath, error );
+			return 1;
+		}
+	}
+	bool timed = stats || port;
+	if ( timed ) sim.setFrameTimes ( &frameTimes );
+
+	double solveSeconds = 0.0, forcingSeconds = 0.0;
+	CTimer timer;
+	for ( int s=0 ; s<steps ; s++ ) {
+		{
+			CStageTimer stage ( timed ? &frameTimes : NULL, eStageSources );
+			sim.clearSources ();
+			log.clearSources ();
+			if ( stir ) {
+				float angle = 0.05f*sim.getSteps();
+				float u = force * cosf(angle), v = force * sinf(angle);
+				sim.addDensitySource ( n/2, n/2, source );
+				sim.addVelocitySource ( n/2, n/2, u, v );
+				log.density ( n/2, n/2, source );
+				log.velocity ( n/2, n/2, u, v );
+			}
+			if ( splash && s%10 == 0 ) {
+				log.action ( sim, eInputInjectDensity );
+				log.action ( sim, eInputInjectVelocity );
+			}
+		}
+
+		log.step ( dt );
+		timer.Reset ();
+		sim.step ( dt );
+		solveSeconds += timer.GetElapsedSeconds();
+
+		if ( forcing ) {
+			log.forcing ( dt );
+			timer.Reset ();
+			sim.applyForcing ( dt );
+			forcingSeconds += timer.GetElapsedSeconds();
+		}
+		log.frame ();
+
+		recorder.record ( sim );
+
+		if ( timed ) {
+			frameStats.record ( frameTimes );
+			if ( port ) server.publish ( sim, frameTimes, frameStats, dt, NULL );
+			frameTimes.clear ();
+		}
+	}
+
+	double mass = 0.0;
+	float *d = sim.getDensity();
+	for ( int i=1 ; i<=n ; i++ ) {
+		for ( int j=1 ; j<=n ; j++ ) {
+			mass += d[IX(i,j)];
+		}
+	}
+
+	double cells = (double)n*n*steps;
+	printf ( "N=%d steps=%d mass=%g\n", n, steps, mass );
+	if ( savePath ) {
+		const char *error = NULL;
+		if ( !CCheckpoint::save ( savePath, sim, &error ) ) {
+			fprintf ( stderr, "cannot save %s: %s\n", savePath, error );
+			return 1;
+		}
+		printf ( "checkpoint: %s after %.0f steps\n", savePath, (double)sim.getSteps() );
+	}
+	printf ( "solver:  %.3fs, %.4g cells/s\n", solveSeconds, cells/solveSeconds );
+	if ( forcing ) {
+		printf ( "forcing: %.3fs, %.4g cells/s\n", forcingSeconds, cells/forcingSeconds );
+		printf ( "total:   %.3fs, %.4g cells/s\n", solveSeconds+forcingSeconds, cells/(solveSeconds+forcingSeconds) );
+	}
+
+	if ( logPath ) {
+		if ( !log.close ( sim ) ) {
+			fprintf ( stderr, "cannot write %s\n", logPath );
+			return 1;
+		}
+		printf ( "log:     %s, %.0f events over %.0f steps, starts from %s%s\n", logPath, (double)log.getEvents(),
+			(double)log.getSteps(), logPath, INPUT_LOG_START );
+	}
+
+	if ( recordPath ) {
+		if ( !recorder.close () ) {
+			fprintf ( stderr, "cannot write %s\n", recordPath );
+			return 1;
+		}
+		printf ( "record:  %.0f frames, %.0f dropped, %.1f MB for %.1f MB of fields\n", (double)recorder.getFrames(),
+			(double)recorder.getDropped(), recorder.getPackedBytes()/1e6, recorder.getRawBytes()/1e6 );
+	}
+
+	if ( stats ) {
+		printf ( "\n" );
+		frameStats.report ( stdout );
+	}
+
+	if ( tracePath ) {
+#if PROFILER
+		if ( !PROFILE_EXPORT ( tracePath ) ) {
+			fprintf ( stderr, "cannot write %s\n", tracePath );
+			return 1;
+		}
+		printf ( "trace:   %s\n", tracePath );
+#else
+		fprintf ( stderr, "built without PROFILER, no trace written (make clean && make PROFILE=1)\n" );
+#endif
+	}
+	return 0;
+}
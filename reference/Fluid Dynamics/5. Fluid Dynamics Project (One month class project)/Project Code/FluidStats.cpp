@@ -0,0 +1,67 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	"FluidStats.cpp"
+//
+// Purpose: Prints the live stats a running demo or fluid_runner publishes in shared memory (see StatsServer.h), the
+//			same text its HTTP endpoint serves, without going through a socket.
+//
+// Usage:	fluid_stats [-w seconds] [name]
+//
+//			-w		print again every so many seconds until interrupted
+//			name	the shared memory block, default lumens_stats
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#include "StatsServer.h"
+
+int main(int argc, char *argv[])
+{
+	const char *name = STATS_SHM_NAME;
+	double every = 0.0;
+
+	for(int a = 1; a < argc; a++)
+	{
+		if(!strcmp(argv[a], "-w") && a+1 < argc)
+			every = atof(argv[++a]);
+		else if(argv[a][0] != '-')
+			name = argv[a];
+		else
+		{
+			fprintf ( stderr, "usage : %s [-w seconds] [name]\n", argv[0] );
+			return 1;
+		}
+	}
+
+	do
+	{
+		tStatsBlock block;
+		if(!statsRead(name, block))
+		{
+			fprintf ( stderr, "no stats published as %s\n", name );
+			return 1;
+		}
+
+		char text[STATS_TEXT_SIZE];
+		statsFormat(block, text, sizeof(text));
+		fputs ( text, stdout );
+		fflush ( stdout );
+
+		if(every > 0.0)
+		{
+			printf ( "\n" );
+#ifdef _WIN32
+			Sleep ( (DWORD)(every*1000) );
+#else
+			usleep ( (useconds_t)(every*1e6) );
+#endif
+		}
+	}
+	while(every > 0.0);
+	return 0;
+}
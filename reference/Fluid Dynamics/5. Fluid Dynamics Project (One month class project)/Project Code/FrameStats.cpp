@@ -0,0 +1,204 @@
+#include "FrameStats.h"
+
+#include <string.h>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// CHistogram
+
+int CHistogram::bucketOf(long long ns)
+{
+	if(ns < 0)
+		ns = 0;
+	if(ns > HISTOGRAM_MAX_VALUE)
+		ns = HISTOGRAM_MAX_VALUE;
+
+	// Values under HISTOGRAM_SUB have a bucket each, past that every doubling is split into HISTOGRAM_HALF
+	int shift = 0;
+	while((ns >> shift) >= HISTOGRAM_SUB)
+		shift++;
+	return shift*HISTOGRAM_HALF + (int)(ns >> shift);
+}
+
+long long CHistogram::bucketTop(int bucket)
+{
+	if(bucket < HISTOGRAM_SUB)
+		return bucket;
+
+	int shift = bucket/HISTOGRAM_HALF - 1;
+	long long sub = bucket - shift*HISTOGRAM_HALF;
+	return ((sub + 1) << shift) - 1;
+}
+
+void CHistogram::reset(void)
+{
+	memset ( m_buckets, 0, sizeof(m_buckets) );
+	m_count = 0;
+	m_min	= HISTOGRAM_MAX_VALUE;
+	m_max	= 0;
+	m_sum	= 0.0;
+}
+
+void CHistogram::record(double seconds)
+{
+	long long ns = (long long)(seconds*1e9 + 0.5);
+	m_buckets[bucketOf(ns)]++;
+	m_count++;
+	m_sum += seconds;
+	if(ns < m_min)
+		m_min = ns;
+	if(ns > m_max)
+		m_max = ns;
+}
+
+double CHistogram::percentile(double p) const
+{
+	if(!m_count)
+		return 0.0;
+
+	// The smallest value with at least p percent of the samples at or below it
+	long long rank = (long long)(p/100.0*m_count + 0.999999);
+	if(rank < 1)
+		rank = 1;
+
+	long long seen = 0;
+	for(int b = 0; b < HISTOGRAM_BUCKETS; b++)
+	{
+		seen += m_buckets[b];
+		if(seen >= rank)
+		{
+			long long top = bucketTop(b);
+			return (top < m_max ? top : m_max)*1e-9;
+		}
+	}
+	return m_max*1e-9;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// CFrameStats
+
+CFrameStats::CFrameStats(void)
+{
+	m_budget = FRAME_BUDGET;
+	reset();
+}
+
+void CFrameStats::reset(void)
+{
+	for(int s = 0; s < totalFrameStageCount; s++)
+	{
+		m_stages[s].reset();
+		m_blamed[s] = 0;
+	}
+	m_sim.reset();
+	m_render.reset();
+	m_frame.reset();
+	m_overBudget = 0;
+}
+
+void CFrameStats::record(const tFrameTimes &times)
+{
+	double sim = 0.0, render = 0.0;
+	for(int s = 0; s < totalFrameStageCount; s++)
+	{
+		m_stages[s].record(times.stage[s]);
+		if(s < FRAME_SIM_STAGES)
+			sim += times.stage[s];
+		else
+			render += times.stage[s];
+	}
+	m_sim.record(sim);
+	m_render.record(render);
+	m_frame.record(sim + render);
+
+	if(sim + render <= m_budget)
+		return;
+
+	// Blame the stage furthest over what it usually takes, not the one that is always the biggest. A frame with no
+	// real spike in it is slow all over, that one goes to its biggest stage
+	int culprit = 0, biggest = 0;
+	double excess = -1.0;
+	for(int s = 0; s < totalFrameStageCount; s++)
+	{
+		double over = times.stage[s] - m_stages[s].percentile(50.0);
+		if(over > excess)
+		{
+			excess	= over;
+			culprit	= s;
+		}
+		if(times.stage[s] > times.stage[biggest])
+			biggest = s;
+	}
+	if(excess < FRAME_SPIKE*(sim + render))
+	{
+		culprit	= biggest;
+		excess	= times.stage[biggest] - m_stages[biggest].percentile(50.0);
+	}
+	m_blamed[culprit]++;
+
+	tSlowFrame &slow = m_slow[m_overBudget % FRAME_SLOW_LOG];
+	slow.frame		= (long)m_frame.getCount();
+	slow.total		= sim + render;
+	slow.culprit	= culprit;
+	slow.excess		= excess;
+	slow.times		= times;
+	m_overBudget++;
+}
+
+static void printRow(FILE *file, const char *name, const CHistogram &histogram)
+{
+	fprintf ( file, "%-10s %9.3f %9.3f %9.3f %9.3f %9.3f", name, 1e3*histogram.percentile(50.0),
+		1e3*histogram.percentile(95.0), 1e3*histogram.percentile(99.0), 1e3*histogram.getMax(), 1e3*histogram.getMean() );
+}
+
+void CFrameStats::report(FILE *file) const
+{
+	long frames = (long)m_frame.getCount();
+	fprintf ( file, "%ld frames, budget %.2f ms, %ld over budget (%.1f%%)\n", frames, 1e3*m_budget, m_overBudget,
+		frames ? 100.0*m_overBudget/frames : 0.0 );
+	if(!frames)
+		return;
+
+	fprintf ( file, "%-10s %9s %9s %9s %9s %9s %9s  (ms)\n", "stage", "p50", "p95", "p99", "max", "mean", "blamed" );
+	for(int s = 0; s < totalFrameStageCount; s++)
+	{
+		printRow(file, stageName(s), m_stages[s]);
+		fprintf ( file, " %9ld\n", m_blamed[s] );
+	}
+	printRow(file, "sim step", m_sim);
+	fprintf ( file, "\n" );
+	printRow(file, "render", m_render);
+	fprintf ( file, "\n" );
+	printRow(file, "frame", m_frame);
+	fprintf ( file, "\n" );
+
+	if(!m_overBudget)
+		return;
+
+	long kept = m_overBudget < FRAME_SLOW_LOG ? m_overBudget : FRAME_SLOW_LOG;
+	fprintf ( file, "\nLast %ld over budget frames, culprit and how far over its median, then every stage (ms)\n", kept );
+	for(long k = m_overBudget - kept; k < m_overBudget; k++)
+	{
+		const tSlowFrame &slow = m_slow[k % FRAME_SLOW_LOG];
+		fprintf ( file, "frame %7ld %8.3f  %-8s %+8.3f  |", slow.frame, 1e3*slow.total, stageName(slow.culprit),
+			1e3*slow.excess );
+		for(int s = 0; s < totalFrameStageCount; s++)
+			fprintf ( file, " %s %.3f", stageName(s), 1e3*slow.times.stage[s] );
+		fprintf ( file, "\n" );
+	}
+}
+
+int CFrameStats::dump(const char *path) const
+{
+	FILE *file = fopen ( path, "w" );
+	if(!file)
+		return 0;
+	report(file);
+	return fclose ( file ) == 0;
+}
+
+const char *CFrameStats::stageName(int stage)
+{
+	static const char *names[totalFrameStageCount] = { "sources", "velocity", "density", "forcing", "rain", "wind", "waves",
+													   "mesh", "draw" };
+	return names[stage];
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <stdio.h>
+#include "Timer.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Class:	"CHistogram"
+//
+// Purpose: HDR-style histogram of durations. Buckets are linear inside each power of two, so any value is kept to within
+//			1/128 of itself from a nanosecond up to 2^40 ns (18 minutes) in a fixed 17KB, and recording is a few shifts.
+//			Min, max and mean are exact, percentiles are the top of their bucket.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define HISTOGRAM_SUB		256					// Linear buckets below the first doubling
+#define HISTOGRAM_HALF		(HISTOGRAM_SUB/2)	// Linear buckets in every doubling after that
+#define HISTOGRAM_MAX_SHIFT	32					// HISTOGRAM_MAX_VALUE >> 32 is under HISTOGRAM_SUB
+#define HISTOGRAM_BUCKETS	(HISTOGRAM_MAX_SHIFT*HISTOGRAM_HALF + HISTOGRAM_SUB)
+#define HISTOGRAM_MAX_VALUE	((1LL << 40) - 1)	// Longer durations are counted as this
+
+class CHistogram
+{
+
+private:
+
+	unsigned int	m_buckets[HISTOGRAM_BUCKETS];
+	long long		m_count;
+	long long		m_min;
+	long long		m_max;
+	double			m_sum;
+
+	static int		 bucketOf(long long ns);
+	static long long bucketTop(int bucket);
+
+public:
+
+	CHistogram(void) { reset(); }
+
+	void reset(void);
+	void record(double seconds);
+
+	long long getCount(void) const	{ return m_count; }
+	double getMin(void) const		{ return m_count ? m_min*1e-9 : 0.0; }
+	double getMax(void) const		{ return m_max*1e-9; }
+	double getMean(void) const		{ return m_count ? m_sum/m_count : 0.0; }
+	double percentile(double p) const;	// p in 0..100, seconds
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Class:	"CFrameStats"
+//
+// Purpose: Frame time histograms with tail latencies. Every frame records the time spent in each stage (tFrameTimes),
+//			which goes into a histogram per stage and into the sim step, render and frame totals. A frame over the
+//			budget is blamed on the stage that ran furthest over its own median, which is what finds the weather and
+//			decay spikes that an average over 100 frames hides; the last FRAME_SLOW_LOG of those are kept whole.
+//
+// Usage:	Point CFluidSim::setFrameTimes at a tFrameTimes and time the other stages with CStageTimer, then record()
+//			and clear() it once a frame. report() prints everything, dump() writes the report to a file.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Sources and the two solver steps are the sim step, the rest is render (the forcing runs from draw)
+enum eFrameStage{eStageSources = 0, eStageVelocity, eStageDensity, eStageForcing, eStageRain, eStageWind, eStageWaves,
+				 eStageMesh, eStageDraw, totalFrameStageCount};
+
+#define FRAME_SIM_STAGES	3	// eStageSources up to eStageDensity
+#define FRAME_SLOW_LOG		32	// Over budget frames kept with their breakdown
+#define FRAME_SPIKE			0.05	// A stage this fraction of the frame over its median is a spike
+#define FRAME_BUDGET		(1.0/60.0)
+
+// Seconds spent in each stage this frame, added to as they run
+struct tFrameTimes
+{
+	double stage[totalFrameStageCount];
+
+	void clear(void) { for(int s = 0; s < totalFrameStageCount; s++) stage[s] = 0.0; }
+};
+
+// Adds the time to the end of the enclosing block to one stage, when there are times to add to
+class CStageTimer
+{
+
+private:
+
+	double	*m_stage;
+	CTimer	m_timer;
+
+public:
+
+	CStageTimer(tFrameTimes *times, int stage) : m_stage(times ? &times->stage[stage] : 0) {}
+	~CStageTimer(void) { if(m_stage) *m_stage += m_timer.GetElapsedSeconds(); }
+};
+
+class CFrameStats
+{
+
+private:
+
+	struct tSlowFrame
+	{
+		long		frame;
+		double		total;
+		int			culprit;
+		double		excess;		// Over the culprit's median
+		tFrameTimes	times;
+	};
+
+	CHistogram	m_stages[totalFrameStageCount];
+	CHistogram	m_sim;
+	CHistogram	m_render;
+	CHistogram	m_frame;
+
+	double		m_budget;
+	long		m_overBudget;
+	long		m_blamed[totalFrameStageCount];
+
+	tSlowFrame	m_slow[FRAME_SLOW_LOG];	// Ring, m_overBudget is the write position
+
+public:
+
+	CFrameStats(void);
+
+	void reset(void);
+	void setBudget(double seconds)	{ m_budget = seconds; }
+	double getBudget(void) const	{ return m_budget; }
+
+	void record(const tFrameTimes &times);
+
+	const CHistogram &getFrame(void) const		{ return m_frame; }
+	const CHistogram &getStage(int stage) const	{ return m_stages[stage]; }
+	long getOverBudget(void) const				{ return m_overBudget; }
+
+	void report(FILE *file) const;
+	int  dump(const char *path) const;
+
+	static const char *stageName(int stage);
+};
@@ -0,0 +1,311 @@
+#include "InputLog.h"
+#include "Simulation.h"
+#include "Checkpoint.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static void setError(const char **error, const char *reason)
+{
+	if(error)
+		*error = reason;
+}
+
+// path + INPUT_LOG_START, the caller frees it
+static char *startPath(const char *path)
+{
+	char *start = (char *)malloc ( strlen(path) + strlen(INPUT_LOG_START) + 1 );
+	if(start)
+	{
+		strcpy ( start, path );
+		strcat ( start, INPUT_LOG_START );
+	}
+	return start;
+}
+
+void applyInputAction(CFluidSim &sim, int action, float value)
+{
+	switch(action)
+	{
+	case eInputClear:			sim.clearFluid();						break;
+	case eInputThinOut:			sim.thinOut();							break;
+	case eInputInjectDensity:	sim.injectDensity();					break;
+	case eInputInjectVelocity:	sim.injectVelocity();					break;
+	case eInputRainToggle:		sim.rainToggle();						break;
+	case eInputRainIntensity:	sim.rainIntensityIncreace(value > 0.0f);	break;
+	case eInputRainSpread:		sim.rainSpreadIncreace(value > 0.0f);	break;
+	case eInputWindToggle:		sim.windToggle();						break;
+	case eInputWavesToggle:		sim.wavesToggle();						break;
+	case eInputHeading:			sim.changeHeading(value);				break;
+	case eInputEngage:			sim.engage(value);						break;
+	case eInputSails:			sim.toTheSails();						break;
+	case eInputResetShip:		sim.resetShip();						break;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// CInputLog
+
+CInputLog::CInputLog(void)
+{
+	m_file = 0;
+	memset ( &m_header, 0, sizeof(m_header) );
+}
+
+CInputLog::~CInputLog(void)
+{
+	// Without the sim there is no checksum to end on, the log still replays
+	if(m_file)
+	{
+		fclose ( m_file );
+		m_file = 0;
+	}
+}
+
+int CInputLog::open(const char *path, CFluidSim &sim, const char **error)
+{
+	if(m_file)
+		close(sim);
+
+	char *start = startPath(path);
+	if(!start)
+	{
+		setError(error, "out of memory");
+		return 0;
+	}
+	int saved = CCheckpoint::save(start, sim, error);
+	free ( start );
+	if(!saved)
+		return 0;
+
+	m_file = fopen ( path, "wb" );
+	if(!m_file)
+	{
+		setError(error, "cannot open the log");
+		return 0;
+	}
+
+	memset ( &m_header, 0, sizeof(m_header) );
+	memcpy ( m_header.magic, INPUT_LOG_MAGIC, sizeof(m_header.magic) );
+	m_header.version		= INPUT_LOG_VERSION;
+	m_header.headerBytes	= sizeof(tInputLogHeader);
+	m_header.N				= N;
+	m_header.seed			= sim.getSeed();
+	m_header.startStep		= sim.getSteps();
+	if(fwrite ( &m_header, sizeof(m_header), 1, m_file ) != 1)
+	{
+		fclose ( m_file );
+		m_file = 0;
+		remove ( path );
+		setError(error, "cannot write the log");
+		return 0;
+	}
+	return 1;
+}
+
+int CInputLog::close(CFluidSim &sim)
+{
+	if(!m_file)
+		return 1;
+
+	m_header.checksum = checksum(sim);
+	int ok = !ferror(m_file);
+	ok = ok && fseek ( m_file, 0, SEEK_SET ) == 0;
+	ok = ok && fwrite ( &m_header, sizeof(m_header), 1, m_file ) == 1;
+	ok = fclose ( m_file ) == 0 && ok;
+	m_file = 0;
+	return ok;
+}
+
+void CInputLog::write(int type, int i, int j, float x, float y)
+{
+	if(!m_file)
+		return;
+
+	tInputEvent event;
+	event.type	= type;
+	event.i		= i;
+	event.j		= j;
+	event.x		= x;
+	event.y		= y;
+	fwrite ( &event, sizeof(event), 1, m_file );	// Buffered, ferror catches a failure at close
+
+	m_header.events++;
+	if(type == eInputStep)
+		m_header.steps++;
+	else if(type == eInputFrame)
+		m_header.frames++;
+}
+
+void CInputLog::action(CFluidSim &sim, int action, float value)
+{
+	write(eInputAction, action, 0, value, 0.0f);
+	applyInputAction(sim, action, value);
+}
+
+unsigned long long CInputLog::checksum(CFluidSim &sim)
+{
+	// FNV-1a, 64 bit, one value at a time in the article's (N+2)*(N+2) order
+	unsigned long long hash = 14695981039346656037ULL;
+	const float *fields[3] = { sim.getDensity(), sim.getU(), sim.getV() };
+	int i, j;
+	for(int f = 0; f < 3; f++)
+	{
+		for ( j=0 ; j<=N+1 ; j++ ) {
+			for ( i=0 ; i<=N+1 ; i++ ) {
+				float value = f == 0 ? fields[f][IX(i,j)] : fields[f][VIX(i,j)];
+				const unsigned char *p = (const unsigned char *)&value;
+				for(int b = 0; b < (int)sizeof(float); b++)
+				{
+					hash ^= p[b];
+					hash *= 1099511628211ULL;
+				}
+			}
+		}
+	}
+	return hash;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// CInputReplay
+
+CInputReplay::CInputReplay(void)
+{
+	memset ( &m_header, 0, sizeof(m_header) );
+	m_events = 0;
+	m_start = 0;
+	m_closed = false;
+}
+
+CInputReplay::~CInputReplay(void)
+{
+	close();
+}
+
+void CInputReplay::close(void)
+{
+	free ( m_events );
+	free ( m_start );
+	memset ( &m_header, 0, sizeof(m_header) );
+	m_events = 0;
+	m_start = 0;
+	m_closed = false;
+}
+
+int CInputReplay::open(const char *path, const char **error)
+{
+	close();
+
+	FILE *file = fopen ( path, "rb" );
+	if(!file)
+	{
+		setError(error, "cannot open the file");
+		return 0;
+	}
+	if(fread ( &m_header, sizeof(m_header), 1, file ) != 1 || memcmp(m_header.magic, INPUT_LOG_MAGIC, sizeof(m_header.magic)))
+	{
+		fclose ( file );
+		setError(error, "not an input log");
+		return 0;
+	}
+	if(m_header.version != INPUT_LOG_VERSION || m_header.headerBytes != sizeof(tInputLogHeader))
+	{
+		fclose ( file );
+		setError(error, "written by a different version");
+		return 0;
+	}
+
+	// A log that was never closed holds the events up to where it stopped, read whatever is there
+	m_closed = m_header.events != 0;
+	long long capacity = m_closed ? m_header.events : 4096, count = 0;
+	m_events = (tInputEvent *)malloc ( (size_t)capacity*sizeof(tInputEvent) );
+	while(m_events)
+	{
+		count += fread ( m_events + count, sizeof(tInputEvent), (size_t)(capacity - count), file );
+		if(count < capacity || m_closed)
+			break;
+		tInputEvent *grown = (tInputEvent *)realloc ( m_events, (size_t)(2*capacity)*sizeof(tInputEvent) );
+		if(!grown)
+		{
+			free ( m_events );
+			m_events = 0;
+			break;
+		}
+		m_events = grown;
+		capacity *= 2;
+	}
+	fclose ( file );
+
+	m_start = startPath(path);
+	if(!m_events || !m_start)
+	{
+		close();
+		setError(error, "out of memory");
+		return 0;
+	}
+	if(m_closed && count != m_header.events)
+	{
+		close();
+		setError(error, "the log is shorter than its header says");
+		return 0;
+	}
+
+	// Recount, the header's counts are only written at close
+	m_header.events = count;
+	m_header.steps = m_header.frames = 0;
+	for(long long e = 0; e < count; e++)
+	{
+		if(m_events[e].type == eInputStep)
+			m_header.steps++;
+		else if(m_events[e].type == eInputFrame)
+			m_header.frames++;
+	}
+	return 1;
+}
+
+int CInputReplay::start(CFluidSim &sim, const char **error) const
+{
+	if(!m_start)
+	{
+		setError(error, "no log open");
+		return 0;
+	}
+	if(!CCheckpoint::restore(m_start, sim, error))
+		return 0;
+	if(N != m_header.N || sim.getSteps() != m_header.startStep)
+	{
+		setError(error, "the starting checkpoint is not the one the log was written from");
+		return 0;
+	}
+	return 1;
+}
+
+void CInputReplay::apply(CFluidSim &sim, const tInputEvent &event)
+{
+	// Sources outside the grid (a damaged log) would write outside the fields
+	if((event.type == eInputDensity || event.type == eInputVelocity) &&
+		(event.i < 0 || event.i > N+1 || event.j < 0 || event.j > N+1))
+		return;
+
+	switch(event.type)
+	{
+	case eInputClearSources:
+		sim.clearSources();
+		break;
+	case eInputDensity:
+		sim.addDensitySource(event.i, event.j, event.x);
+		break;
+	case eInputVelocity:
+		sim.addVelocitySource(event.i, event.j, event.x, event.y);
+		break;
+	case eInputStep:
+		sim.step(event.x);
+		break;
+	case eInputForcing:
+		sim.applyForcing(event.x);
+		break;
+	case eInputAction:
+		applyInputAction(sim, event.i, event.x);
+		break;
+	}
+}
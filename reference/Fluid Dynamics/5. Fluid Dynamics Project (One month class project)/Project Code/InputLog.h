@@ -0,0 +1,138 @@
+#pragma once
+
+#include <stdio.h>
+#include "Def.h"
+
+class CFluidSim;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Class:	"CInputLog"
+//
+// Purpose: Writes down everything that drives a session, in the order it happened: the sources the mouse wrote, the
+//			keys that reach the sim, and the dt of every step and forcing pass. open() saves a checkpoint beside the
+//			log (path + ".lck"), which holds the state and where the sim's random sequence had got to. With both, a
+//			session replays bit for bit with no window and no clock, as fast as the machine goes.
+//			close() stores a checksum of the fields it ended on, which the replay has to reach.
+//
+// Usage:	open(path, sim), then call clearSources, density, velocity, action, step, forcing and frame next to
+//			what they describe (action applies the key as well, through applyInputAction). Every call is a no-op
+//			while closed. CInputReplay reads a log back, input_replay times and checks them.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define INPUT_LOG_MAGIC		"LUMENLOG"
+#define INPUT_LOG_VERSION	1
+#define INPUT_LOG_START		".lck"	// Appended to the log's path for its starting checkpoint
+
+enum eInputEvent{eInputClearSources = 0, eInputDensity, eInputVelocity, eInputStep, eInputForcing, eInputFrame,
+				 eInputAction, totalInputEventCount};
+
+// The keys that change the sim, render-only keys (colours, wireframe, camera) are not logged
+enum eInputAction{eInputClear = 0, eInputThinOut, eInputInjectDensity, eInputInjectVelocity, eInputRainToggle,
+				  eInputRainIntensity, eInputRainSpread, eInputWindToggle, eInputWavesToggle, eInputHeading, eInputEngage,
+				  eInputSails, eInputResetShip, totalInputActionCount};
+
+// Fixed size types only, the same file reads on any compiler
+struct tInputLogHeader
+{
+	char		magic[8];		// INPUT_LOG_MAGIC, no terminator
+	unsigned int version;
+	unsigned int headerBytes;
+	int			N;
+	unsigned int seed;			// The sim's, the checkpoint has it and the counter
+	long long	startStep;		// CFluidSim::getSteps at open
+	long long	events;			// 0 until close(), the reader counts them from the file size
+	long long	steps;
+	long long	frames;
+	unsigned long long checksum;	// Of the density and velocity at close, row order, 0 until then
+};
+
+struct tInputEvent
+{
+	int		type;		// eInputEvent
+	int		i, j;		// Cell for density and velocity, the eInputAction for an action
+	float	x, y;		// dt, the density, the velocity's (u, v) or the action's argument
+};
+
+// Does one action to the sim, the demo's keys and the replay both come through here
+void applyInputAction(CFluidSim &sim, int action, float value);
+
+class CInputLog
+{
+
+private:
+
+	FILE			*m_file;
+	tInputLogHeader	m_header;
+
+	void write(int type, int i, int j, float x, float y);
+
+	CInputLog(const CInputLog&);
+	CInputLog&operator = (const CInputLog&);
+
+public:
+
+	CInputLog(void);
+	~CInputLog(void);
+
+	// Returns 0 (with the reason in error) if the log or its checkpoint cannot be written
+	int  open(const char *path, CFluidSim &sim, const char **error = 0);
+	int  close(CFluidSim &sim);	// Returns 0 if anything failed to write
+	bool isOpen(void) const	{ return m_file != 0; }
+
+	void clearSources(void)							{ write(eInputClearSources, 0, 0, 0.0f, 0.0f); }
+	void density(int i, int j, float amount)		{ write(eInputDensity, i, j, amount, 0.0f); }
+	void velocity(int i, int j, float u, float v)	{ write(eInputVelocity, i, j, u, v); }
+	void step(float dt)								{ write(eInputStep, 0, 0, dt, 0.0f); }
+	void forcing(float dt)							{ write(eInputForcing, 0, 0, dt, 0.0f); }
+	void frame(void)								{ write(eInputFrame, 0, 0, 0.0f, 0.0f); }
+	void action(CFluidSim &sim, int action, float value = 0.0f);
+
+	long long getEvents(void) const	{ return m_header.events; }
+	long long getSteps(void) const	{ return m_header.steps; }
+
+	// FNV-1a over the density and velocity in row order, the same whatever the layout
+	static unsigned long long checksum(CFluidSim &sim);
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Class:	"CInputReplay"
+//
+// Purpose: Reads a whole log into memory, so the replay never waits on the disk, and puts a sim back where the log
+//			started. apply() does one event the way the session did it.
+//
+// Usage:	open(path), start(sim), then apply(sim, getEvent(e)) for every event and compare checksum(sim) with the
+//			header's at the end.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class CInputReplay
+{
+
+private:
+
+	tInputLogHeader	m_header;
+	tInputEvent		*m_events;
+	char			*m_start;	// Path of the starting checkpoint
+	bool			m_closed;	// The writer closed it, so the checksum is there to check
+
+	CInputReplay(const CInputReplay&);
+	CInputReplay&operator = (const CInputReplay&);
+
+public:
+
+	CInputReplay(void);
+	~CInputReplay(void);
+
+	// Returns 0 (with the reason in error) if the file is not a log this build reads
+	int  open(const char *path, const char **error = 0);
+	void close(void);
+
+	// Restores the starting checkpoint into the sim, N and the random sequence come from it
+	int  start(CFluidSim &sim, const char **error = 0) const;
+
+	const tInputLogHeader &getHeader(void) const	{ return m_header; }
+	long long getEventCount(void) const				{ return m_header.events; }
+	const tInputEvent &getEvent(long long e) const	{ return m_events[e]; }
+	bool isClosed(void) const						{ return m_closed; }
+
+	static void apply(CFluidSim &sim, const tInputEvent &event);
+};
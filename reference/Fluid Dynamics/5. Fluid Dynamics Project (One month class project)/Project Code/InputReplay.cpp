@@ -0,0 +1,401 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	"InputReplay.cpp"
+//
+// Purpose: Plays input logs (see InputLog.h) back headless, as fast as they go, so a recorded session is a workload
+//			that runs the same every time.
+//
+// Usage:	input_replay info file			what is in the log: events by kind, steps, frames and the dt they used
+//			input_replay replay file [repeats] [mesh] [render=soft|null] [size=WxH] [frames=path.png|.ppm] [every=k]
+//				[velocity] [flow[=path.png|.ppm]] [meshsize=n] [filter=bicubic|bilinear]
+//
+//			replay restores the log's starting checkpoint, applies every event in order and times it, then checks the
+//			fields against the checksum the session ended on and exits 1 if they differ. Each repeat starts over from
+//			the checkpoint. mesh builds the surface mesh at every forcing pass too, as the demo's render does, and
+//			says how much of it the builds redid. render draws every frame as well, from where the demo's camera
+//			starts: soft on the CPU (SoftRenderer.h) at size, 800x600 by default, null only submitting the draws.
+//			frames writes every k-th frame soft drew, numbered before the extension. velocity draws the velocity
+//			glyphs as well (VelocityGlyphs.h), as the demo does with backspace toggled. flow colours the mesh with
+//			the flow's LIC (FlowLic.h) at every forcing pass, as the demo does with 'n', and with a path writes the
+//			LIC image of every k-th frame too, numbered as the frames are. meshsize builds the mesh n cells a side
+//			whatever the log's N, from the fields resampled (FieldResampler.h) with filter, bicubic by default, as the
+//			demo does with 'u' and 'y'. The frame time percentiles per stage are printed at the end, over every
+//			repeat, with the draws under draw and the LIC and the resampling under mesh.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Simulation.h"
+#include "InputLog.h"
+#include "Mesh.h"
+#include "SoftRenderer.h"
+#include "VelocityGlyphs.h"
+#include "FlowLic.h"
+#include "FieldResampler.h"
+#include "FrameStats.h"
+#include "Timer.h"
+
+static int usage(const char *name)
+{
+	fprintf ( stderr, "usage : %s info file | replay file [repeats] [mesh] [render=soft|null] [size=WxH] [frames=path] [every=k]"
+		" [velocity] [flow[=path]] [meshsize=n] [filter=bicubic|bilinear]\n", name );
+	return 1;
+}
+
+static int openReplay(CInputReplay &replay, const char *path)
+{
+	const char *error = 0;
+	if(!replay.open(path, &error))
+	{
+		fprintf ( stderr, "%s: %s\n", path, error );
+		return 0;
+	}
+	return 1;
+}
+
+static int info(const char *path)
+{
+	CInputReplay replay;
+	if(!openReplay(replay, path))
+		return 1;
+
+	static const char *kinds[totalInputEventCount] = { "clear", "density", "velocity", "step", "forcing", "frame", "action" };
+	long long counts[totalInputEventCount] = { 0 };
+	double sum = 0.0, lo = 0.0, hi = 0.0;
+	long long steps = 0;
+	for(long long e = 0; e < replay.getEventCount(); e++)
+	{
+		const tInputEvent &event = replay.getEvent(e);
+		if(event.type >= 0 && event.type < totalInputEventCount)
+			counts[event.type]++;
+		if(event.type == eInputStep)
+		{
+			if(!steps || event.x < lo) lo = event.x;
+			if(!steps || event.x > hi) hi = event.x;
+			sum += event.x;
+			steps++;
+		}
+	}
+
+	const tInputLogHeader &h = replay.getHeader();
+	printf ( "%s: version %u, N=%d, seed %u, from step %.0f, %s\n", path, h.version, h.N, h.seed, (double)h.startStep,
+		replay.isClosed() ? "closed" : "not closed (no checksum to check against)" );
+	printf ( "events    %.0f:", (double)h.events );
+	for(int k = 0; k < totalInputEventCount; k++)
+		printf ( " %s %.0f", kinds[k], (double)counts[k] );
+	printf ( "\n" );
+	printf ( "steps     %.0f, %.0f frames\n", (double)h.steps, (double)h.frames );
+	if(steps)
+		printf ( "dt        min %g, mean %g, max %g, %.1f s of sim time\n", lo, sum/steps, hi, sum );
+	if(replay.isClosed())
+		printf ( "checksum  %016llx\n", h.checksum );
+	return 0;
+}
+
+// Where CDemo's camera starts, the GLFrame after its constructor's moves and turns
+static const float s_eye[3]		= { 20.0f, -15.0f, -20.0f };
+static const float s_forward[3]	= { -0.334988f, 0.437388f, 0.83455f };
+static const float s_up[3]		= { 0.388307f, -0.742925f, 0.545234f };
+
+// How replay draws, when it does
+struct tReplayRender
+{
+	const char	*backend;	// "soft", "null" or NULL for no drawing
+	int			width;
+	int			height;
+	const char	*frames;	// Path the frames are numbered into, NULL for none
+	int			every;
+	bool		velocity;	// The glyphs too
+};
+
+// What replay does with the flow's LIC
+struct tReplayFlow
+{
+	bool		on;			// Computed at every forcing pass, as the mesh's colours
+	const char	*images;	// Path the images are numbered into, NULL for none
+};
+
+// The mesh's own N and how the fields get there
+struct tReplayMesh
+{
+	bool		on;
+	int			size;		// 0 for the log's N
+	int			filter;
+};
+
+// CDemo::render's frame: the camera, the light over the water, the ship, the glyphs when there are any and the surface
+static void drawFrame(CRenderBackend &renderer, CFluidSim &sim, CWaterMesh &surface, CVelocityGlyphs *glyphs, float dt,
+	tFrameTimes &frameTimes)
+{
+	static const float whereLight[3] = { 13.0f, 5.0f, 13.0f }, someLight[3] = { 1.0f, 1.0f, 1.0f };
+	renderer.beginFrame();
+	renderer.setCamera(s_eye, s_forward, s_up);
+	renderer.setLight(0, whereLight, someLight);
+	{
+		CStageTimer stage(&frameTimes, eStageMesh);
+		surface.selectLod(renderer);
+	}
+	CStageTimer stage(&frameTimes, eStageDraw);
+	sim.getShip().render(renderer, dt);
+	if(glyphs)
+	{
+		glyphs->build(sim.getU(), sim.getV());
+		glyphs->render(renderer);
+	}
+	surface.render(renderer);
+	renderer.endFrame();
+}
+
+// path with the frame's number before its extension, frame.png as frame00042.png. NULL when out of memory
+static char *frameName(const char *path, long long frame)
+{
+	const char *dot = strrchr(path, '.');
+	if(!dot || strchr(dot, '/'))
+		dot = path + strlen(path);
+	char *name = (char *)malloc ( strlen(path) + 24 );
+	if(name)
+		sprintf ( name, "%.*s%05ld%s", (int)(dot - path), path, (long)frame, dot );
+	return name;
+}
+
+static int saveFrame(const CSoftRenderer &renderer, const char *path, long long frame)
+{
+	char *name = frameName(path, frame);
+	if(!name)
+		return 0;
+	int ok = renderer.save(name);
+	if(!ok)
+		fprintf ( stderr, "cannot write %s\n", name );
+	free ( name );
+	return ok;
+}
+
+static int saveFlow(const CFlowLic &flow, const char *path, long long frame)
+{
+	char *name = frameName(path, frame);
+	if(!name)
+		return 0;
+	int ok = flow.save(name);
+	if(!ok)
+		fprintf ( stderr, "cannot write %s\n", name );
+	free ( name );
+	return ok;
+}
+
+static int replay(const char *path, int repeats, tReplayMesh mesh, const tReplayRender &draw, const tReplayFlow &lic)
+{
+	CInputReplay log;
+	if(!openReplay(log, path))
+		return 1;
+
+	CFluidSim sim;
+	CWaterMesh surface;
+	CVelocityGlyphs glyphs;
+	CFlowLic flow;
+	CFieldResampler resampler;
+	CFrameStats frameStats;
+	tFrameTimes frameTimes;
+	const char *error = 0;
+	int failed = 0;
+	double best = 0.0, total = 0.0, simTime = 0.0, rebuilt = 0.0;
+	long long builds = 0, frames = 0, written = 0, flowWritten = 0;
+	double triangles = 0.0, lines = 0.0;
+	float forcingDt = 0.0f;
+
+	CSoftRenderer *soft = NULL;
+	CNullRenderer null;
+	CRenderBackend *renderer = NULL;
+	if(draw.backend)
+	{
+		mesh.on = true;
+		if(!strcmp(draw.backend, "soft"))
+			renderer = soft = new CSoftRenderer;
+		else
+			renderer = &null;
+		renderer->resize(draw.width, draw.height);
+		if(soft && !soft->getPixels())
+		{
+			fprintf ( stderr, "out of memory for a %dx%d frame\n", draw.width, draw.height );
+			delete soft;
+			return 1;
+		}
+	}
+
+	for(int r = 0; r < repeats; r++)
+	{
+		if(!log.start(sim, &error))
+		{
+			fprintf ( stderr, "%s: %s\n", path, error );
+			return 1;
+		}
+		int meshN = mesh.size ? mesh.size : N;
+		if(mesh.on && (r == 0 || surface.getSize() != meshN))
+		{
+			if(!surface.allocateMesh(meshN) || (meshN != N && !resampler.allocate(meshN, mesh.filter)))
+			{
+				fprintf ( stderr, "out of memory for a %dx%d mesh\n", meshN, meshN );
+				delete soft;
+				return 1;
+			}
+			surface.setIndices();
+		}
+		sim.setFrameTimes(&frameTimes);
+		frameTimes.clear();
+		simTime = 0.0;
+
+		CTimer timer;
+		for(long long e = 0; e < log.getEventCount(); e++)
+		{
+			const tInputEvent &event = log.getEvent(e);
+			switch(event.type)
+			{
+			case eInputClearSources:
+			case eInputDensity:
+			case eInputVelocity:
+				{
+					CStageTimer stage(&frameTimes, eStageSources);
+					CInputReplay::apply(sim, event);
+				}
+				break;
+			case eInputStep:
+				simTime += event.x;
+				CInputReplay::apply(sim, event);
+				break;
+			case eInputForcing:
+				CInputReplay::apply(sim, event);
+				forcingDt = event.x;
+				if(mesh.on)
+				{
+					CStageTimer stage(&frameTimes, eStageMesh);
+					// On failure the colours from before may have been freed
+					if(lic.on)
+						surface.setColorSource(flow.compute(sim.getU(), sim.getV(), meshN) ? flow.getVertexColors() : NULL);
+					if(meshN == N)
+						surface.build(sim.getDensity(), sim.getU(), sim.getV());
+					else if(resampler.resample(sim.getDensity(), sim.getU(), sim.getV()))
+						surface.build(resampler.getDensity(), resampler.getU(), resampler.getV());
+					if(renderer)
+						surface.expand();
+					rebuilt += surface.getRebuilt();
+					builds++;
+				}
+				break;
+			case eInputFrame:
+				if(renderer)
+				{
+					drawFrame(*renderer, sim, surface, draw.velocity ? &glyphs : NULL, forcingDt, frameTimes);
+					triangles += (double)renderer->getStats().triangles;
+					lines += (double)renderer->getStats().lines;
+				}
+				frameStats.record(frameTimes);
+				frameTimes.clear();
+				if(soft && draw.frames && frames % draw.every == 0)
+					written += saveFrame(*soft, draw.frames, frames);
+				if(lic.images && flow.getImage() && frames % draw.every == 0)
+					flowWritten += saveFlow(flow, lic.images, frames);
+				frames++;
+				break;
+			default:
+				CInputReplay::apply(sim, event);
+				break;
+			}
+		}
+		double seconds = timer.GetElapsedSeconds();
+		sim.setFrameTimes(NULL);
+
+		int same = !log.isClosed() || CInputLog::checksum(sim) == log.getHeader().checksum;
+		failed += !same;
+		if(r == 0 || seconds < best)
+			best = seconds;
+		total += seconds;
+		printf ( "run %d     %.3f s, %.2f ms a step, %.1fx real time%s\n", r + 1, seconds,
+			log.getHeader().steps ? 1e3*seconds/log.getHeader().steps : 0.0, simTime > 0.0 ? simTime/seconds : 0.0,
+			!log.isClosed() ? "" : same ? ", fields match the session" : ", fields DIFFER from the session" );
+	}
+
+	long long steps = log.getHeader().steps;
+	printf ( "\nN=%d, %.0f events, %.0f steps, %d runs%s\n", N, (double)log.getEventCount(), (double)steps, repeats,
+		mesh.on ? " with the mesh" : "" );
+	printf ( "best      %.3f s, %.4g cells/s\n", best, steps ? (double)N*N*steps/best : 0.0 );
+	printf ( "mean      %.3f s\n", total/repeats );
+	if(builds)
+		printf ( "mesh      %dx%d, %.1f%% rebuilt a frame\n", surface.getSize(), surface.getSize(), 100.0*rebuilt/builds );
+	if(builds && surface.getSize() != N)
+		printf ( "resample  %s from %dx%d\n", CFieldResampler::filterName(mesh.filter), N, N );
+	if(renderer && frames)
+	{
+		printf ( "render    %s %dx%d, %.0f triangles a frame, %.0f frames written\n", draw.backend, renderer->getWidth(),
+			renderer->getHeight(), triangles/frames, (double)written );
+		if(draw.velocity)
+			printf ( "velocity  %.0f lines a frame, a glyph every %d cells\n", lines/frames, glyphs.getStride() );
+	}
+	if(lic.on)
+		printf ( "flow      %dx%d texels, %.0f images written\n", flow.getSide(), flow.getSide(), (double)flowWritten );
+	delete soft;
+	if(frameStats.getFrame().getCount())
+	{
+		printf ( "\n" );
+		frameStats.report(stdout);
+	}
+	return failed ? 1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+	if(argc >= 3 && !strcmp(argv[1], "info"))
+		return info(argv[2]);
+	if(argc >= 3 && !strcmp(argv[1], "replay"))
+	{
+		int repeats = 1;
+		tReplayMesh mesh = { false, 0, eResampleBicubic };
+		tReplayRender draw = { NULL, WINDOW_WIDTH, WINDOW_HEIGHT, NULL, 1, false };
+		tReplayFlow lic = { false, NULL };
+		for(int a = 3; a < argc; a++)
+		{
+			if(!strcmp(argv[a], "mesh"))
+				mesh.on = true;
+			else if(!strcmp(argv[a], "velocity"))
+				draw.velocity = true;
+			else if(!strcmp(argv[a], "flow"))
+				lic.on = mesh.on = true;
+			else if(!strncmp(argv[a], "flow=", 5))
+			{
+				lic.on = mesh.on = true;
+				lic.images = argv[a] + 5;
+			}
+			else if(!strcmp(argv[a], "render=soft") || !strcmp(argv[a], "render=null"))
+				draw.backend = argv[a] + 7;
+			else if(!strncmp(argv[a], "size=", 5))
+			{
+				if(sscanf ( argv[a] + 5, "%dx%d", &draw.width, &draw.height ) != 2 || draw.width < 1 || draw.height < 1)
+					return usage(argv[0]);
+			}
+			else if(!strncmp(argv[a], "frames=", 7))
+				draw.frames = argv[a] + 7;
+			else if(!strncmp(argv[a], "meshsize=", 9))
+			{
+				if((mesh.size = atoi(argv[a] + 9)) < 1)
+					return usage(argv[0]);
+				mesh.on = true;
+			}
+			else if(!strcmp(argv[a], "filter=bicubic") || !strcmp(argv[a], "filter=bilinear"))
+			{
+				mesh.filter = !strcmp(argv[a] + 7, "bicubic") ? eResampleBicubic : eResampleBilinear;
+				mesh.on = true;
+			}
+			else if(!strncmp(argv[a], "every=", 6))
+			{
+				if((draw.every = atoi(argv[a] + 6)) < 1)
+					return usage(argv[0]);
+			}
+			else if((repeats = atoi(argv[a])) < 1)
+				return usage(argv[0]);
+		}
+		if((draw.frames || draw.velocity) && !draw.backend)
+			draw.backend = "soft";
+		if(draw.frames && strcmp(draw.backend, "soft"))
+			return usage(argv[0]);
+		return replay(argv[2], repeats, mesh, draw, lic);
+	}
+	return usage(argv[0]);
+}
@@ -0,0 +1,510 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	"KernelBench.cpp"
+//
+// Purpose: Times each solver kernel, every stage of vel_step and dens_step, and the mesh build (its normal pass alone,
+//			and a build where nothing changed, which is the dirty tile scan) over a sweep of grid sizes and OpenMP
+//			thread counts, and reports ns per cell and the modelled memory bandwidth. With -o the results are also
+//			written as JSON, which BenchCompare.py checks against a stored baseline (see the bench_baseline and
+//			bench_check targets in the Makefile).
+//
+//			Each point is placed on a roofline. The machine's triad bandwidth and multiply-add rate are measured first
+//			at every thread count, and each kernel's modelled flops per byte against their ratio says whether it should
+//			be memory or compute bound. A kernel reaching under a quarter of its roof is called latency bound (serial
+//			dependences, gathers), one going past the DRAM roof is running out of cache.
+//
+// Usage:	kernel_bench [-n 64,128,...] [-t 1,2,...] [-s seconds] [-c] [-o results.json]
+//
+//			-n	grid sizes, default 64 up to 4096 in powers of two
+//			-t	thread counts, default 1 up to the OpenMP maximum in powers of two
+//			-s	minimum time spent on each kernel at each point, default 0.25
+//			-c	hardware counters (Linux perf_event_open): IPC, LLC and dTLB misses per cell, the bytes per cell
+//				the LLC misses imply and the CPU utilisation. Events the machine does not have print as -
+//			-o	JSON output
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "Solver.h"
+#include "Mesh.h"
+#include "Timer.h"
+#include "PerfCounters.h"
+
+extern int N;
+
+#if FIELD_LAYOUT == FIELD_LAYOUT_TILED
+static const char *layoutName = "tiled";
+#elif FIELD_LAYOUT == FIELD_LAYOUT_PADDED
+static const char *layoutName = "padded";
+#else
+static const char *layoutName = "linear";
+#endif
+
+#if VELOCITY_LAYOUT == VELOCITY_LAYOUT_INTERLEAVED
+static const char *velocityLayoutName = "interleaved";
+#elif VELOCITY_LAYOUT == VELOCITY_LAYOUT_AOSOA
+static const char *velocityLayoutName = "aosoa";
+#else
+static const char *velocityLayoutName = "planar";
+#endif
+
+enum eKernel{eAddSource = 0, eSetBnd, eLinSolve, eDiffuse, eAdvect, eProject, eAddSourceVelocity, eDiffuseVelocity,
+			 eAdvectVelocity, eVelStep, eDensStep, eMeshBuild, eMeshNormals, eMeshUpdate,
+			 totalKernelCount};
+
+// A LIN_SOLVE_ITERATIONS sweep solve: each Gauss-Seidel sweep reads x0, reads and writes x, and updates with 6 flops
+#define SOLVE_STREAMS	(3*LIN_SOLVE_ITERATIONS)
+#define SOLVE_FLOPS		(6*LIN_SOLVE_ITERATIONS)
+#define PROJECT_STREAMS	(4 + SOLVE_STREAMS + 5)
+#define PROJECT_FLOPS	(SOLVE_FLOPS + 8)
+
+// Modelled memory traffic in floats per cell (per ghost cell for set_bnd), each pass over a field counted once:
+// lin_solve and diffuse one solve; project its divergence (4), a solve and its gradient (5); the velocity stages
+// twice their scalar versions; vel_step as in LayoutBench; dens_step add_source 3, a diffuse and advect 4; the mesh
+// reads 3 fields and writes its 8 byte vertex and a float height, then the normal pass reads the heights and writes
+// 2 bytes of normal (the colour table stays in cache and is not counted); mesh_build writes the snapshot as well,
+// which mesh_update reads back with the fields
+static const char  *kernelNames[totalKernelCount]   = { "add_source", "set_bnd", "lin_solve", "diffuse", "advect", "project",
+														"add_source_velocity", "diffuse_velocity", "advect_velocity",
+														"vel_step", "dens_step", "mesh_build", "mesh_normals",
+														"mesh_update" };
+static const double kernelStreams[totalKernelCount] = { 3, 2, SOLVE_STREAMS, SOLVE_STREAMS, 4, PROJECT_STREAMS, 6,
+														2*SOLVE_STREAMS, 6, 6 + 2*SOLVE_STREAMS + 2*PROJECT_STREAMS + 6,
+														3 + SOLVE_STREAMS + 4, 10.5, 1.5, 6 };
+
+// Modelled floating point operations per cell: a solve as above; advect backtraces (4), finds the weights (4) and
+// blends (9) plus the clamps; project adds its divergence and gradient (8) to a solve; advect_velocity shares the
+// backtrace between both components; the mesh finds the colour table's indices and the height (20), the normal two
+// differences and a normalise (12), the scan three differences and their maximum (6)
+static const double kernelFlops[totalKernelCount]   = { 2, 1, SOLVE_FLOPS, SOLVE_FLOPS, 18, PROJECT_FLOPS, 4,
+														2*SOLVE_FLOPS, 26, 4 + 2*SOLVE_FLOPS + 2*PROJECT_FLOPS + 26,
+														2 + SOLVE_FLOPS + 18, 32, 12, 6 };
+
+#define LATENCY_FRACTION 0.25	// Under this fraction of the roof a kernel is latency bound
+
+#define MAX_POINTS 32
+
+struct tFields
+{
+	float *u, *v, *u0, *v0;
+	float *d, *d0;
+	CWaterMesh mesh;
+};
+
+// The roofs at one thread count
+struct tMachine
+{
+	double gbPerSecond;	// Triad bandwidth
+	double gflops;		// Independent multiply-adds
+};
+
+#define PEAK_FLOATS (1<<24)	// Per triad array, 64MB, well past any LLC
+
+static int parseList(const char *arg, int *list)
+{
+	int count = 0;
+	while(*arg && count < MAX_POINTS)
+	{
+		list[count++] = atoi(arg);
+		const char *comma = strchr(arg, ',');
+		if(!comma)
+			break;
+		arg = comma + 1;
+	}
+	return count;
+}
+
+// Solid body rotation, 1.5 cells per step at the rim, and a density pattern to carry
+static void fillState(tFields &f, float dt)
+{
+	int i, j;
+	float cells = 1.5f / (dt*N);
+
+	clear_velocity ( N, f.u0, f.v0 );
+	for ( i=0 ; i<=N+1 ; i++ ) {
+		for ( j=0 ; j<=N+1 ; j++ ) {
+			float x = (i - 0.5f*(N+1)) / (0.5f*N);
+			float y = (j - 0.5f*(N+1)) / (0.5f*N);
+			f.u[VIX(i,j)] = -y*cells;
+			f.v[VIX(i,j)] =  x*cells;
+			f.d[IX(i,j)]  = (float)((i*7 + j*13) % 17) / 17.0f;
+			f.d0[IX(i,j)] = 0.0f;
+		}
+	}
+}
+
+// Best STREAM triad rate, counted as two reads and a write like the kernel models
+static double measureBandwidth(float *a, const float *b, const float *c, double minSeconds)
+{
+	double best = 0.0;
+	CTimer total;
+	do
+	{
+		CTimer timer;
+		#pragma omp parallel for
+		for(int i = 0; i < PEAK_FLOATS; i++)
+			a[i] = b[i] + 3.0f*c[i];
+		double rate = 3.0*sizeof(float)*PEAK_FLOATS/timer.GetElapsedSeconds()/1e9;
+		if(rate > best)
+			best = rate;
+	}
+	while(total.GetElapsedSeconds() < minSeconds);
+	return best;
+}
+
+// Best multiply-add rate over independent chains, vectorised as far as this build's flags allow the kernels to be
+static double measureCompute(double minSeconds)
+{
+	const int chains = 32, iterations = 1<<20;
+	double best = 0.0;
+	volatile float sink = 0.0f;
+	CTimer total;
+	do
+	{
+		int threads = 1;
+		float sum = 0.0f;
+		CTimer timer;
+		#pragma omp parallel reduction(+:sum)
+		{
+			float acc[chains];
+			for(int k = 0; k < chains; k++)
+				acc[k] = (float)k;
+			for(int it = 0; it < iterations; it++)
+				for(int k = 0; k < chains; k++)
+					acc[k] = acc[k]*0.999999f + 0.000001f;
+			for(int k = 0; k < chains; k++)
+				sum += acc[k];
+#ifdef _OPENMP
+			#pragma omp master
+			threads = omp_get_num_threads();
+#endif
+		}
+		double rate = 2.0*chains*iterations*threads/timer.GetElapsedSeconds()/1e9;
+		if(rate > best)
+			best = rate;
+		sink = sink + sum;
+	}
+	while(total.GetElapsedSeconds() < minSeconds);
+	return best;
+}
+
+// Prints a per cell count, or - when the event is not counted
+static void printCount(long long count, double cells, const char *format)
+{
+	if(count < 0)
+		printf ( " %8s", "-" );
+	else
+		printf ( format, count/cells );
+}
+
+static void jsonCount(FILE *json, const char *name, long long count, double cells)
+{
+	if(count < 0)
+		fprintf ( json, ", \"%s\": null", name );
+	else
+		fprintf ( json, ", \"%s\": %.4f", name, count/cells );
+}
+
+static void runKernel(tFields &f, int kernel, float dt)
+{
+	switch(kernel)
+	{
+	case eAddSource:
+		add_source ( N, f.d, f.d0, dt );
+		break;
+	case eSetBnd:
+		set_bnd ( N, 0, f.d );
+		break;
+	case eLinSolve:
+		lin_solve ( N, 0, f.d, f.d0, 1, 4 );
+		break;
+	case eDiffuse:
+		diffuse ( N, 0, f.d0, f.d, 0.0001f, dt );
+		break;
+	case eAdvect:
+		advect ( N, 0, f.d0, f.d, f.u, f.v, dt );
+		break;
+	case eProject:
+		project ( N, f.u, f.v, f.u0, f.v0 );
+		break;
+	// The velocity stages write into the scratch pair so the flow is the same every rep
+	case eAddSourceVelocity:
+		add_source_velocity ( N, f.u, f.v, f.u0, f.v0, dt );
+		break;
+	case eDiffuseVelocity:
+		diffuse_velocity ( N, f.u0, f.v0, f.u, f.v, 0.0f, dt );
+		break;
+	case eAdvectVelocity:
+		advect_velocity ( N, f.u0, f.v0, f.u, f.v, dt );
+		break;
+	case eVelStep:
+		// The sources are scratch after a step, clear them as the demo does every frame
+		clear_velocity ( N, f.u0, f.v0 );
+		vel_step ( N, f.u, f.v, f.u0, f.v0, 0.0f, dt );
+		break;
+	case eDensStep:
+		for ( int i=0, size=FIELD_SIZE(N) ; i<size ; i++ ) f.d0[i] = 0.0f;
+		dens_step ( N, f.d, f.d0, f.u, f.v, 0.0001f, dt );
+		break;
+	case eMeshBuild:
+		// Every tile, the fields here stand still
+		f.mesh.invalidate();
+		f.mesh.build ( f.d, f.u, f.v );
+		break;
+	case eMeshNormals:
+		// The heights are the last mesh_build's
+		f.mesh.buildNormals();
+		break;
+	case eMeshUpdate:
+		// Nothing moved since the last mesh_build, so this is the cost of finding that out
+		f.mesh.build ( f.d, f.u, f.v );
+		break;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int sizes[MAX_POINTS], threads[MAX_POINTS];
+	int sizeCount = 0, threadCount = 0;
+	double minSeconds = 0.25;
+	const char *jsonPath = NULL;
+	bool counters = false;
+	float dt = 0.1f;
+
+	for(int a = 1; a < argc; a++)
+	{
+		if(!strcmp(argv[a], "-n") && a+1 < argc)
+			sizeCount = parseList(argv[++a], sizes);
+		else if(!strcmp(argv[a], "-t") && a+1 < argc)
+			threadCount = parseList(argv[++a], threads);
+		else if(!strcmp(argv[a], "-s") && a+1 < argc)
+			minSeconds = atof(argv[++a]);
+		else if(!strcmp(argv[a], "-c"))
+			counters = true;
+		else if(!strcmp(argv[a], "-o") && a+1 < argc)
+			jsonPath = argv[++a];
+		else
+		{
+			fprintf ( stderr, "usage : %s [-n 64,128,...] [-t 1,2,...] [-s seconds] [-c] [-o results.json]\n", argv[0] );
+			return 1;
+		}
+	}
+
+	if(!sizeCount)
+		for(int n = 64; n <= 4096; n *= 2)
+			sizes[sizeCount++] = n;
+
+	int maxThreads = 1;
+#ifdef _OPENMP
+	maxThreads = omp_get_max_threads();
+#endif
+	if(!threadCount)
+	{
+		for(int t = 1; t < maxThreads; t *= 2)
+			threads[threadCount++] = t;
+		threads[threadCount++] = maxThreads;
+	}
+
+	// Before the first parallel region, so the OpenMP workers inherit the counters
+	CPerfCounters perf;
+	if(counters && !perf.open())
+	{
+		fprintf ( stderr, "no performance counters could be opened, running without -c\n" );
+		counters = false;
+	}
+
+	tMachine machine[MAX_POINTS];
+	float *peakA = (float *) malloc ( PEAK_FLOATS*sizeof(float) );
+	float *peakB = (float *) malloc ( PEAK_FLOATS*sizeof(float) );
+	float *peakC = (float *) malloc ( PEAK_FLOATS*sizeof(float) );
+	if(!peakA || !peakB || !peakC)
+	{
+		fprintf ( stderr, "cannot allocate the bandwidth arrays\n" );
+		return 1;
+	}
+	for(int i = 0; i < PEAK_FLOATS; i++)
+		peakA[i] = peakB[i] = peakC[i] = 1.0f;
+	for(int t = 0; t < threadCount; t++)
+	{
+#ifdef _OPENMP
+		omp_set_num_threads(threads[t]);
+#endif
+		machine[t].gbPerSecond	= measureBandwidth(peakA, peakB, peakC, minSeconds);
+		machine[t].gflops		= measureCompute(minSeconds);
+		printf ( "threads=%d roofs: %.2f GB/s, %.2f GFLOP/s, ridge %.2f flop/byte\n", threads[t],
+			machine[t].gbPerSecond, machine[t].gflops, machine[t].gflops/machine[t].gbPerSecond );
+	}
+	free ( peakA ); free ( peakB ); free ( peakC );
+
+	FILE *json = NULL;
+	if(jsonPath)
+	{
+		json = fopen(jsonPath, "w");
+		if(!json)
+		{
+			fprintf ( stderr, "cannot open %s\n", jsonPath );
+			return 1;
+		}
+		fprintf ( json, "{\n  \"benchmark\": \"kernel_bench\",\n  \"field_layout\": \"%s\",\n  \"velocity_layout\": \"%s\",\n"
+			"  \"max_threads\": %d,\n  \"min_seconds\": %g,\n  \"timestamp\": %ld,\n  \"counters\": [",
+			layoutName, velocityLayoutName, maxThreads, minSeconds, (long)time(0) );
+		bool firstEvent = true;
+		for(int e = 0; e < totalPerfEventCount; e++)
+		{
+			if(!counters || !perf.isOpen(e))
+				continue;
+			fprintf ( json, "%s\"%s\"", firstEvent ? "" : ", ", CPerfCounters::eventName(e) );
+			firstEvent = false;
+		}
+		fprintf ( json, "],\n  \"machine\": [" );
+		for(int t = 0; t < threadCount; t++)
+			fprintf ( json, "%s\n    {\"threads\": %d, \"gb_per_s\": %.4f, \"gflops\": %.4f}", t ? "," : "",
+				threads[t], machine[t].gbPerSecond, machine[t].gflops );
+		fprintf ( json, "\n  ],\n  \"results\": [" );
+	}
+	bool first = true;
+
+	printf ( "layout=%s velocity=%s max threads=%d\n", layoutName, velocityLayoutName, maxThreads );
+	printf ( "%-19s %5s %7s %8s %12s %10s %8s %8s %6s %6s", "kernel", "N", "threads", "reps", "ms/call", "ns/cell",
+		"GB/s", "GFLOP/s", "flop/B", "roof%" );
+	if(counters)
+		printf ( " %-8s %8s %8s %8s %8s %8s", "bound", "IPC", "LLC/cell", "TLB/cell", "B/cell", "cpu%" );
+	else
+		printf ( " bound" );
+	printf ( "\n" );
+
+	for(int s = 0; s < sizeCount; s++)
+	{
+		if(sizes[s] < 8)
+		{
+			fprintf ( stderr, "skipping N=%d, too small\n", sizes[s] );
+			continue;
+		}
+		N = sizes[s];
+
+		tFields f;
+		f.u = f.v = f.u0 = f.v0 = NULL;
+		int velocity = allocate_velocity ( N, &f.u, &f.v ) && allocate_velocity ( N, &f.u0, &f.v0 );
+		f.d	 = allocate_field ( N );
+		f.d0 = allocate_field ( N );
+		if ( !velocity || !f.d || !f.d0 || !f.mesh.allocateMesh ( N ) ) {
+			fprintf ( stderr, "cannot allocate data for N=%d\n", N );
+			free_velocity ( f.u, f.v ); free_velocity ( f.u0, f.v0 ); free_field ( f.d ); free_field ( f.d0 );
+			continue;
+		}
+		f.mesh.setIndices();
+
+		for(int t = 0; t < threadCount; t++)
+		{
+#ifdef _OPENMP
+			omp_set_num_threads(threads[t]);
+#else
+			if(threads[t] != 1)
+				continue;
+#endif
+			for(int k = 0; k < totalKernelCount; k++)
+			{
+				fillState(f, dt);
+				runKernel(f, k, dt); // Warm up, faults the pages in
+
+				int reps = 0;
+				double seconds = 0.0;
+				tPerfSample start, end;
+				perf.sample(start);
+				CTimer timer;
+				do
+				{
+					runKernel(f, k, dt);
+					reps++;
+					seconds = timer.GetElapsedSeconds();
+				}
+				while(seconds < minSeconds);
+				perf.sample(end);
+				tPerfSample count = end.since(start);
+
+				double cells = k == eSetBnd ? 4.0*N : (double)N*N;
+				double nsPerCell = 1e9*seconds/(reps*cells);
+				double bytesPerCell = kernelStreams[k]*sizeof(float);
+				double gbPerSecond = bytesPerCell*cells*reps/seconds/1e9;
+				double gflops = kernelFlops[k]*cells*reps/seconds/1e9;
+
+				// Roofline
+				double intensity = kernelFlops[k]/bytesPerCell;
+				double ridge = machine[t].gflops/machine[t].gbPerSecond;
+				double roof = intensity < ridge ? intensity*machine[t].gbPerSecond : machine[t].gflops;
+				double roofFraction = gflops/roof;
+				const char *bound = roofFraction < LATENCY_FRACTION ? "latency" :
+									intensity >= ridge ? "compute" : roofFraction > 1.0 ? "cache" : "memory";
+
+				printf ( "%-19s %5d %7d %8d %12.4f %10.3f %8.2f %8.2f %6.2f %6.1f", kernelNames[k], N, threads[t], reps,
+					1e3*seconds/reps, nsPerCell, gbPerSecond, gflops, intensity, 100.0*roofFraction );
+				printf ( counters ? " %-8s" : " %s", bound );
+
+				// Counter derived values, all per cell computed
+				double computed = cells*reps;
+				long long llcBytes = count.count[ePerfLLCMisses] < 0 ? -1 : count.count[ePerfLLCMisses]*64;
+				double utilisation = count.count[ePerfTaskClock] < 0 ? -1.0 :
+									 count.count[ePerfTaskClock]/(1e9*seconds*threads[t]);
+				double ipc = count.count[ePerfCycles] > 0 && count.count[ePerfInstructions] >= 0 ?
+							 (double)count.count[ePerfInstructions]/count.count[ePerfCycles] : -1.0;
+				if(counters)
+				{
+					if(ipc < 0.0)
+						printf ( " %8s", "-" );
+					else
+						printf ( " %8.2f", ipc );
+					printCount(count.count[ePerfLLCMisses], computed, " %8.3f");
+					printCount(count.count[ePerfDTLBMisses], computed, " %8.3f");
+					printCount(llcBytes, computed, " %8.1f");
+					if(utilisation < 0.0)
+						printf ( " %8s", "-" );
+					else
+						printf ( " %8.1f", 100.0*utilisation );
+				}
+				printf ( "\n" );
+				fflush ( stdout );
+
+				if(json)
+				{
+					fprintf ( json, "%s\n    {\"kernel\": \"%s\", \"N\": %d, \"threads\": %d, \"cells\": %.0f, \"reps\": %d, "
+						"\"seconds\": %.6f, \"ns_per_cell\": %.4f, \"bytes_per_cell\": %.0f, \"gb_per_s\": %.4f, "
+						"\"flops_per_cell\": %.0f, \"gflops\": %.4f, \"intensity\": %.4f, \"roof_fraction\": %.4f, \"bound\": \"%s\"",
+						first ? "" : ",", kernelNames[k], N, threads[t], cells, reps, seconds, nsPerCell,
+						bytesPerCell, gbPerSecond, kernelFlops[k], gflops, intensity, roofFraction, bound );
+					if(counters)
+					{
+						if(ipc < 0.0)
+							fprintf ( json, ", \"ipc\": null" );
+						else
+							fprintf ( json, ", \"ipc\": %.4f", ipc );
+						jsonCount(json, "cycles_per_cell", count.count[ePerfCycles], computed);
+						jsonCount(json, "instructions_per_cell", count.count[ePerfInstructions], computed);
+						jsonCount(json, "llc_misses_per_cell", count.count[ePerfLLCMisses], computed);
+						jsonCount(json, "dtlb_misses_per_cell", count.count[ePerfDTLBMisses], computed);
+						jsonCount(json, "measured_bytes_per_cell", llcBytes, computed);
+						if(utilisation < 0.0)
+							fprintf ( json, ", \"cpu_utilisation\": null" );
+						else
+							fprintf ( json, ", \"cpu_utilisation\": %.4f", utilisation );
+					}
+					fprintf ( json, "}" );
+					first = false;
+				}
+			}
+		}
+
+		f.mesh.freeMesh();
+		free_velocity ( f.u, f.v ); free_velocity ( f.u0, f.v0 ); free_field ( f.d ); free_field ( f.d0 );
+	}
+
+	if(json)
+	{
+		fprintf ( json, "\n  ]\n}\n" );
+		fclose ( json );
+	}
+	return 0;
+}
@@ -0,0 +1,143 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	"LayoutBench.cpp"
+//
+// Purpose: Times the solver kernels under the field and velocity layouts this binary was built with (see
+//			FIELD_LAYOUT and VELOCITY_LAYOUT in Def.h), so the layouts can be compared by running one build of each
+//			side by side.
+//
+// Usage:	layout_bench [N] [steps]
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "Solver.h"
+#include "Timer.h"
+
+enum eFlow{eDiagonal = 0, eRotational, totalFlowCount};
+static const char *flowNames[totalFlowCount] = { "diagonal", "rotational" };
+
+#if FIELD_LAYOUT == FIELD_LAYOUT_TILED
+static const char *layoutName = "tiled";
+#elif FIELD_LAYOUT == FIELD_LAYOUT_PADDED
+static const char *layoutName = "padded";
+#else
+static const char *layoutName = "linear";
+#endif
+
+#if VELOCITY_LAYOUT == VELOCITY_LAYOUT_INTERLEAVED
+static const char *velocityLayoutName = "interleaved";
+#elif VELOCITY_LAYOUT == VELOCITY_LAYOUT_AOSOA
+static const char *velocityLayoutName = "aosoa";
+#else
+static const char *velocityLayoutName = "planar";
+#endif
+
+// Modelled memory traffic of one vel_step, in floats per cell. Each pass over a field counts once:
+// add_source 2x3, diffuse 2 solves of 3 per sweep, project 2x(4 + a solve + 5), advect 2 + 2 backtrace + 2 taps
+#define VEL_STEP_STREAMS (6 + 2*3*LIN_SOLVE_ITERATIONS + 2*(4 + 3*LIN_SOLVE_ITERATIONS + 5) + 6)
+
+// Strong flows: the backtrace lands several cells away from the cell being written
+static void fillFlow(int N, int flow, float *u, float *v, float dt)
+{
+	int i, j;
+	float cells = 4.5f / (dt*N); // Velocity that moves 4.5 cells per step
+
+	for ( i=0 ; i<=N+1 ; i++ ) {
+		for ( j=0 ; j<=N+1 ; j++ ) {
+			if(flow == eDiagonal)
+			{
+				u[VIX(i,j)] = cells;
+				v[VIX(i,j)] = cells;
+			}
+			else
+			{
+				// Solid body rotation about the centre, 4.5 cells per step at the rim
+				float x = (i - 0.5f*(N+1)) / (0.5f*N);
+				float y = (j - 0.5f*(N+1)) / (0.5f*N);
+				u[VIX(i,j)] = -y*cells;
+				v[VIX(i,j)] =  x*cells;
+			}
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int N	  = argc > 1 ? atoi(argv[1]) : 2048;
+	int steps = argc > 2 ? atoi(argv[2]) : 20;
+	float dt  = 0.1f;
+	int i, j, size = FIELD_SIZE(N);
+
+	float *u, *v, *u0, *v0;
+	int velocity = allocate_velocity ( N, &u, &v ) && allocate_velocity ( N, &u0, &v0 );
+	float *d  = allocate_field ( N );
+	float *d0 = allocate_field ( N );
+	if ( !velocity || !d || !d0 ) {
+		fprintf ( stderr, "cannot allocate data\n" );
+		return 1;
+	}
+	for ( i=0 ; i<size ; i++ ) d[i] = 0.0f;
+	for ( i=0 ; i<=N+1 ; i++ )
+		for ( j=0 ; j<=N+1 ; j++ )
+			d0[IX(i,j)] = (float)((i*7 + j*13) % 17);
+
+	printf ( "layout=%s velocity=%s N=%d steps=%d field=%.1fMB\n", layoutName, velocityLayoutName,
+		N, steps, size*sizeof(float)/1048576.0 );
+
+	for(int flow = 0; flow < totalFlowCount; flow++)
+	{
+		fillFlow(N, flow, u, v, dt);
+		advect ( N, 0, d, d0, u, v, dt ); // Warm up, faults the pages in
+
+		CTimer timer;
+		for(int k = 0; k < steps; k++)
+			advect ( N, 0, d, d0, u, v, dt );
+		double seconds = timer.GetElapsedSeconds();
+
+		printf ( "advect %-10s %8.3f ms/step %7.3f ns/cell\n", flowNames[flow],
+			1e3*seconds/steps, 1e9*seconds/((double)steps*N*N) );
+	}
+
+	// The other stencil kernels, on the rotational flow left in (u,v)
+	{
+		CTimer timer;
+		for(int k = 0; k < steps; k++)
+			set_bnd ( N, 1, d );
+		double bnd = timer.GetElapsedSeconds();
+
+		timer.Reset();
+		lin_solve ( N, 0, d, d0, 1, 4 ); // LIN_SOLVE_ITERATIONS sweeps
+		double solve = timer.GetElapsedSeconds();
+
+		timer.Reset();
+		for(int k = 0; k < steps; k++)
+			project ( N, u, v, u0, v0 );
+		double proj = timer.GetElapsedSeconds();
+
+		printf ( "set_bnd  %-8s %8.3f ms/step %7.3f ns/ghost\n", "", 1e3*bnd/steps, 1e9*bnd/((double)steps*4*N) );
+		printf ( "lin_solve sweep   %8.3f ms/step %7.3f ns/cell\n", 1e3*solve/LIN_SOLVE_ITERATIONS, 1e9*solve/((double)LIN_SOLVE_ITERATIONS*N*N) );
+		printf ( "project  %-8s %8.3f ms/step %7.3f ns/cell\n", "", 1e3*proj/steps, 1e9*proj/((double)steps*N*N) );
+	}
+
+	// Velocity step bandwidth, the rotational flow is left in (u,v)
+	{
+		clear_velocity ( N, u0, v0 );
+		vel_step ( N, u, v, u0, v0, 0.0001f, dt );
+
+		CTimer timer;
+		for(int k = 0; k < steps; k++)
+		{
+			clear_velocity ( N, u0, v0 );
+			vel_step ( N, u, v, u0, v0, 0.0001f, dt );
+		}
+		double seconds = timer.GetElapsedSeconds();
+		double bytes = (double)VEL_STEP_STREAMS*sizeof(float)*N*N;
+
+		printf ( "vel_step %-8s %8.3f ms/step %7.3f ns/cell %6.2f GB/s (modelled %.0f B/cell)\n", "",
+			1e3*seconds/steps, 1e9*seconds/((double)steps*N*N), bytes*steps/seconds/1e9, bytes/((double)N*N) );
+	}
+
+	free_velocity ( u, v ); free_velocity ( u0, v0 ); free_field ( d ); free_field ( d0 );
+	return 0;
+}
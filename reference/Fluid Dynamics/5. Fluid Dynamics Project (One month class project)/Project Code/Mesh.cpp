@@ -0,0 +1,899 @@
+#include "Mesh.h"
+#include "Profiler.h"
+#include "Renderer.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MESH_SSE
+#endif
+
+// To the nearest, halves away from zero. floorf is a library call on compilers without SSE4.1 rounding
+static inline int roundToInt(float x)
+{
+	return (int)(x < 0.0f ? x - 0.5f : x + 0.5f);
+}
+
+// The colour buildSpan works out: the layers' colour f of the way from below to above, then keep of it with the rest
+// the velocity layer, clamped and packed the way packColor does. below and above are read four floats at a time in
+// SSE, the fourth being the next one's red, so above must not be the last of its array
+static inline unsigned int mixColor(const tColor &below, const tColor &above, float f, const tColor &fast, float keep)
+{
+#ifdef MESH_SSE
+	__m128 low = _mm_loadu_ps(&below.red), to = _mm_setr_ps(fast.red, fast.green, fast.blue, 0.0f);
+	__m128 c = _mm_add_ps(low, _mm_mul_ps(_mm_set1_ps(f), _mm_sub_ps(_mm_loadu_ps(&above.red), low)));
+	c = _mm_add_ps(to, _mm_mul_ps(_mm_sub_ps(c, to), _mm_set1_ps(keep)));
+	c = _mm_min_ps(_mm_max_ps(c, _mm_setzero_ps()), _mm_set1_ps(1.0f));	// NaN to 0, as toByte
+	__m128i bytes = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(c, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+	bytes = _mm_packs_epi32(bytes, bytes);
+	// SSE means x86, so little endian: red is the low byte and alpha the high one
+	return (unsigned int)_mm_cvtsi128_si32(_mm_packus_epi16(bytes, bytes)) | 0xff000000u;
+#else
+	tColor color;
+	color.red	= fast.red		+ (below.red	+ f*(above.red		- below.red)	- fast.red)*keep;
+	color.green	= fast.green	+ (below.green	+ f*(above.green	- below.green)	- fast.green)*keep;
+	color.blue	= fast.blue		+ (below.blue	+ f*(above.blue		- below.blue)	- fast.blue)*keep;
+	return CWaterMesh::packColor(color);
+#endif
+}
+
+CWaterMesh::CWaterMesh(void)
+{
+	m_stream   = NULL;
+	m_heights  = NULL;
+	m_indices  = NULL;
+	m_vertices = m_normals = NULL;
+	m_colorLut = NULL;
+	m_colorSource = NULL;
+	m_count	   = 0;
+	m_n		   = 0;
+
+	m_snapshot	= NULL;
+	m_dirty		= NULL;
+	m_unexpanded = NULL;
+	m_tilesX	= m_tileCount = 0;
+	m_bRebuildAll = true;
+
+	m_tileBounds	= NULL;
+	m_lodLevels		= NULL;
+	m_lodKeys		= NULL;
+	m_lodIndices	= NULL;
+	m_lodIndexCount	= 0;
+	m_chunksX		= 0;
+	m_bLod			= true;
+	m_bLodValid		= false;
+	memset ( &m_stats, 0, sizeof(m_stats) );
+
+	m_bDraw3d	  = true;
+	m_colorShceme = 1;
+
+	// Here come the Mighty Colors
+	m_backgroundColor.red   = 0.3f;
+	m_backgroundColor.green = 0.3f;
+	m_backgroundColor.blue  = 0.3f;
+
+	// Color Scheme 1
+	m_schemes[0].DensityLayers[0].red   = 0.5f;
+	m_schemes[0].DensityLayers[0].green = 0.01f;
+	m_schemes[0].DensityLayers[0].blue  = 0.02f;
+	
+	m_schemes[0].DensityLayers[1].red   = 0.15f;
+	m_schemes[0].DensityLayers[1].green = 0.45f;
+	m_schemes[0].DensityLayers[1].blue  = 0.025f;
+	
+	m_schemes[0].DensityLayers[2].red   = 0.4f;
+	m_schemes[0].DensityLayers[2].green = 0.02f;
+	m_schemes[0].DensityLayers[2].blue  = 0.035f;
+	
+	m_schemes[0].DensityLayers[3].red   = 0.25f;
+	m_schemes[0].DensityLayers[3].green = 0.5f;
+	m_schemes[0].DensityLayers[3].blue  = 0.1f;
+	
+	m_schemes[0].DensityLayers[4].red   = 0.7f;
+	m_schemes[0].DensityLayers[4].green = 0.3f;
+	m_schemes[0].DensityLayers[4].blue  = 0.9f;
+	
+	m_schemes[0].DensityLayers[5].red   = 0.9f;
+	m_schemes[0].DensityLayers[5].green = 0.5f;
+	m_schemes[0].DensityLayers[5].blue  = 0.49f;
+	
+	m_schemes[0].VelocityLayer.red   = 0.4f;
+	m_schemes[0].VelocityLayer.green = 0.65f;
+	m_schemes[0].VelocityLayer.blue  = 0.85f;
+	
+	// Color Scheme 2
+	m_schemes[1].DensityLayers[0].red   = 0.05f;
+	m_schemes[1].DensityLayers[0].green = 0.15f;
+	m_schemes[1].DensityLayers[0].blue  = 0.65f;
+	
+	m_schemes[1].DensityLayers[1].red   = 0.8f;
+	m_schemes[1].DensityLayers[1].green = 0.3f;
+	m_schemes[1].DensityLayers[1].blue  = 0.55f;
+	
+	m_schemes[1].DensityLayers[2].red   = 0.45f;
+	m_schemes[1].DensityLayers[2].green = 0.30f;
+	m_schemes[1].DensityLayers[2].blue  = 0.6f;
+	
+	m_schemes[1].DensityLayers[3].red   = 0.45f;
+	m_schemes[1].DensityLayers[3].green = 0.36f;
+	m_schemes[1].DensityLayers[3].blue  = 0.5f;
+	
+	m_schemes[1].DensityLayers[4].red   = 0.12f;
+	m_schemes[1].DensityLayers[4].green = 0.06f;
+	m_schemes[1].DensityLayers[4].blue  = 0.36f;
+	
+	m_schemes[1].DensityLayers[5].red   = 0.15f;
+	m_schemes[1].DensityLayers[5].green = 0.35f;
+	m_schemes[1].DensityLayers[5].blue  = 0.95f;
+	
+	m_schemes[1].VelocityLayer.red   = 0.4f;
+	m_schemes[1].VelocityLayer.green = 0.65f;
+	m_schemes[1].VelocityLayer.blue  = 0.85f;
+}
+
+CWaterMesh::~CWaterMesh(void)
+{
+	freeMesh();
+}
+
+int CWaterMesh::allocateMesh(int n)
+{
+	freeMesh();
+
+	m_n		   = n;
+	m_count	   = (n+2)*(n+2);
+	m_stream   = (tWaterVertex *) calloc ( m_count, sizeof(*m_stream) );
+	m_heights  = (float *) calloc ( m_count, sizeof(*m_heights) );
+	m_indices  = (int (*)[6]) calloc ( m_count, sizeof(*m_indices) );
+	m_colorLut = (tColor *) malloc ( (COLOR_LUT_DENSITIES + 2)*sizeof(*m_colorLut) );	// One over for mixColor
+
+	m_tilesX	= (n + MESH_TILE)/MESH_TILE;
+	m_tileCount	= m_tilesX*m_tilesX;
+	m_snapshot	= (float *) calloc ( 3*m_count, sizeof(*m_snapshot) );
+	m_dirty		= (unsigned char *) calloc ( m_tileCount, sizeof(*m_dirty) );
+	m_unexpanded = (unsigned char *) calloc ( m_tileCount, sizeof(*m_unexpanded) );
+
+	m_chunksX		= (n + MESH_CHUNK - 1)/MESH_CHUNK;
+	m_tileBounds	= (float (*)[2]) calloc ( m_tileCount, sizeof(*m_tileBounds) );
+	m_lodLevels		= (unsigned char *) calloc ( m_chunksX*m_chunksX, sizeof(*m_lodLevels) );
+	m_lodKeys		= (unsigned short *) calloc ( m_chunksX*m_chunksX, sizeof(*m_lodKeys) );
+	m_lodIndices	= (int *) calloc ( n*n*6, sizeof(*m_lodIndices) );	// Every chunk at level 0
+	m_lodIndexCount	= 0;
+	m_bLodValid		= false;
+
+	if ( !m_stream || !m_heights || !m_indices || !m_colorLut || !m_snapshot || !m_dirty || !m_unexpanded ||
+		 !m_tileBounds || !m_lodLevels || !m_lodKeys || !m_lodIndices ) {
+		freeMesh();
+		return ( 0 );
+	}
+
+	bakeColors();
+	invalidate();
+
+	return ( 1 );
+}
+
+void CWaterMesh::freeMesh(void)
+{
+	free ( m_stream );
+	free ( m_heights );
+	free ( m_indices );
+	free ( m_vertices );
+	free ( m_normals );
+	free ( m_colorLut );
+	free ( m_snapshot );
+	free ( m_dirty );
+	free ( m_unexpanded );
+	free ( m_tileBounds );
+	free ( m_lodLevels );
+	free ( m_lodKeys );
+	free ( m_lodIndices );
+
+	m_stream   = NULL;
+	m_heights  = NULL;
+	m_indices  = NULL;
+	m_vertices = m_normals = NULL;
+	m_colorLut = NULL;
+	m_count	   = 0;
+	m_n		   = 0;
+
+	m_snapshot	= NULL;
+	m_dirty		= NULL;
+	m_unexpanded = NULL;
+	m_tilesX	= m_tileCount = 0;
+
+	m_tileBounds	= NULL;
+	m_lodLevels		= NULL;
+	m_lodKeys		= NULL;
+	m_lodIndices	= NULL;
+	m_lodIndexCount	= 0;
+	m_chunksX		= 0;
+	m_bLodValid		= false;
+	memset ( &m_stats, 0, sizeof(m_stats) );
+}
+
+// Sets m_dirty for tile row ty, row by row over the vertices so the reads stream. A tile stops being read once it
+// has moved
+void CWaterMesh::scanTiles(int ty, const float *dens, const float *u, const float *v, float threshold)
+{
+	int N = m_n;
+	unsigned char *dirty = m_dirty + ty*m_tilesX;
+	const float *lastDens = m_snapshot, *lastU = m_snapshot + m_count, *lastV = m_snapshot + 2*m_count;
+	int j0 = ty*MESH_TILE, j1 = j0 + MESH_TILE - 1 < N ? j0 + MESH_TILE - 1 : N;
+
+	memset ( dirty, 0, m_tilesX );
+	for (int j = j0; j <= j1; j++)
+	{
+		for (int tx = 0; tx < m_tilesX; tx++)
+		{
+			if(dirty[tx])
+				continue;
+			int i0 = tx*MESH_TILE, i1 = i0 + MESH_TILE - 1 < N ? i0 + MESH_TILE - 1 : N;
+			// Or-ing the comparisons rather than taking a maximum, a float maximum is not a reduction the
+			// vectorizer may reorder
+			int moved = 0;
+			for (int i = i0; i <= i1; i++)
+			{
+				int c = IX(i,j), vc = VX(c), m = MX(i,j);
+				moved |= (fabsf(dens[c] - lastDens[m]) > threshold) | (fabsf(u[vc] - lastU[m]) > threshold) |
+						 (fabsf(v[vc] - lastV[m]) > threshold);
+			}
+			dirty[tx] = moved != 0;
+		}
+	}
+}
+
+void CWaterMesh::buildSpan(int j, int i0, int i1, const float *dens, const float *u, const float *v)
+{
+	int N = m_n;
+	const float densityScale = (COLOR_LUT_DENSITIES - 1)/COLOR_LUT_DENSITY_MAX;
+	const unsigned int background = packColor(m_backgroundColor);
+	const tColor *layers = m_colorLut;
+	const tColor fast = m_schemes[m_colorShceme].VelocityLayer;
+	float *snapshot = m_snapshot;
+
+	for (int i = i0; i <= i1; i++) 
+	{
+		int c  = IX(i,j);	// Field cell
+		int vc = VX(c);		// Velocity component
+		int m  = MX(i,j);	// Vertex
+
+		// Calculating the awesome color for each vertex, the density layers out of the scheme's table (see bakeColors)
+		if(m_colorSource)
+			m_stream[m].color = m_colorSource[m];
+		else if(0.0f < dens[c])
+		{
+			float at = dens[c] < COLOR_LUT_DENSITY_MAX ? dens[c]*densityScale : (float)(COLOR_LUT_DENSITIES - 1);
+			int d = (int)at;
+			float f = at - d;
+			const tColor &below = layers[d], &above = layers[d + 1];
+
+			// The two velocity lerps go to the same colour, together they keep this much of the layers'. Past a speed
+			// of 10 they extrapolate, which is why the lerp is not in the table: only the clamp at the end (mixColor,
+			// as GL clamped the float colours) keeps the result a colour
+			float keep = (1.0f - fabsf(u[vc])/10)*(1.0f - fabsf(v[vc])/10);
+			m_stream[m].color = mixColor(below, above, f, fast, keep);
+		}
+		else
+			m_stream[m].color = background;
+
+		// Calculating the height
+		float height;
+		if(!m_bDraw3d)
+			height = 0.0f;
+		else
+		{
+			height = dens[c] - sqrt(u[vc]*u[vc]+v[vc]*v[vc]);
+			if(height > 10.0f) // LIMIT_CUT
+				height = 10.0f + height/20.0f;
+			if(height < -10.0f)
+				height = -10.0f + height/20.0f;
+
+			height *= -1;
+		}
+	
+		// Setting the vertices, x and z never change
+		m_heights[m] = height;
+		float steps = height*WATER_HEIGHT_SCALE;
+		m_stream[m].height = steps > 32767.0f ? 32767 : steps < -32767.0f ? -32767 : (short)roundToInt(steps);
+
+		snapshot[m]				= dens[c];
+		snapshot[m + m_count]	= u[vc];
+		snapshot[m + 2*m_count]	= v[vc];
+	}
+}
+
+void CWaterMesh::build(const float *dens, const float *u, const float *v)
+{
+	PROFILE_ZONE("mesh build");
+	int N = m_n;
+	int t, ty, j;
+
+	// Which tiles moved since they were last built
+	if(m_bRebuildAll)
+		memset ( m_dirty, 1, m_tileCount );
+	else
+	{
+		const float threshold = MESH_DIRTY_SLOPE/N;
+		#pragma omp parallel for
+		for (ty = 0; ty < m_tilesX; ty++)
+			scanTiles(ty, dens, u, v, threshold);
+	}
+	m_bRebuildAll = false;
+
+	int count = 0, vertices = 0;
+	for (t = 0; t < m_tileCount; t++)
+	{
+		if(!m_dirty[t])
+			continue;
+		int col = t % m_tilesX, row = t / m_tilesX;	// The last tile of each is cut short at N
+		vertices += ((col + 1)*MESH_TILE <= N ? MESH_TILE : N + 1 - col*MESH_TILE)*
+					((row + 1)*MESH_TILE <= N ? MESH_TILE : N + 1 - row*MESH_TILE);
+		m_unexpanded[t] = 1;
+		count++;
+	}
+	m_stats.rebuilt = (float)vertices/((N+1)*(N+1));
+	if(!count)
+		return;
+
+	// Heights and colours, a row of a tile row at a time as MX is unit stride in i, each run of dirty tiles in one go
+	#pragma omp parallel for schedule(dynamic)
+	for (ty = 0; ty < m_tilesX; ty++)
+	{
+		const unsigned char *dirty = m_dirty + ty*m_tilesX;
+		int j0 = ty*MESH_TILE, j1 = j0 + MESH_TILE - 1 < N ? j0 + MESH_TILE - 1 : N;
+		for (int tx = 0; tx < m_tilesX; tx++)
+		{
+			if(!dirty[tx])
+				continue;
+			int end = tx;
+			while(end + 1 < m_tilesX && dirty[end + 1])
+				end++;
+			int i0 = tx*MESH_TILE, i1 = (end + 1)*MESH_TILE - 1 < N ? (end + 1)*MESH_TILE - 1 : N;
+			for (int r = j0; r <= j1; r++)
+				buildSpan(r, i0, i1, dens, u, v);
+			for (int k = tx; k <= end; k++)
+				boundTile(ty*m_tilesX + k);
+			tx = end;
+		}
+	}
+
+	if(count == m_tileCount)
+	{
+		buildNormals();
+		return;
+	}
+
+	// The normals of the dirty tiles and the ring around them, which read their heights
+	PROFILE_ZONE("mesh normals");
+	#pragma omp parallel for
+	for (j = 0; j <= N; j++)
+	{
+		int i0, i1;
+		for (int tx = 0; dirtyRun(m_dirty, j, tx, i0, i1); )
+			normalSpan(j, i0, i1);
+	}
+}
+
+// The next run of vertices in row j from tile column tx on that are in, or next to, a tile set in tiles. A row takes
+// the tile rows above and below it into account, and the run of tile columns is widened by one vertex a side
+bool CWaterMesh::dirtyRun(const unsigned char *tiles, int j, int &tx, int &i0, int &i1) const
+{
+	int N = m_n;
+	int ty0 = (j > 0 ? j-1 : 0)/MESH_TILE, ty1 = (j < N ? j+1 : N)/MESH_TILE;
+	int start = -1;
+	for ( ; tx <= m_tilesX; tx++)
+	{
+		bool dirty = false;
+		for (int ty = ty0; tx < m_tilesX && ty <= ty1; ty++)
+			dirty = dirty || tiles[ty*m_tilesX + tx];
+		if(dirty && start < 0)
+			start = tx;
+		else if(!dirty && start >= 0)
+		{
+			i0 = start ? start*MESH_TILE - 1 : 0;
+			i1 = tx*MESH_TILE < N ? tx*MESH_TILE : N;
+			return true;
+		}
+	}
+	return false;
+}
+
+void CWaterMesh::boundTile(int t)
+{
+	int N = m_n;
+	int i0 = (t % m_tilesX)*MESH_TILE, i1 = i0 + MESH_TILE - 1 < N ? i0 + MESH_TILE - 1 : N;
+	int j0 = (t / m_tilesX)*MESH_TILE, j1 = j0 + MESH_TILE - 1 < N ? j0 + MESH_TILE - 1 : N;
+	float lo = m_heights[MX(i0,j0)], hi = lo;
+	for (int j = j0; j <= j1; j++)
+	{
+		for (int i = i0; i <= i1; i++)
+		{
+			float height = m_heights[MX(i,j)];
+			lo = height < lo ? height : lo;
+			hi = height > hi ? height : hi;
+		}
+	}
+	m_tileBounds[t][0] = lo;
+	m_tileBounds[t][1] = hi;
+}
+
+void CWaterMesh::frustumPlanes(const float projection[16], const float modelview[16], float planes[6][4])
+{
+	// The rows of projection times modelview, the planes are the fourth plus and minus each of the others
+	// (Gribb and Hartmann)
+	float clip[4][4];
+	int r, c, k;
+	for (r = 0; r < 4; r++)
+	{
+		for (c = 0; c < 4; c++)
+		{
+			clip[r][c] = 0.0f;
+			for (k = 0; k < 4; k++)
+				clip[r][c] += projection[k*4 + r]*modelview[c*4 + k];
+		}
+	}
+	for (r = 0; r < 3; r++)
+	{
+		for (c = 0; c < 4; c++)
+		{
+			planes[2*r][c]		= clip[3][c] + clip[r][c];
+			planes[2*r + 1][c]	= clip[3][c] - clip[r][c];
+		}
+	}
+}
+
+int CWaterMesh::chunkLevel(int cx, int cy, const float eye[3], float scale, bool &visible, const float planes[6][4]) const
+{
+	int N = m_n;
+	int i0 = cx*MESH_CHUNK, i1 = i0 + MESH_CHUNK < N ? i0 + MESH_CHUNK : N;
+	int j0 = cy*MESH_CHUNK, j1 = j0 + MESH_CHUNK < N ? j0 + MESH_CHUNK : N;
+
+	// The chunk's last row and column of vertices are the first of the next tiles over
+	float lo = m_tileBounds[cy*m_tilesX + cx][0], hi = m_tileBounds[cy*m_tilesX + cx][1];
+	for (int ty = cy; ty <= cy + 1 && ty < m_tilesX; ty++)
+	{
+		for (int tx = cx; tx <= cx + 1 && tx < m_tilesX; tx++)
+		{
+			lo = m_tileBounds[ty*m_tilesX + tx][0] < lo ? m_tileBounds[ty*m_tilesX + tx][0] : lo;
+			hi = m_tileBounds[ty*m_tilesX + tx][1] > hi ? m_tileBounds[ty*m_tilesX + tx][1] : hi;
+		}
+	}
+	// The stream's heights are rounded to a step
+	float box[2][3] = { { (i0 - 0.5f)/N, lo - 1.0f/WATER_HEIGHT_SCALE, (j0 - 0.5f)/N },
+						{ (i1 - 0.5f)/N, hi + 1.0f/WATER_HEIGHT_SCALE, (j1 - 0.5f)/N } };
+
+	// Outside when the corner furthest along a plane's normal is still behind it
+	visible = true;
+	for (int p = 0; p < 6 && visible; p++)
+	{
+		float d = planes[p][3];
+		for (int k = 0; k < 3; k++)
+			d += planes[p][k]*box[planes[p][k] > 0.0f][k];
+		visible = d >= 0.0f;
+	}
+
+	// From the eye to the nearest point of the box, in world units
+	float nearest[3];
+	for (int k = 0; k < 3; k++)
+		nearest[k] = (eye[k] < box[0][k] ? box[0][k] : eye[k] > box[1][k] ? box[1][k] : eye[k]) - eye[k];
+	nearest[0] *= scale;
+	nearest[2] *= scale;
+	float distance = sqrtf(nearest[0]*nearest[0] + nearest[1]*nearest[1] + nearest[2]*nearest[2]);
+
+	// A quad s vertices across is s*scale/N wide, keep it under MESH_LOD_ERROR at this distance. A step also has to
+	// divide the chunk, which only the last chunk in a row or column can be short of
+	float steps = MESH_LOD_ERROR*distance*N/scale;
+	int most = 0, level = 0;
+	while(most + 1 < MESH_LOD_LEVELS && !(((i1 - i0) | (j1 - j0)) & ((2 << most) - 1)))
+		most++;
+	while(level < most && (2 << level) <= steps)
+		level++;
+	return level;
+}
+
+// The key a chunk is indexed from: its level, 8 when drawn, then the step along its low i, high i, low j and high
+// j edges as levels, three bits each. An edge's is the coarser of the two chunks' on it
+#define LOD_KEY_EDGE(key, edge)	(((key) >> (4 + 3*(edge))) & 7)
+
+int CWaterMesh::indexChunk(int cx, int cy, int *out) const
+{
+	int N = m_n;
+	unsigned int key = m_lodKeys[cy*m_chunksX + cx];
+	int step = 1 << (key & 7);
+	int lowI = 1 << LOD_KEY_EDGE(key, 0), highI = 1 << LOD_KEY_EDGE(key, 1);
+	int lowJ = 1 << LOD_KEY_EDGE(key, 2), highJ = 1 << LOD_KEY_EDGE(key, 3);
+	int i0 = cx*MESH_CHUNK, w = N - i0 < MESH_CHUNK ? N - i0 : MESH_CHUNK;
+	int j0 = cy*MESH_CHUNK, h = N - j0 < MESH_CHUNK ? N - j0 : MESH_CHUNK;
+	int count = 0;
+
+	for (int j = 0; j < h; j += step)
+	{
+		for (int i = 0; i < w; i += step)
+		{
+			// The quad's corners in setIndices' order, (i,j) (i,j+1) (i+1,j) (i+1,j+1), an edge vertex moved down
+			// to the nearest one the edge's step has. That only slides it along the edge, so no triangle turns over
+			int corner[4];
+			for (int k = 0; k < 4; k++)
+			{
+				int a = i + (k >> 1)*step, b = j + (k & 1)*step;
+				if(a == 0)
+					b -= b % lowI;
+				else if(a == w)
+					b -= b % highI;
+				if(b == 0)
+					a -= a % lowJ;
+				else if(b == h)
+					a -= a % highJ;
+				corner[k] = MX(i0 + a, j0 + b);
+			}
+
+			// setIndices' two triangles, less any a collapse left with a repeated corner. Where two coarser edges
+			// meet one can be left with three distinct corners in a line, which is kept: it closes the gap between
+			// the heights at them
+			if(corner[0] != corner[1] && corner[0] != corner[2] && corner[1] != corner[2])
+			{
+				out[count++] = corner[0];
+				out[count++] = corner[1];
+				out[count++] = corner[2];
+			}
+			if(corner[1] != corner[3] && corner[1] != corner[2] && corner[3] != corner[2])
+			{
+				out[count++] = corner[1];
+				out[count++] = corner[3];
+				out[count++] = corner[2];
+			}
+		}
+	}
+	return count;
+}
+
+void CWaterMesh::selectLod(const float eye[3], const float planes[6][4], float scale)
+{
+	PROFILE_ZONE("mesh lod");
+	int N = m_n;
+	int chunks = m_chunksX*m_chunksX, c, cy;
+
+	float rebuilt = m_stats.rebuilt;
+	memset ( &m_stats, 0, sizeof(m_stats) );
+	m_stats.rebuilt			= rebuilt;
+	m_stats.chunks			= chunks;
+	m_stats.fullTriangles	= 2LL*N*N;
+	if(!m_bLod)
+	{
+		m_stats.chunksDrawn	= chunks;
+		m_stats.triangles	= m_stats.fullTriangles;
+		m_stats.levels[0]	= chunks;
+		return;
+	}
+
+	#pragma omp parallel for
+	for (cy = 0; cy < m_chunksX; cy++)
+	{
+		for (int cx = 0; cx < m_chunksX; cx++)
+		{
+			bool visible;
+			int level = chunkLevel(cx, cy, eye, scale, visible, planes);
+			m_lodLevels[cy*m_chunksX + cx] = (unsigned char)(level | (visible ? 8 : 0));
+		}
+	}
+
+	// The keys need the neighbours' levels, so only once every level is in
+	bool changed = !m_bLodValid;
+	for (c = 0; c < chunks; c++)
+	{
+		int cx = c % m_chunksX, cy = c / m_chunksX;
+		int level = m_lodLevels[c] & 7;
+		int neighbours[4] = { cx > 0 ? c - 1 : -1, cx + 1 < m_chunksX ? c + 1 : -1,
+							  cy > 0 ? c - m_chunksX : -1, cy + 1 < m_chunksX ? c + m_chunksX : -1 };
+		unsigned int key = m_lodLevels[c];
+		for (int e = 0; e < 4; e++)
+		{
+			int edge = neighbours[e] >= 0 && (m_lodLevels[neighbours[e]] & 7) > level ? m_lodLevels[neighbours[e]] & 7 : level;
+			key |= edge << (4 + 3*e);
+		}
+		changed = changed || key != m_lodKeys[c];
+		m_lodKeys[c] = (unsigned short)key;
+
+		if(key & 8)
+		{
+			m_stats.chunksDrawn++;
+			m_stats.levels[level]++;
+		}
+	}
+
+	if(changed)
+	{
+		m_lodIndexCount = 0;
+		for (c = 0; c < chunks; c++)
+		{
+			if(m_lodKeys[c] & 8)
+				m_lodIndexCount += indexChunk(c % m_chunksX, c / m_chunksX, m_lodIndices + m_lodIndexCount);
+		}
+		m_bLodValid = true;
+	}
+	m_stats.triangles = m_lodIndexCount/3;
+}
+
+void CWaterMesh::selectLod(const CRenderBackend &renderer)
+{
+	float model[16], modelview[16], planes[6][4];
+	CRenderBackend::identity(model);
+	CRenderBackend::scale(model, WATER_SCALE, 1.0f, WATER_SCALE);
+	CRenderBackend::multiply(renderer.getView(), model, modelview);
+	frustumPlanes(renderer.getProjection(), modelview, planes);
+
+	// The frustum from the matrices is in the mesh's frame already, only the eye needs scaling into it
+	const float *origin = renderer.getEye();
+	float eye[3] = { origin[0]/WATER_SCALE, origin[1], origin[2]/WATER_SCALE };
+	selectLod(eye, planes, WATER_SCALE);
+}
+
+// The normal at one vertex, neighbours past the edge clamped to it and the one-sided difference scaled to match
+static inline void edgeNormal(int N, const float *heights, int i, int j, float h, signed char oct[2])
+{
+	int i0 = i > 0 ? i-1 : i, i1 = i < N ? i+1 : i;
+	int j0 = j > 0 ? j-1 : j, j1 = j < N ? j+1 : j;
+	float nx = -(heights[MX(i1,j)] - heights[MX(i0,j)]) * (2.0f/(i1 - i0));
+	float nz = -(heights[MX(i,j1)] - heights[MX(i,j0)]) * (2.0f/(j1 - j0));
+	CWaterMesh::encodeNormal(nx, 2.0f*h, nz, oct);
+}
+
+void CWaterMesh::buildNormals(void)
+{
+	PROFILE_ZONE("mesh normals");
+	int N = m_n;
+	int j;
+
+	#pragma omp parallel for
+	for (j = 0; j <= N; j++) 
+		normalSpan(j, 0, N);
+}
+
+void CWaterMesh::normalSpan(int j, int i0, int i1)
+{
+	int N = m_n;
+	const float *heights = m_heights;
+	tWaterVertex *out = m_stream + MX(0,j);
+	float h = 1.0f/N;
+
+	// The surface is y = height(x, z) with the vertices h apart, so the normal is (-dy/dx, 1, -dy/dz) scaled by 2h:
+	// (height(i-1) - height(i+1), 2h, height(j-1) - height(j+1)). Every height is final by now. The octahedral
+	// encoding divides by |x| + |y| + |z| and needs no square root; y is 2h > 0, so there is no lower half to fold
+	if(j == 0 || j == N || N < 2)
+	{
+		for (int i = i0; i <= i1; i++)
+			edgeNormal(N, heights, i, j, h, out[i].normal);
+		return;
+	}
+
+	const float *row  = heights + MX(0,j);
+	const float *up   = heights + MX(0,j-1);
+	const float *down = heights + MX(0,j+1);
+	int i = i0, last = i1 < N ? i1 : N-1;	// The interior ones
+	if(i == 0)
+	{
+		edgeNormal(N, heights, 0, j, h, out[0].normal);
+		i = 1;
+	}
+
+#ifdef MESH_SSE
+	// Four vertices at a time: rcp refined by one Newton step, rounded to bytes and paired up as x z
+	const __m128 ny   = _mm_set1_ps(2.0f*h);
+	const __m128 two  = _mm_set1_ps(2.0f);
+	const __m128 unit = _mm_set1_ps(127.0f);
+	const __m128 sign = _mm_set1_ps(-0.0f);
+	for ( ; i + 3 <= last; i += 4)
+	{
+		__m128 nx = _mm_sub_ps(_mm_loadu_ps(row + i - 1), _mm_loadu_ps(row + i + 1));
+		__m128 nz = _mm_sub_ps(_mm_loadu_ps(up + i), _mm_loadu_ps(down + i));
+		__m128 length = _mm_add_ps(_mm_add_ps(_mm_andnot_ps(sign, nx), _mm_andnot_ps(sign, nz)), ny);
+		__m128 r = _mm_rcp_ps(length);
+		r = _mm_mul_ps(_mm_mul_ps(r, unit), _mm_sub_ps(two, _mm_mul_ps(length, r)));
+
+		__m128i x = _mm_cvtps_epi32(_mm_mul_ps(nx, r));
+		__m128i z = _mm_cvtps_epi32(_mm_mul_ps(nz, r));
+		__m128i xz = _mm_unpacklo_epi16(_mm_packs_epi32(x, x), _mm_packs_epi32(z, z));	// x0 z0 x1 z1 ...
+		signed char pairs[8];
+		_mm_storel_epi64((__m128i *)pairs, _mm_packs_epi16(xz, xz));					// As bytes
+		for(int k = 0; k < 4; k++)
+			memcpy ( out[i + k].normal, pairs + 2*k, 2 );
+	}
+#endif
+	for ( ; i <= last; i++)
+		encodeNormal(row[i-1] - row[i+1], 2.0f*h, up[i] - down[i], out[i].normal);
+	if(i1 == N)
+		edgeNormal(N, heights, N, j, h, out[N].normal);
+}
+
+void CWaterMesh::encodeNormal(float x, float y, float z, signed char oct[2])
+{
+	// Onto the octahedron |x| + |y| + |z| = 1, the lower half folded over the upper
+	float scale = 1.0f/(fabsf(x) + fabsf(y) + fabsf(z));
+	float ox = x*scale, oz = z*scale;
+	if(y < 0.0f)
+	{
+		float fx = (1.0f - fabsf(oz)) * (ox < 0.0f ? -1.0f : 1.0f);
+		float fz = (1.0f - fabsf(ox)) * (oz < 0.0f ? -1.0f : 1.0f);
+		ox = fx;
+		oz = fz;
+	}
+	oct[0] = (signed char)roundToInt(ox*127.0f);
+	oct[1] = (signed char)roundToInt(oz*127.0f);
+}
+
+void CWaterMesh::decodeNormal(const signed char oct[2], float normal[3])
+{
+	float x = oct[0]*(1.0f/127.0f), z = oct[1]*(1.0f/127.0f);
+	float y = 1.0f - fabsf(x) - fabsf(z);
+	if(y < 0.0f)
+	{
+		float fx = (1.0f - fabsf(z)) * (x < 0.0f ? -1.0f : 1.0f);
+		float fz = (1.0f - fabsf(x)) * (z < 0.0f ? -1.0f : 1.0f);
+		x = fx;
+		z = fz;
+	}
+	float scale = 1.0f/sqrtf(x*x + y*y + z*z);
+	normal[0] = x*scale;
+	normal[1] = y*scale;
+	normal[2] = z*scale;
+}
+
+void CWaterMesh::getPosition(int i, int j, float position[3]) const
+{
+	int N = m_n;
+	position[0] = (i - 0.5f)/N;
+	position[1] = decodeHeight(m_stream[MX(i,j)].height);
+	position[2] = (j - 0.5f)/N;
+}
+
+int CWaterMesh::expand(void)
+{
+	PROFILE_ZONE("mesh expand");
+	int N = m_n;
+	int i, j;
+	if(!m_vertices)
+	{
+		// x and z once, only y changes after this
+		m_vertices = (float (*)[3]) calloc ( m_count, sizeof(*m_vertices) );
+		m_normals  = (float (*)[3]) calloc ( m_count, sizeof(*m_normals) );
+		if ( !m_vertices || !m_normals ) {
+			free ( m_vertices );
+			free ( m_normals );
+			m_vertices = m_normals = NULL;
+			return ( 0 );
+		}
+		for (j = 0; j <= N; j++)
+			for (i = 0; i <= N; i++)
+				getPosition(i, j, m_vertices[MX(i,j)]);
+		memset ( m_unexpanded, 1, m_tileCount );
+	}
+
+	// The tiles built since last time and the normal ring around them
+	#pragma omp parallel for private(i)
+	for (j = 0; j <= N; j++)
+	{
+		int i0, i1;
+		for (int tx = 0; dirtyRun(m_unexpanded, j, tx, i0, i1); )
+		{
+			for (i = i0; i <= i1; i++)
+			{
+				int m = MX(i,j);
+				m_vertices[m][1] = decodeHeight(m_stream[m].height);
+				decodeNormal(m_stream[m].normal, m_normals[m]);
+			}
+		}
+	}
+	memset ( m_unexpanded, 0, m_tileCount );
+	return ( 1 );
+}
+
+void CWaterMesh::render(CRenderBackend &renderer)
+{
+	if(!m_vertices)
+		return;
+
+	tRenderMesh mesh;
+	mesh.vertices		= getVertices();
+	mesh.normals		= getNormals();
+	mesh.colors			= getColors();
+	mesh.colorStride	= sizeof(tWaterVertex);
+	mesh.color			= 0;
+	mesh.indices		= getDrawIndices();
+	mesh.vertexCount	= m_count;
+	mesh.indexCount		= getDrawIndexCount();
+
+	float model[16];
+	CRenderBackend::identity(model);
+	CRenderBackend::scale(model, WATER_SCALE, 1.0f, WATER_SCALE);
+	renderer.draw(mesh, model);
+}
+
+void CWaterMesh::setIndices(void)
+{
+	int N = m_n;
+	int i, j;
+	for (i = 0; i < N; i++) 
+	{
+		for (j = 0; j < N; j++) 
+		{
+			// Triangle One
+			// ------------
+			// Left Up
+			m_indices[MX(i,j)][0] = MX(i,j);
+			// Right up
+			m_indices[MX(i,j)][1] = MX(i,j+1);
+			// Left down
+			m_indices[MX(i,j)][2] = MX(i+1,j);
+
+			// Triangle Two
+			// ------------
+			// Right up
+			m_indices[MX(i,j)][3] = MX(i,j+1);
+			// Right down
+			m_indices[MX(i,j)][4] = MX(i+1,j+1);
+			// Left down
+			m_indices[MX(i,j)][5] = MX(i+1,j);
+		}
+	}
+}
+
+tColor CWaterMesh::colorLerp(tColor start, tColor end, float range)
+{
+	//	C1 + s * (C2 - C1)
+	tColor result;
+	result.red   = start.red   + range * (end.red   - start.red);
+	result.green = start.green + range * (end.green - start.green);
+	result.blue  = start.blue  + range * (end.blue  - start.blue);
+	return result;
+}
+
+void CWaterMesh::changeColorScheme(void)
+{
+	m_colorShceme++;
+	if(m_colorShceme >= NUM_COLOR_SCHEMES)
+		m_colorShceme = 0;
+	bakeColors();
+	invalidate();
+}
+
+// 0 to 1 as 0 to 255, clamped the way GL clamps float colours
+static unsigned char toByte(float channel)
+{
+	if(!(channel > 0.0f))
+		return 0;
+	if(channel >= 1.0f)
+		return 255;
+	return (unsigned char)(channel*255.0f + 0.5f);
+}
+
+unsigned int CWaterMesh::packColor(tColor color)
+{
+	// Bytes in R G B A order whatever the machine's byte order, as GL_UNSIGNED_BYTE reads them
+	unsigned char rgba[4] = { toByte(color.red), toByte(color.green), toByte(color.blue), 255 };
+	unsigned int packed;
+	memcpy ( &packed, rgba, sizeof(packed) );
+	return packed;
+}
+
+void CWaterMesh::bakeColors(void)
+{
+	if(!m_colorLut)
+		return;
+
+	// The first half of the colour build used to work out per vertex: the six density layers lerped in by the
+	// density, at every step and one past the last for buildSpan's lerp between steps. Not clamped, the velocity
+	// lerps after them can bring a channel back into range
+	const tColorScheme &scheme = m_schemes[m_colorShceme];
+	for(int d = 0; d <= COLOR_LUT_DENSITIES; d++)
+	{
+		float density = d*(COLOR_LUT_DENSITY_MAX/(COLOR_LUT_DENSITIES - 1));
+		tColor layers = m_backgroundColor;
+		for(int k = 0; k < 6; k++)
+			layers = colorLerp(layers, scheme.DensityLayers[k], density);
+		m_colorLut[d] = layers;
+	}
+	m_colorLut[COLOR_LUT_DENSITIES + 1] = m_colorLut[COLOR_LUT_DENSITIES];	// mixColor reads its red
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+#include "Def.h"	    // definitions
+
+extern int N;
+
+class CRenderBackend;
+
+// The colour table, the density layers at each density step, 6KB. Past density 3 every scheme has clamped to its last
+// colours
+#define COLOR_LUT_DENSITIES		512
+#define COLOR_LUT_DENSITY_MAX	3.0f
+
+#define WATER_HEIGHT_SCALE		512.0f	// tWaterVertex height steps per unit, heights to +-64 fit
+
+#define MESH_TILE				32		// Vertices a side of the tiles build() tracks
+#define MESH_DIRTY_SLOPE		0.025f	// A tile whose density and velocity all moved less than this over N is kept,
+										// which tilts a kept normal by under 3 degrees
+
+#define MESH_CHUNK				MESH_TILE	// Quads a side of a LOD chunk, so a chunk's heights are bounded by its tiles'
+#define MESH_LOD_LEVELS			6		// Vertex steps 1 to 32
+#define MESH_LOD_ERROR			0.004f	// Widest angle at the eye, in radians, a chunk's quads may span, 4 pixels or so
+
+// One vertex of the mesh as it is rebuilt every frame, 8 bytes. x and z are not stored: vertex MX(i,j) sits at
+// ((i - 0.5)/N, (j - 0.5)/N) for good (getPosition)
+struct tWaterVertex
+{
+	short			height;		// Times WATER_HEIGHT_SCALE
+	signed char		normal[2];	// Octahedral x and z over 127, the y axis is up (decodeNormal)
+	unsigned int	color;		// RGBA8, the bytes in that order
+};
+
+// What the last build and selectLod did
+struct tMeshStats
+{
+	float		rebuilt;		// Fraction of the vertices the last build redid
+	int			chunks;
+	int			chunksDrawn;	// The ones inside the frustum
+	long long	triangles;		// In the index list being drawn
+	long long	fullTriangles;	// 2N^2, every quad at full detail
+	int			levels[MESH_LOD_LEVELS];	// Chunks drawn at each level
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Class:	CWaterMesh
+//
+// Purpose: The water surface the demo draws: one vertex per cell, (N+2)*(N+2) of them indexed with MX, with a height
+//			from the density and speed, a colour from the current scheme and a normal from central differences of
+//			the finished heights (buildNormals, a separate SSE pass over the rows). The colour's density layers are
+//			looked up in a table baked from the scheme whenever it changes and the velocity layer lerped in per
+//			vertex, or the colour is taken from setColorSource's array when one is set. All three go into one
+//			interleaved tWaterVertex stream, 8 bytes a vertex, which is everything that changes from frame to frame.
+//			No GL in here, so the mesh build can be timed and run away from the window.
+//
+//			The mesh's N is the one allocateMesh was given, which may be coarser or finer than the sim's; the fields
+//			build() reads are then the sim's resampled to it (CFieldResampler). N and MX in here are the mesh's,
+//			each function shadows the global N with it as CBatchSolver does.
+//
+//			Most of the water is still from one frame to the next, so build() only redoes the MESH_TILE square tiles
+//			where a density or velocity has moved by more than MESH_DIRTY_SLOPE/N since the tile was last built (kept
+//			in a snapshot; scaled by the spacing as a normal is the height difference over it), and the normals of
+//			those tiles and the one vertex ring around them. getRebuilt() says how much of the mesh the last build
+//			redid, and expand() only decodes what the builds since it redid. Anything that changes every vertex
+//			calls invalidate().
+//
+//			selectLod() picks the triangles to draw, geomipmapping style: the quads are grouped in MESH_CHUNK square
+//			chunks, each drawn every 2^level vertices with the level from its distance to the eye, and chunks wholly
+//			outside the view frustum are left out. Where a chunk meets a coarser neighbour its edge vertices are
+//			collapsed onto the neighbour's, so the shared edge is the same line on both sides with no cracks and no
+//			extra vertices; the triangles that collapse to nothing are dropped. The index list is only rewritten
+//			when a chunk's level, a neighbour's or whether it is drawn changes.
+//
+//			Fixed function GL has no vertex program to decode the stream with, so expand() writes the float
+//			positions and normals glVertexPointer and glNormalPointer want; the colours are drawn from the stream
+//			as they are, with its stride. render() hands all three to a CRenderBackend.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class CWaterMesh
+{
+
+private:
+
+	// Rendering arrays
+	tWaterVertex *m_stream;
+	float *m_heights;		// The heights at full precision, for the normal pass to read four at a time
+	int	  (*m_indices)[6];
+	float (*m_vertices)[3];	// expand()'s, NULL until it is first called
+	float (*m_normals)[3];
+	tColor *m_colorLut;		// The density layers lerped in, COLOR_LUT_DENSITIES steps and one past, unclamped
+	const unsigned int *m_colorSource;	// Packed colours per vertex in place of the scheme's, when set
+	int	  m_count;			// Vertices, (m_n+2)*(m_n+2)
+	int	  m_n;				// The mesh's own N, which need not be the sim's
+
+	// Dirty tiles
+	float *m_snapshot;		// Density, u and v at each vertex when its tile was last built, planes of m_count
+	unsigned char *m_dirty;	// Per tile, row by row, set by the last build
+	unsigned char *m_unexpanded;	// Per tile, built since the last expand()
+	int	  m_tilesX;			// Tiles a side, covering vertices 0 to N
+	int	  m_tileCount;
+	bool  m_bRebuildAll;
+
+	// Level of detail
+	float (*m_tileBounds)[2];	// Lowest and highest height in each tile
+	unsigned char *m_lodLevels;	// Each chunk's level this frame, plus 8 when it is drawn
+	unsigned short *m_lodKeys;	// Each chunk's level, its neighbours' and whether it is drawn, as last indexed
+	int	  *m_lodIndices;		// The drawn chunks' triangles, room for all of them at level 0
+	int	  m_lodIndexCount;
+	int	  m_chunksX;			// Chunks a side
+	bool  m_bLod;
+	bool  m_bLodValid;			// m_lodIndices matches m_lodKeys
+
+	tMeshStats m_stats;
+
+	bool  m_bDraw3d;
+
+	// Color Schemes
+	tColorScheme m_schemes[NUM_COLOR_SCHEMES];
+	tColor		 m_backgroundColor;
+	int m_colorShceme;
+
+	void bakeColors(void);	// The current scheme into m_colorLut
+	void scanTiles(int ty, const float *dens, const float *u, const float *v, float threshold);
+	bool dirtyRun(const unsigned char *tiles, int j, int &tx, int &i0, int &i1) const;
+	void buildSpan(int j, int i0, int i1, const float *dens, const float *u, const float *v);
+	void normalSpan(int j, int i0, int i1);
+	void boundTile(int t);
+	int  chunkLevel(int cx, int cy, const float eye[3], float scale, bool &visible, const float planes[6][4]) const;
+	int  indexChunk(int cx, int cy, int *out) const;
+
+	CWaterMesh(const CWaterMesh&);
+	CWaterMesh&operator = (const CWaterMesh&);
+
+public:
+
+	CWaterMesh(void);
+	~CWaterMesh(void);
+
+	int  allocateMesh(int n);
+	void freeMesh(void);
+	void setIndices(void);
+
+	// Rebuilds the tiles that changed from the fields, IX/VIX indexed as CFluidSim holds them but at getSize(). When
+	// that is not the sim's N they come from a CFieldResampler
+	void build(const float *dens, const float *u, const float *v);
+	// Every normal from the heights build wrote, build ends with it when every tile was redone
+	void buildNormals(void);
+	void invalidate(void)		{ m_bRebuildAll = true; }	// The next build redoes every tile
+	float getRebuilt(void) const	{ return m_stats.rebuilt; }
+
+	// The chunks' levels and the index list to draw. eye and planes (a x + b y + c z + d >= 0 inside, as
+	// frustumPlanes gives them) are in the mesh's frame, whose x and z are scaled by scale to the world's
+	void selectLod(const float eye[3], const float planes[6][4], float scale);
+	// The same for the renderer's camera, with the surface drawn WATER_SCALE wide as render() draws it
+	void selectLod(const CRenderBackend &renderer);
+	void toggleLod(void)		{ m_bLod = !m_bLod; m_bLodValid = false; }
+	// The six planes of the frustum of a GL projection and modelview (column major), in the modelview's frame
+	static void frustumPlanes(const float projection[16], const float modelview[16], float planes[6][4]);
+	const tMeshStats &getStats(void) const	{ return m_stats; }
+	// The stream's heights and normals as float arrays for fixed function GL, 0 when out of memory
+	int  expand(void);
+	// Draws what selectLod picked from expand()'s arrays, x and z scaled by WATER_SCALE
+	void render(CRenderBackend &renderer);
+
+	static tColor colorLerp(tColor start, tColor end, float range);
+	static unsigned int packColor(tColor color);
+	static void encodeNormal(float x, float y, float z, signed char oct[2]);
+	static void decodeNormal(const signed char oct[2], float normal[3]);
+	static float decodeHeight(short height)	{ return height*(1.0f/WATER_HEIGHT_SCALE); }
+	void changeColorScheme(void);
+	// Colours to take as they are instead of the scheme's, MX indexed and read by every build until set back to
+	// NULL. Setting it rebuilds the whole mesh, so a source that changes has to be set again each frame
+	void setColorSource(const unsigned int *colors)	{ m_colorSource = colors; invalidate(); }
+	void toggle3d(void)			{ m_bDraw3d = !m_bDraw3d; invalidate(); }
+
+	const tWaterVertex *getStream(void)	{ return m_stream; }
+	void getPosition(int i, int j, float position[3]) const;
+
+	// After expand(). The colours are 4 GL_UNSIGNED_BYTE each, sizeof(tWaterVertex) apart
+	const float *getVertices(void)	{ return m_vertices ? &m_vertices[0][0] : 0; }
+	const float *getNormals(void)	{ return m_normals ? &m_normals[0][0] : 0; }
+	const unsigned char *getColors(void)	{ return (const unsigned char *)&m_stream[0].color; }
+	const int	*getIndices(void)	{ return &m_indices[0][0]; }
+	int getVertexCount(void)		{ return m_count; }
+	int getSize(void) const			{ return m_n; }		// Cells a side, as allocateMesh was given
+	int getIndexCount(void)			{ return m_count*6; }
+	// After selectLod, the full mesh's when the LOD is off
+	const int	*getDrawIndices(void)	{ return m_bLod ? m_lodIndices : getIndices(); }
+	int getDrawIndexCount(void)		{ return m_bLod ? m_lodIndexCount : getIndexCount(); }
+};
@@ -0,0 +1,97 @@
+#include "PerfCounters.h"
+
+#ifdef __linux__
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#define CACHE_EVENT(cache, op, result) ((cache) | ((op) << 8) | ((result) << 16))
+
+static int openEvent(unsigned int type, unsigned long long config)
+{
+	perf_event_attr attr;
+	memset ( &attr, 0, sizeof(attr) );
+	attr.size			= sizeof(attr);
+	attr.type			= type;
+	attr.config			= config;
+	attr.inherit		= 1;	// Count the OpenMP workers too
+	attr.exclude_kernel	= 1;	// Allowed at perf_event_paranoid 2, and the solver never enters the kernel
+	attr.exclude_hv		= 1;
+	attr.read_format	= PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+	// This thread, any cpu, no group
+	return (int)syscall ( SYS_perf_event_open, &attr, 0, -1, -1, 0 );
+}
+#endif
+
+CPerfCounters::CPerfCounters(void)
+{
+	for(int e = 0; e < totalPerfEventCount; e++)
+		m_fd[e] = -1;
+}
+
+CPerfCounters::~CPerfCounters(void)
+{
+	close();
+}
+
+int CPerfCounters::open(void)
+{
+	close();
+	int opened = 0;
+#ifdef __linux__
+	m_fd[ePerfCycles]		= openEvent ( PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES );
+	m_fd[ePerfInstructions]	= openEvent ( PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS );
+	m_fd[ePerfLLCMisses]	= openEvent ( PERF_TYPE_HW_CACHE, CACHE_EVENT(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ,
+																		  PERF_COUNT_HW_CACHE_RESULT_MISS) );
+	if(m_fd[ePerfLLCMisses] < 0)
+		// Not every PMU exposes the last level cache by name, the generic event is the LLC on x86
+		m_fd[ePerfLLCMisses] = openEvent ( PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES );
+	m_fd[ePerfDTLBMisses]	= openEvent ( PERF_TYPE_HW_CACHE, CACHE_EVENT(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ,
+																		  PERF_COUNT_HW_CACHE_RESULT_MISS) );
+	m_fd[ePerfTaskClock]	= openEvent ( PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK );
+
+	for(int e = 0; e < totalPerfEventCount; e++)
+		opened += m_fd[e] >= 0;
+#endif
+	return opened;
+}
+
+void CPerfCounters::close(void)
+{
+	for(int e = 0; e < totalPerfEventCount; e++)
+	{
+#ifdef __linux__
+		if(m_fd[e] >= 0)
+			::close ( m_fd[e] );
+#endif
+		m_fd[e] = -1;
+	}
+}
+
+void CPerfCounters::sample(tPerfSample &sample) const
+{
+	for(int e = 0; e < totalPerfEventCount; e++)
+	{
+		sample.count[e] = -1;
+#ifdef __linux__
+		// value, time enabled, time running
+		unsigned long long value[3];
+		if(m_fd[e] < 0 || read ( m_fd[e], value, sizeof(value) ) != sizeof(value))
+			continue;
+
+		// Scale up when the PMU had more events than registers and multiplexed them
+		if(value[2] && value[2] < value[1])
+			sample.count[e] = (long long)((double)value[0] * value[1] / value[2]);
+		else
+			sample.count[e] = (long long)value[0];
+#endif
+	}
+}
+
+const char *CPerfCounters::eventName(int event)
+{
+	static const char *names[totalPerfEventCount] = { "cycles", "instructions", "llc_misses", "dtlb_misses", "task_clock" };
+	return names[event];
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Class:	"CPerfCounters"
+//
+// Purpose: Hardware event counts (cycles, instructions, last level cache and dTLB misses) plus the task clock, read
+//			through Linux perf_event_open. Each event is opened on its own, so a machine that lacks some of them (a VM
+//			with no PMU, a high perf_event_paranoid) still gets the rest. Anything that could not be opened reads as -1,
+//			and away from Linux nothing opens at all.
+//
+// Usage:	open() before the first OpenMP parallel region, the counters are inherited by threads started after that
+//			and their counts are added in. Call sample() before and after the code being measured and subtract.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+enum ePerfEvent{ePerfCycles = 0, ePerfInstructions, ePerfLLCMisses, ePerfDTLBMisses, ePerfTaskClock, totalPerfEventCount};
+
+struct tPerfSample
+{
+	long long count[totalPerfEventCount];	// -1 where the event is not counted, the task clock is in nanoseconds
+
+	// this - start, keeping -1 for events that are not counted
+	tPerfSample since(const tPerfSample &start) const
+	{
+		tPerfSample delta;
+		for(int e = 0; e < totalPerfEventCount; e++)
+			delta.count[e] = count[e] < 0 || start.count[e] < 0 ? -1 : count[e] - start.count[e];
+		return delta;
+	}
+};
+
+class CPerfCounters
+{
+
+private:
+
+	int m_fd[totalPerfEventCount];
+
+public:
+
+	CPerfCounters(void);
+	~CPerfCounters(void);
+
+	// Returns how many events opened
+	int open(void);
+	void close(void);
+
+	bool isOpen(int event) const { return m_fd[event] >= 0; }
+	void sample(tPerfSample &sample) const;
+
+	static const char *eventName(int event);
+};
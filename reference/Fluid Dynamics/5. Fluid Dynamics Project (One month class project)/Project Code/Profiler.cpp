@@ -0,0 +1,158 @@
+#include "Profiler.h"
+
+#if PROFILER
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#define PROFILE_TLS __declspec(thread)
+#else
+#include <time.h>
+#define PROFILE_TLS __thread
+#endif
+
+struct tProfileEvent
+{
+	const char *name;
+	long long	start;
+	long long	end;
+};
+
+// One per recording thread, only that thread writes to it
+struct tProfileThread
+{
+	tProfileEvent	events[PROFILE_RING_SIZE];
+	unsigned int	count;		// Recorded since the last reset, the ring holds the newest PROFILE_RING_SIZE
+	int				id;
+	char			name[32];
+};
+
+static tProfileThread *volatile s_threads[PROFILE_MAX_THREADS];
+static volatile long s_threadCount = 0;
+static long long	 s_origin = profileTicks();
+
+static PROFILE_TLS tProfileThread *t_thread = 0;
+static PROFILE_TLS bool t_refused = false;	// No slot or no memory for this thread, it does not ask again
+
+// The next free slot, or -1 when they are all taken. The count never goes past PROFILE_MAX_THREADS
+static long claimSlot(void)
+{
+	for(;;)
+	{
+		long count = s_threadCount;
+		if(count >= PROFILE_MAX_THREADS)
+			return -1;
+#ifdef _WIN32
+		if(InterlockedCompareExchange(&s_threadCount, count + 1, count) == count)
+#else
+		if(__sync_bool_compare_and_swap(&s_threadCount, count, count + 1))
+#endif
+			return count;
+	}
+}
+
+static tProfileThread *thisThread(void)
+{
+	if(!t_thread && !t_refused)
+	{
+		// The memory first, so a failed calloc does not take a slot
+		tProfileThread *thread = (tProfileThread *) calloc ( 1, sizeof(tProfileThread) );
+		long slot = thread ? claimSlot() : -1;
+		if(slot < 0)
+		{
+			free ( thread );
+			t_refused = true;
+			return 0;
+		}
+		thread->id = (int)slot;
+		sprintf ( thread->name, "thread %ld", slot );
+		s_threads[slot] = thread;
+		t_thread = thread;
+	}
+	return t_thread;
+}
+
+long long profileTicks(void)
+{
+#ifdef _WIN32
+	static LARGE_INTEGER frequency;
+	LARGE_INTEGER now;
+	if(!frequency.QuadPart)
+		QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&now);
+	return (long long)((double)now.QuadPart * 1e9 / (double)frequency.QuadPart);
+#else
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (long long)now.tv_sec*1000000000LL + now.tv_nsec;
+#endif
+}
+
+void profileRecord(const char *name, long long start, long long end)
+{
+	tProfileThread *thread = thisThread();
+	if(!thread)
+		return;
+
+	tProfileEvent &event = thread->events[thread->count & (PROFILE_RING_SIZE-1)];
+	event.name	= name;
+	event.start	= start;
+	event.end	= end;
+	thread->count++;
+}
+
+void profileSetThreadName(const char *name)
+{
+	tProfileThread *thread = thisThread();
+	if(!thread)
+		return;
+
+	strncpy ( thread->name, name, sizeof(thread->name)-1 );
+	thread->name[sizeof(thread->name)-1] = 0;
+}
+
+int profileExportChromeTrace(const char *path)
+{
+	FILE *file = fopen ( path, "w" );
+	if(!file)
+		return 0;
+
+	int threads = s_threadCount < PROFILE_MAX_THREADS ? (int)s_threadCount : PROFILE_MAX_THREADS;
+	bool first = true;
+
+	fprintf ( file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" );
+	for(int t = 0; t < threads; t++)
+	{
+		tProfileThread *thread = s_threads[t];
+		if(!thread)
+			continue;
+
+		fprintf ( file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+			first ? "" : ",", thread->id, thread->name );
+		first = false;
+
+		unsigned int begin = thread->count > PROFILE_RING_SIZE ? thread->count - PROFILE_RING_SIZE : 0;
+		for(unsigned int k = begin; k < thread->count; k++)
+		{
+			const tProfileEvent &event = thread->events[k & (PROFILE_RING_SIZE-1)];
+			fprintf ( file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+				event.name, thread->id, (event.start - s_origin)*1e-3, (event.end - event.start)*1e-3 );
+		}
+	}
+	fprintf ( file, "\n]}\n" );
+
+	return fclose ( file ) == 0;
+}
+
+void profileReset(void)
+{
+	int threads = s_threadCount < PROFILE_MAX_THREADS ? (int)s_threadCount : PROFILE_MAX_THREADS;
+	for(int t = 0; t < threads; t++)
+		if(s_threads[t])
+			s_threads[t]->count = 0;
+	s_origin = profileTicks();
+}
+
+#endif
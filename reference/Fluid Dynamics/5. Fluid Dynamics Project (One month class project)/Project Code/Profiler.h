@@ -0,0 +1,58 @@
+#pragma once
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	"Profiler.h"
+//
+// Purpose: Scoped-zone profiler. PROFILE_ZONE("name") times the rest of the enclosing block and records it in a ring
+//			buffer owned by the calling thread, so recording takes no lock. PROFILE_EXPORT(path) writes every thread's
+//			ring as a Chrome trace (chrome://tracing or ui.perfetto.dev) with one timeline per thread.
+//
+// Usage:	Build with PROFILER=1 to record. Left at 0 every macro expands to nothing and none of this is compiled in.
+//			Export and reset between frames, while no zone is being recorded on another thread.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef PROFILER
+#define PROFILER 0
+#endif
+
+#if PROFILER
+
+#define PROFILE_RING_SIZE	(1<<16)	// Zones kept per thread, the oldest are overwritten
+#define PROFILE_MAX_THREADS	64		// Threads past this are not recorded
+
+long long profileTicks(void);		// Nanoseconds, monotonic
+void profileRecord(const char *name, long long start, long long end);
+void profileSetThreadName(const char *name);
+int  profileExportChromeTrace(const char *path);
+void profileReset(void);
+
+class CProfileZone
+{
+
+private:
+
+	const char *m_name;
+	long long	m_start;
+
+public:
+
+	CProfileZone(const char *name) : m_name(name), m_start(profileTicks()) {}
+	~CProfileZone(void) { profileRecord(m_name, m_start, profileTicks()); }
+};
+
+#define PROFILE_JOIN2(a,b) a##b
+#define PROFILE_JOIN(a,b) PROFILE_JOIN2(a,b)
+
+#define PROFILE_ZONE(name)			CProfileZone PROFILE_JOIN(profileZone_,__LINE__)(name)
+#define PROFILE_THREAD_NAME(name)	profileSetThreadName(name)
+#define PROFILE_EXPORT(path)		profileExportChromeTrace(path)
+#define PROFILE_RESET()				profileReset()
+
+#else
+
+#define PROFILE_ZONE(name)
+#define PROFILE_THREAD_NAME(name)
+#define PROFILE_EXPORT(path)		0
+#define PROFILE_RESET()
+
+#endif
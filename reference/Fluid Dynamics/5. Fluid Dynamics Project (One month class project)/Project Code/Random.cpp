@@ -0,0 +1,85 @@
+#include "Random.h"
+#include "Def.h"
+
+#define PHILOX_M0	0xD2511F53u
+#define PHILOX_M1	0xCD9E8D57u
+#define PHILOX_W0	0x9E3779B9u		// Key schedule, the golden ratio
+#define PHILOX_W1	0xBB67AE85u		// and sqrt(3)-1
+#define RANDOM_KEY	0x4C554D45u		// The second key word, "LUME"
+
+// One Philox round on the counter in c0..c3, then the key moves on. The 32x32 products are written as 64 bit ones,
+// which every compiler has and SSE2 and up vectorize
+#define PHILOX_ROUND(c0, c1, c2, c3, k0, k1) \
+	{ \
+		unsigned long long p0 = (unsigned long long)PHILOX_M0 * c0; \
+		unsigned long long p1 = (unsigned long long)PHILOX_M1 * c2; \
+		unsigned int n0 = (unsigned int)(p1 >> 32) ^ c1 ^ k0; \
+		unsigned int n2 = (unsigned int)(p0 >> 32) ^ c3 ^ k1; \
+		c1 = (unsigned int)p1; \
+		c3 = (unsigned int)p0; \
+		c0 = n0; \
+		c2 = n2; \
+		k0 += PHILOX_W0; \
+		k1 += PHILOX_W1; \
+	}
+
+// Blocks first to first+blocks-1, four draws each, with no dependence between blocks for the vectorizer to trip on
+static void philoxBlocks(long long first, unsigned int key0, unsigned int key1, unsigned int * RESTRICT out, int blocks)
+{
+	for(int b = 0; b < blocks; b++)
+	{
+		unsigned long long block = (unsigned long long)(first + b);
+		unsigned int c0 = (unsigned int)block, c1 = (unsigned int)(block >> 32), c2 = 0, c3 = 0;
+		unsigned int k0 = key0, k1 = key1;
+		PHILOX_ROUND(c0, c1, c2, c3, k0, k1);
+		PHILOX_ROUND(c0, c1, c2, c3, k0, k1);
+		PHILOX_ROUND(c0, c1, c2, c3, k0, k1);
+		PHILOX_ROUND(c0, c1, c2, c3, k0, k1);
+		PHILOX_ROUND(c0, c1, c2, c3, k0, k1);
+		PHILOX_ROUND(c0, c1, c2, c3, k0, k1);
+		PHILOX_ROUND(c0, c1, c2, c3, k0, k1);
+		PHILOX_ROUND(c0, c1, c2, c3, k0, k1);
+		PHILOX_ROUND(c0, c1, c2, c3, k0, k1);
+		PHILOX_ROUND(c0, c1, c2, c3, k0, k1);
+		out[4*b + 0] = c0;
+		out[4*b + 1] = c1;
+		out[4*b + 2] = c2;
+		out[4*b + 3] = c3;
+	}
+}
+
+void CRandom::philox(long long block, const unsigned int key[2], unsigned int out[4])
+{
+	philoxBlocks(block, key[0], key[1], out, 1);
+}
+
+void CRandom::seed(unsigned int value)
+{
+	m_key[0]		= value;
+	m_key[1]		= RANDOM_KEY;
+	m_counter		= 0;
+	m_blockIndex	= -1;
+}
+
+unsigned int CRandom::at(long long index) const
+{
+	unsigned int block[4];
+	philox(index >> 2, m_key, block);
+	return block[index & 3];
+}
+
+void CRandom::fill(long long first, unsigned int *out, int count) const
+{
+	// Up to the first whole block one at a time, then whole blocks straight into out, then the rest
+	int done = 0;
+	while(done < count && ((first + done) & 3))
+	{
+		out[done] = at(first + done);
+		done++;
+	}
+	int blocks = (count - done) >> 2;
+	philoxBlocks((first + done) >> 2, m_key[0], m_key[1], out + done, blocks);
+	done += 4*blocks;
+	for( ; done < count; done++)
+		out[done] = at(first + done);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Class:	"CRandom"
+//
+// Purpose: Counter-based random numbers (Philox4x32-10, Salmon et al. 2011) in place of rand(). Draw k after seeding is
+//			a pure function of the seed and k, four to a Philox block, so there is no hidden state: a sim owns its own
+//			generator, a checkpoint saves where it is with one counter, and any draw can be computed on any thread.
+//
+//			A parallel kernel reserve()s a range of draws for the cells it touches and reads them with at(first + cell)
+//			or fill(), so what each cell gets depends only on where the range started, never on the thread count or
+//			the order the threads ran in. fill() computes whole blocks in a loop the compiler vectorizes.
+//
+// Usage:	seed(s), then next() and below(n) where rand() and rand() % n were. In a loop over cells:
+//			first = reserve(cells), then below(at(first + cell), n) inside it.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define RANDOM_BATCH	256		// Draws fill() is asked for at a time by the forcing, on the stack
+
+class CRandom
+{
+
+private:
+
+	unsigned int	m_key[2];		// The seed, and a constant so seed 0 is not a zero key
+	long long		m_counter;		// Draws handed out, the next is at(m_counter)
+	unsigned int	m_block[4];		// The block m_counter is in
+	long long		m_blockIndex;	// Of m_block, -1 for none
+
+public:
+
+	CRandom(void)	{ seed(1); }
+
+	void seed(unsigned int value);
+	unsigned int getSeed(void) const	{ return m_key[0]; }
+
+	// Draws handed out since seeding. Setting it back puts the sequence where it was
+	long long getCounter(void) const	{ return m_counter; }
+	void setCounter(long long counter)	{ m_counter = counter; }
+
+	// The next draw in sequence, 32 uniform bits
+	unsigned int next(void)
+	{
+		long long block = m_counter >> 2;
+		if(block != m_blockIndex)
+		{
+			philox(block, m_key, m_block);
+			m_blockIndex = block;
+		}
+		return m_block[m_counter++ & 3];
+	}
+
+	int below(int n)	{ return below(next(), n); }	// 0 to n-1, n > 0
+	float uniform(void)	{ return uniform(next()); }		// [0, 1)
+
+	// Skips count draws and returns the first, for a kernel to read with at() or fill()
+	long long reserve(long long count)	{ long long first = m_counter; m_counter += count; return first; }
+
+	// Any draw by its counter, these do not move the sequence and are safe from any thread
+	unsigned int at(long long index) const;
+	void fill(long long first, unsigned int *out, int count) const;
+
+	static int below(unsigned int draw, int n)	{ return (int)(((unsigned long long)draw * (unsigned int)n) >> 32); }
+	static float uniform(unsigned int draw)		{ return (draw >> 8) * (1.0f/16777216.0f); }
+
+	// Philox4x32-10 of the 64 bit block counter
+	static void philox(long long block, const unsigned int key[2], unsigned int out[4]);
+};
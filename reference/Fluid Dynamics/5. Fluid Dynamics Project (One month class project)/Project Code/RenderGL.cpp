@@ -0,0 +1,99 @@
+#include "RenderGL.h"
+
+void CGLRenderer::resize(int width, int height)
+{
+	CRenderBackend::resize(width, height);
+	glViewport(0, 0, m_width, m_height);
+}
+
+void CGLRenderer::setPerspective(float fovY, float zNear, float zFar)
+{
+	CRenderBackend::setPerspective(fovY, zNear, zFar);
+	glMatrixMode(GL_PROJECTION);
+	glLoadMatrixf(m_projection);
+	glMatrixMode(GL_MODELVIEW);
+}
+
+void CGLRenderer::beginFrame(void)
+{
+	CRenderBackend::beginFrame();
+	glClearColor(m_background.red, m_background.green, m_background.blue, 0.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	if(m_bLighting)
+		glEnable(GL_LIGHTING);
+	else
+		glDisable(GL_LIGHTING);
+	if(m_bWireFrame)
+		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+	else
+		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+}
+
+void CGLRenderer::applyCamera(void)
+{
+	glLoadMatrixf(m_view);
+}
+
+void CGLRenderer::setLight(int light, const float position[3], const float diffuse[3])
+{
+	CRenderBackend::setLight(light, position, diffuse);
+	if(light < 0 || light >= RENDER_LIGHTS)
+		return;
+
+	// Point source, under the camera's modelview
+	GLfloat where[4] = { position[0], position[1], position[2], 1.0f };
+	GLfloat color[4] = { diffuse[0], diffuse[1], diffuse[2], 1.0f };
+	glLightfv(GL_LIGHT0 + light, GL_DIFFUSE, color);
+	glLightfv(GL_LIGHT0 + light, GL_POSITION, where);
+}
+
+void CGLRenderer::draw(const tRenderMesh &mesh, const float model[16])
+{
+	count(mesh);
+
+	glEnableClientState( GL_VERTEX_ARRAY);
+	glVertexPointer(3, GL_FLOAT, 0, mesh.vertices);
+	if(mesh.normals)
+	{
+		glEnableClientState( GL_NORMAL_ARRAY);
+		glNormalPointer(GL_FLOAT, 0, mesh.normals); // Always has 3 elements
+	}
+	if(mesh.colors)
+	{
+		glEnableClientState( GL_COLOR_ARRAY);
+		glColorPointer(4, GL_UNSIGNED_BYTE, mesh.colorStride, mesh.colors);
+	}
+	else
+		glColor4ubv((const GLubyte *)&mesh.color);
+
+	glPushMatrix();
+		glMultMatrixf(model);
+		glDrawElements( GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT, mesh.indices);
+	glPopMatrix();
+
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glDisableClientState(GL_COLOR_ARRAY);
+}
+
+void CGLRenderer::drawLines(const tRenderLines &lines, const float model[16])
+{
+	count(lines);
+
+	if(m_bLighting)
+		glDisable(GL_LIGHTING);
+	glColor4ubv((const GLubyte *)&lines.color);
+	glLineWidth(1.0f);
+	glEnableClientState( GL_VERTEX_ARRAY);
+	glVertexPointer(3, GL_FLOAT, 0, lines.vertices);
+
+	glPushMatrix();
+		glMultMatrixf(model);
+		glDrawArrays( GL_LINES, 0, lines.vertexCount);
+	glPopMatrix();
+
+	glDisableClientState(GL_VERTEX_ARRAY);
+	if(m_bLighting)
+		glEnable(GL_LIGHTING);
+}
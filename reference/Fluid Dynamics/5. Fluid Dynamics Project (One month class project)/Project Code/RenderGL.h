@@ -0,0 +1,31 @@
+#pragma once
+
+#include <windows.h>    // windows crap
+#include <gl/gl.h>      // openGL 1.1
+#include "Renderer.h"	// the interface
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Class:	"CGLRenderer"
+//
+// Purpose: The demo's backend, fixed function GL into the window. The matrices are loaded as they are, the lights
+//			go in with the camera's modelview like glLightfv always took them, and each draw is a glDrawElements from
+//			the mesh's arrays under its model matrix, each line list one glDrawArrays with the lighting off. SetupGL
+//			still does the one time state (depth test, the lights' colours, colour material).
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class CGLRenderer :
+	public CRenderBackend
+{
+
+protected:
+
+	void applyCamera(void);
+
+public:
+
+	void resize(int width, int height);
+	void setPerspective(float fovY, float zNear, float zFar);
+	void beginFrame(void);
+	void setLight(int light, const float position[3], const float diffuse[3]);
+	void draw(const tRenderMesh &mesh, const float model[16]);
+	void drawLines(const tRenderLines &lines, const float model[16]);
+};
@@ -0,0 +1,136 @@
+#include "Renderer.h"
+
+#include <string.h>
+#include <math.h>
+
+CRenderBackend::CRenderBackend(void)
+{
+	m_width = m_height = 1;
+	m_fovY	= CAMERA_FOV;
+	m_zNear	= CAMERA_NEAR;
+	m_zFar	= CAMERA_FAR;
+	identity(m_projection);
+	identity(m_view);
+	m_eye[0] = m_eye[1] = m_eye[2] = 0.0f;
+	memset ( m_lights, 0, sizeof(m_lights) );
+
+	// glClearColor in SetupGL
+	m_background.red = m_background.green = m_background.blue = 0.3f;
+	m_bLighting		= true;
+	m_bWireFrame	= false;
+	memset ( &m_stats, 0, sizeof(m_stats) );
+}
+
+void CRenderBackend::count(const tRenderMesh &mesh)
+{
+	m_stats.draws++;
+	m_stats.vertices	+= mesh.vertexCount;
+	m_stats.triangles	+= mesh.indexCount/3;
+}
+
+void CRenderBackend::count(const tRenderLines &lines)
+{
+	m_stats.draws++;
+	m_stats.vertices	+= lines.vertexCount;
+	m_stats.lines		+= lines.vertexCount/2;
+}
+
+void CRenderBackend::resize(int width, int height)
+{
+	m_width		= width > 0 ? width : 1;
+	m_height	= height > 0 ? height : 1;
+	setPerspective(m_fovY, m_zNear, m_zFar);
+}
+
+void CRenderBackend::setPerspective(float fovY, float zNear, float zFar)
+{
+	m_fovY	= fovY;
+	m_zNear	= zNear;
+	m_zFar	= zFar;
+
+	// gluPerspective
+	float f = 1.0f/(float)tan(fovY*3.14159265f/360.0f), aspect = (float)m_width/m_height;
+	memset ( m_projection, 0, sizeof(m_projection) );
+	m_projection[0]		= f/aspect;
+	m_projection[5]		= f;
+	m_projection[10]	= (zFar + zNear)/(zNear - zFar);
+	m_projection[11]	= -1.0f;
+	m_projection[14]	= 2.0f*zFar*zNear/(zNear - zFar);
+}
+
+void CRenderBackend::setCamera(const float origin[3], const float forward[3], const float up[3])
+{
+	// The rows are x = up cross z, up and z = -forward, then the translation to the origin
+	float z[3] = { -forward[0], -forward[1], -forward[2] };
+	float x[3] = { up[1]*z[2] - up[2]*z[1], up[2]*z[0] - up[0]*z[2], up[0]*z[1] - up[1]*z[0] };
+	for(int k = 0; k < 3; k++)
+	{
+		m_view[k*4 + 0] = x[k];
+		m_view[k*4 + 1] = up[k];
+		m_view[k*4 + 2] = z[k];
+		m_view[k*4 + 3] = 0.0f;
+		m_eye[k] = origin[k];
+	}
+	for(int r = 0; r < 3; r++)
+		m_view[12 + r] = -(m_view[r]*origin[0] + m_view[4 + r]*origin[1] + m_view[8 + r]*origin[2]);
+	m_view[15] = 1.0f;
+	applyCamera();
+}
+
+void CRenderBackend::setLight(int light, const float position[3], const float diffuse[3])
+{
+	if(light < 0 || light >= RENDER_LIGHTS)
+		return;
+	memcpy ( m_lights[light].position, position, sizeof(m_lights[light].position) );
+	memcpy ( m_lights[light].diffuse, diffuse, sizeof(m_lights[light].diffuse) );
+}
+
+void CRenderBackend::identity(float m[16])
+{
+	memset ( m, 0, 16*sizeof(float) );
+	m[0] = m[5] = m[10] = m[15] = 1.0f;
+}
+
+void CRenderBackend::multiply(const float a[16], const float b[16], float out[16])
+{
+	float product[16];
+	for(int c = 0; c < 4; c++)
+	{
+		for(int r = 0; r < 4; r++)
+			product[c*4 + r] = a[r]*b[c*4] + a[4 + r]*b[c*4 + 1] + a[8 + r]*b[c*4 + 2] + a[12 + r]*b[c*4 + 3];
+	}
+	memcpy ( out, product, sizeof(product) );
+}
+
+void CRenderBackend::translate(float m[16], float x, float y, float z)
+{
+	for(int r = 0; r < 4; r++)
+		m[12 + r] += m[r]*x + m[4 + r]*y + m[8 + r]*z;
+}
+
+void CRenderBackend::rotate(float m[16], float degrees, float x, float y, float z)
+{
+	// glRotatef's matrix, about the normalized axis
+	float length = (float)sqrt(x*x + y*y + z*z);
+	if(length <= 0.0f)
+		return;
+	x /= length;	y /= length;	z /= length;
+	float radians = degrees*3.14159265f/180.0f;
+	float c = (float)cos(radians), s = (float)sin(radians), t = 1.0f - c;
+	float rotation[16] = {
+		x*x*t + c,		y*x*t + z*s,	x*z*t - y*s,	0.0f,
+		x*y*t - z*s,	y*y*t + c,		y*z*t + x*s,	0.0f,
+		x*z*t + y*s,	y*z*t - x*s,	z*z*t + c,		0.0f,
+		0.0f,			0.0f,			0.0f,			1.0f };
+	multiply(m, rotation, m);
+}
+
+void CRenderBackend::scale(float m[16], float x, float y, float z)
+{
+	for(int r = 0; r < 4; r++)
+	{
+		m[r]		*= x;
+		m[4 + r]	*= y;
+		m[8 + r]	*= z;
+	}
+}
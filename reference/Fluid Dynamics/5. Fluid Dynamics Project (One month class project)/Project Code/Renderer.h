@@ -0,0 +1,146 @@
+#pragma once
+
+#include "Def.h"	    // definitions
+
+#define RENDER_LIGHTS	2		// GL_LIGHT0 over the water, GL_LIGHT1 on the ship
+#define RENDER_AMBIENT	0.006f	// GL's default 0.2 material ambient times the 0.01 ambient of the light model and
+								// each light (SetupGL), what an unlit side of the fixed function scene still shows
+
+// A triangle list to draw: positions and normals as float triples, colours as RGBA8 bytes colorStride apart, or one
+// colour for the whole mesh. The arrays are the caller's and only read during draw()
+struct tRenderMesh
+{
+	const float			*vertices;
+	const float			*normals;
+	const unsigned char	*colors;		// NULL for color
+	int					colorStride;	// Bytes from one vertex's colour to the next
+	unsigned int		color;			// RGBA8, the bytes in that order
+	const int			*indices;
+	int					vertexCount;
+	int					indexCount;		// Three a triangle
+};
+
+// Line segments, unlit, in one colour: positions as float triples, two a segment
+struct tRenderLines
+{
+	const float		*vertices;
+	int				vertexCount;	// Two a line
+	unsigned int	color;			// RGBA8, as tRenderMesh's
+};
+
+// A point light, positioned in the world
+struct tRenderLight
+{
+	float	position[3];
+	float	diffuse[3];
+};
+
+// What a frame submitted
+struct tRenderStats
+{
+	int			draws;
+	long long	vertices;
+	long long	triangles;
+	long long	lines;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Class:	"CRenderBackend"
+//
+// Purpose: What the demo's scene is drawn through: a camera, a perspective, two point lights and triangle meshes with
+//			a model matrix, lit the way the fixed function pipeline lights them (diffuse from the vertex colour,
+//			specular off, normals taken through the model matrix as they are), and unlit line lists for the debug
+//			views. The state lives here, the backends only turn it into pixels: CGLRenderer (RenderGL.h) into the
+//			window, CSoftRenderer (SoftRenderer.h) into an image in memory on the CPU, CNullRenderer nowhere, which
+//			leaves everything up to the draws to time. The matrices are GL's, column major, so the helpers below
+//			compose them the way glTranslatef and friends do.
+//
+// Usage:	resize and setPerspective when the window changes, then every frame beginFrame, setCamera, setLight
+//			for each light (after the camera, as glLightfv), draw for each mesh, drawLines for each line list and
+//			endFrame.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class CRenderBackend
+{
+
+protected:
+
+	int		m_width;
+	int		m_height;
+	float	m_fovY;			// Degrees
+	float	m_zNear;
+	float	m_zFar;
+	float	m_projection[16];
+	float	m_view[16];
+	float	m_eye[3];
+	tRenderLight m_lights[RENDER_LIGHTS];
+	tColor	m_background;
+	bool	m_bLighting;
+	bool	m_bWireFrame;
+	tRenderStats m_stats;
+
+	void count(const tRenderMesh &mesh);
+	void count(const tRenderLines &lines);
+	virtual void applyCamera(void)	{}	// m_view and m_eye have changed
+
+public:
+
+	CRenderBackend(void);
+	virtual ~CRenderBackend(void) {}
+
+	// Pixels, and the perspective gluPerspective would give with their aspect, CAMERA_FOV, CAMERA_NEAR and CAMERA_FAR
+	// until setPerspective says otherwise
+	virtual void resize(int width, int height);
+	virtual void setPerspective(float fovY, float zNear, float zFar);
+
+	virtual void beginFrame(void)	{ m_stats.draws = 0; m_stats.vertices = m_stats.triangles = m_stats.lines = 0; }
+	virtual void endFrame(void)		{}
+
+	// GLFrame's ApplyCameraTransform, from where the camera is, where it looks and which way is up
+	void setCamera(const float origin[3], const float forward[3], const float up[3]);
+	template<class tFrame> void setCamera(tFrame &frame)
+	{
+		float origin[3], forward[3], up[3];
+		frame.GetOrigin(origin);
+		frame.GetForwardVector(forward);
+		frame.GetUpVector(up);
+		setCamera(origin, forward, up);
+	}
+	virtual void setLight(int light, const float position[3], const float diffuse[3]);
+	void setLighting(bool on)			{ m_bLighting = on; }
+	void setWireFrame(bool on)			{ m_bWireFrame = on; }	// Only GL draws the edges, the others fill
+	void setBackground(tColor color)	{ m_background = color; }
+
+	virtual void draw(const tRenderMesh &mesh, const float model[16]) = 0;
+	virtual void drawLines(const tRenderLines &lines, const float model[16]) = 0;	// One pixel wide
+
+	int getWidth(void) const				{ return m_width; }
+	int getHeight(void) const				{ return m_height; }
+	const float *getProjection(void) const	{ return m_projection; }
+	const float *getView(void) const		{ return m_view; }
+	const float *getEye(void) const			{ return m_eye; }
+	const tRenderStats &getStats(void) const	{ return m_stats; }
+
+	// Column major 4x4s, out = a b (out may be either)
+	static void identity(float m[16]);
+	static void multiply(const float a[16], const float b[16], float out[16]);
+	// m times the transform, as glTranslatef, glRotatef (degrees) and glScalef do to the current matrix
+	static void translate(float m[16], float x, float y, float z);
+	static void rotate(float m[16], float degrees, float x, float y, float z);
+	static void scale(float m[16], float x, float y, float z);
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Class:	"CNullRenderer"
+//
+// Purpose: Takes the frame and draws none of it, so a benchmark runs the whole frame up to the draws (mesh, levels
+//			of detail) with no rasterizer in the numbers. getStats still counts what was submitted.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class CNullRenderer :
+	public CRenderBackend
+{
+
+public:
+
+	void draw(const tRenderMesh &mesh, const float /*model*/[16])		{ count(mesh); }
+	void drawLines(const tRenderLines &lines, const float /*model*/[16])	{ count(lines); }
+};
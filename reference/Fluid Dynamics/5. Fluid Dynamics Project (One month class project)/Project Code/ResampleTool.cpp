@@ -0,0 +1,130 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	"ResampleTool.cpp"
+//
+// Purpose: Checks CFieldResampler (see FieldResampler.h) against the one field both its filters must reproduce.
+//
+// Usage:	resample_tool check [from to]...
+//
+//			check fills the density and both velocity components with planes over the cell centres, ring included,
+//			resamples them from each grid to each mesh with both filters and compares every output cell, the ring
+//			too, with the plane at that cell's centre. Without sizes it runs a set of up and downsamplings, the
+//			uneven ones among them. Exits 1 if any cell is further off than float rounding.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "Solver.h"
+#include "FieldResampler.h"
+
+#define RESAMPLE_TOLERANCE	1e-5	// Of the plane's largest value on the grid
+
+extern int N;
+
+static int usage(const char *name)
+{
+	fprintf ( stderr, "usage : %s check [from to]...\n", name );
+	return 1;
+}
+
+// The planes, over cell centres at (i - 0.5)/n. The density's stays positive past the ring, where bicubic would clamp
+static float plane(int field, int i, int j, int n)
+{
+	float x = (i - 0.5f)/n, y = (j - 0.5f)/n;
+	if(field == 0)
+		return 1.0f + 2.0f*x + 3.0f*y;
+	return field == 1 ? 4.0f*x - 3.0f*y + 0.5f : -2.0f*x + 5.0f*y - 1.0f;
+}
+
+// Largest difference from the planes over every output cell, relative to the largest value
+static double planeError(const CFieldResampler &resampler, int field)
+{
+	const float *out = field == 0 ? resampler.getDensity() : (field == 1 ? resampler.getU() : resampler.getV());
+	int n = resampler.getSize(), N = n;
+	double worst = 0.0, largest = 0.0;
+	for (int j = 0; j <= n + 1; j++)
+		for (int i = 0; i <= n + 1; i++)
+		{
+			double want = plane(field, i, j, n);
+			double got = field == 0 ? out[IX(i,j)] : out[VIX(i,j)];
+			if(fabs(got - want) > worst)
+				worst = fabs(got - want);
+			if(fabs(want) > largest)
+				largest = fabs(want);
+		}
+	return worst/largest;
+}
+
+static int checkSizes(int from, int to)
+{
+	float *dens = allocate_field ( from ), *u = NULL, *v = NULL;
+	allocate_velocity ( from, &u, &v );
+	if ( !dens || !u || !v ) {
+		fprintf ( stderr, "cannot allocate data\n" );
+		free_field ( dens );
+		free_velocity ( u, v );
+		return 1;
+	}
+
+	N = from;
+	for (int j = 0; j <= N + 1; j++)
+		for (int i = 0; i <= N + 1; i++)
+		{
+			dens[IX(i,j)]	= plane(0, i, j, N);
+			u[VIX(i,j)]		= plane(1, i, j, N);
+			v[VIX(i,j)]		= plane(2, i, j, N);
+		}
+
+	int failed = 0;
+	for (int filter = 0; filter < totalResampleFilterCount; filter++)
+	{
+		CFieldResampler resampler;
+		if(!resampler.allocate(to, filter) || !resampler.resample(dens, u, v))
+		{
+			fprintf ( stderr, "cannot allocate data\n" );
+			failed = 1;
+			break;
+		}
+
+		double error[3];
+		bool ok = true;
+		for (int field = 0; field < 3; field++)
+		{
+			error[field] = planeError(resampler, field);
+			ok = ok && error[field] <= RESAMPLE_TOLERANCE;
+		}
+		printf ( "%4d -> %-4d %-8s  density %.1e  u %.1e  v %.1e  %s\n", from, to, CFieldResampler::filterName(filter),
+			error[0], error[1], error[2], ok ? "exact" : "OFF THE PLANE" );
+		failed += !ok;
+	}
+
+	free_field ( dens );
+	free_velocity ( u, v );
+	return failed;
+}
+
+static int check(int pairs, char *sizes[])
+{
+	// Up and down, by whole factors and not, and the same size
+	static const int defaults[][2] = { {64, 256}, {128, 512}, {100, 37}, {37, 100}, {256, 128}, {512, 128}, {64, 64} };
+	int failed = 0;
+	if(pairs == 0)
+		for (size_t k = 0; k < sizeof(defaults)/sizeof(defaults[0]); k++)
+			failed += checkSizes(defaults[k][0], defaults[k][1]);
+	for (int k = 0; k < pairs; k++)
+		failed += checkSizes(atoi(sizes[2*k]), atoi(sizes[2*k + 1]));
+	return failed ? 1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+	if(argc >= 2 && !strcmp(argv[1], "check") && argc % 2 == 0)
+	{
+		for (int k = 2; k < argc; k++)
+			if(atoi(argv[k]) < 2)
+				return usage(argv[0]);
+		return check((argc - 2)/2, argv + 2);
+	}
+	return usage(argv[0]);
+}
@@ -0,0 +1,132 @@
+#include "Scheduler.h"
+
+#include <string.h>
+
+#define SLOT(tick)	((int)((tick) & (SCHEDULER_SLOTS - 1)))
+
+static int toTicks(float seconds)
+{
+	int ticks = (int)(seconds/SCHEDULER_TICK + 0.5f);
+	return ticks < 1 ? 1 : ticks;
+}
+
+CScheduler::CScheduler(void)
+{
+	clear();
+}
+
+void CScheduler::clear(void)
+{
+	memset ( &m_state, 0, sizeof(m_state) );
+	relinkAll();
+}
+
+void CScheduler::link(int event)
+{
+	// Kept in id order, so a tick fires its events in id order
+	int *at = &m_slots[SLOT(m_state.due[event])];
+	while(*at >= 0 && *at < event)
+		at = &m_next[*at];
+	m_next[event] = *at;
+	*at = event;
+}
+
+void CScheduler::unlink(int event)
+{
+	int *at = &m_slots[SLOT(m_state.due[event])];
+	while(*at >= 0 && *at != event)
+		at = &m_next[*at];
+	if(*at == event)
+		*at = m_next[event];
+	m_next[event] = -1;
+}
+
+void CScheduler::relinkAll(void)
+{
+	int k;
+	for(k = 0; k < SCHEDULER_SLOTS; k++)
+		m_slots[k] = -1;
+	for(k = 0; k < SCHEDULER_EVENTS; k++)
+	{
+		m_next[k] = -1;
+		if(m_state.period[k])
+			link(k);
+	}
+}
+
+void CScheduler::schedule(int event, float period)
+{
+	cancel(event);
+	m_state.period[event]	= toTicks(period);
+	m_state.due[event]		= m_state.tick + m_state.period[event];
+	link(event);
+}
+
+void CScheduler::setPeriod(int event, float period)
+{
+	if(m_state.period[event])
+		m_state.period[event] = toTicks(period);
+}
+
+void CScheduler::cancel(int event)
+{
+	if(m_state.period[event])
+		unlink(event);
+	m_state.period[event] = 0;
+}
+
+int CScheduler::advance(float dt, tScheduledHandler handler, void *context)
+{
+	int fired = 0;
+	m_state.remainder += dt;
+	while(m_state.remainder >= SCHEDULER_TICK)
+	{
+		m_state.remainder -= SCHEDULER_TICK;
+		m_state.tick++;
+
+		// Take the events due now off the slot first, the ones a lap or more away stay in it
+		int due[SCHEDULER_EVENTS], count = 0;
+		for(int e = m_slots[SLOT(m_state.tick)]; e >= 0; e = m_next[e])
+		{
+			if(m_state.due[e] == m_state.tick)
+				due[count++] = e;
+		}
+		for(int k = 0; k < count; k++)
+		{
+			int event = due[k];
+			unlink(event);
+			m_state.due[event] += m_state.period[event];
+			link(event);
+		}
+
+		// A handler may change or cancel events, which only moves firings after these (or drops one due now)
+		for(int k = 0; k < count; k++)
+		{
+			if(m_state.period[due[k]])
+				handler(context, due[k], m_state.period[due[k]] * SCHEDULER_TICK);
+		}
+		fired += count;
+	}
+	return fired;
+}
+
+float CScheduler::getTimeUntil(int event) const
+{
+	if(!m_state.period[event])
+		return -1.0f;
+	return (float)((m_state.due[event] - m_state.tick) * SCHEDULER_TICK - m_state.remainder);
+}
+
+void CScheduler::setState(const tSchedulerState &state)
+{
+	m_state = state;
+	for(int k = 0; k < SCHEDULER_EVENTS; k++)
+	{
+		// A due tick already gone (a damaged file) would wait a whole lap of the 64 bit counter
+		if(m_state.period[k] < 0)
+			m_state.period[k] = 0;
+		if(m_state.period[k] && m_state.due[k] <= m_state.tick)
+			m_state.due[k] = m_state.tick + 1;
+	}
+	relinkAll();
+}
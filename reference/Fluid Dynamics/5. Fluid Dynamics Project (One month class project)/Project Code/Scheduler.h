@@ -0,0 +1,65 @@
+#pragma once
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Class:	"CScheduler"
+//
+// Purpose: Periodic events keyed by sim time, on a hashed timer wheel. Time is counted in whole ticks of
+//			SCHEDULER_TICK seconds; an event due at tick t waits in slot t % SCHEDULER_SLOTS, so advancing a tick
+//			looks at one short list whatever the number of events or how far off they are. An event fires as often
+//			as its period says however the time arrives, one long dt or many short ones, and never depends on N.
+//
+// Usage:	schedule(event, period) for each event id below SCHEDULER_EVENTS, then advance(dt, handler, context) once
+//			per pass. The handler gets every firing in tick order, and in event id order within a tick, with the
+//			event's period as its dt. Everything is integer ticks apart from the fraction of a tick not yet run, so
+//			the firings are the same on every machine and a checkpoint of getState() carries on exactly.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define SCHEDULER_TICK		0.00025f	// Sim seconds a tick, the shortest period there is
+#define SCHEDULER_SLOTS		64			// Wheel size, a power of two
+#define SCHEDULER_EVENTS	8			// Event ids 0 to 7
+
+typedef void (*tScheduledHandler)(void *context, int event, float period);
+
+// The whole state, fixed size so a checkpoint can hold it as it is
+struct tSchedulerState
+{
+	long long	tick;						// Ticks run
+	double		remainder;					// Seconds into the next tick
+	long long	due[SCHEDULER_EVENTS];		// Tick each event fires next
+	int			period[SCHEDULER_EVENTS];	// In ticks, 0 for an event not scheduled
+};
+
+class CScheduler
+{
+
+private:
+
+	tSchedulerState	m_state;
+	int				m_next[SCHEDULER_EVENTS];	// Next event in the same slot, -1 at the end
+	int				m_slots[SCHEDULER_SLOTS];	// First event in each slot, -1 for none
+
+	void link(int event);
+	void unlink(int event);
+	void relinkAll(void);
+
+public:
+
+	CScheduler(void);
+
+	void clear(void);	// Back to tick 0 with nothing scheduled
+
+	// Fires period seconds from now and every period after, rounded to a whole tick and at least one
+	void schedule(int event, float period);
+	// A new period from the next firing on, which stays where it was
+	void setPeriod(int event, float period);
+	void cancel(int event);
+
+	// Runs dt seconds of ticks and returns how many events fired
+	int advance(float dt, tScheduledHandler handler, void *context);
+
+	float getPeriod(int event) const	{ return m_state.period[event] * SCHEDULER_TICK; }
+	float getTimeUntil(int event) const;	// Seconds until it fires next, -1 when not scheduled
+
+	const tSchedulerState &getState(void) const	{ return m_state; }
+	void setState(const tSchedulerState &state);
+};
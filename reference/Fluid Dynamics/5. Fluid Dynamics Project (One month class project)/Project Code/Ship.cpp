@@ -1,6 +1,7 @@
-#include ".\ship.h"
+#include "Ship.h"
+#include "Profiler.h"
 
-extern N;
+extern int N;
 
 CShip::CShip(void)
 {	
@@ -37,14 +38,6 @@ CShip::CShip(void)
 	m_fThrust  = 0.0f;
 	m_nWindDirection = down;
 	m_bSailsDown = false;
-
-	// Scaling and normalizing the ship model
-	for(int i = 0; i  < 2333; i++)
-	{
-		for(int j = 0; j < 3; j++)
-			vdata[i][j] *= 0.0035;
-		m3dNormalizeVectorf(ndata[i]);
-	}
 }
 
 CShip::~CShip(void)
@@ -78,71 +71,6 @@ void CShip::resetPos(void)
 	}
 }
 
-void CShip::render(float dt)
-{
-	// Spanish Galeon	
-	glPushMatrix();
-		
-		// Transformations (is this the right word? I think)
-		glTranslatef((WATER_SCALE/N)*(m_fX), m_fY, (WATER_SCALE/N)*m_fZ);
-	    static float sinNumber = 0;
-		sinNumber += dt;
-		glTranslatef(0.0f, -0.8f + sin(sinNumber)/50, 0.0f);
-		glRotatef(90.0f, 1.0f, 0.0f, 0.0f);
-		if(m_bXRoll)
-			glRotatef(-m_fXrForce, 0.0f, 1.0f, 0.0f);
-		else
-			glRotatef(m_fXrForce, 0.0f, 1.0f, 0.0f);
-		if(m_bZRoll)
-			glRotatef(m_fZrForce, 1.0f, 0.0f, 0.0f);
-		else
-			glRotatef(-m_fZrForce, 1.0f, 0.0f, 0.0f);
-		
-		// Position light
-		glPushMatrix();
-			GLfloat someLight[4] = { sin(sinNumber), sin(sinNumber), sin(sinNumber)/10, 1.0f };
-			glLightfv(GL_LIGHT1, GL_DIFFUSE, someLight);
-			GLfloat whereLight[4] = { 0.0f, 0.0f, 0.0f, 1.0f }; // Point source
-			glLightfv(GL_LIGHT1, GL_POSITION, whereLight);
-		glPopMatrix();
-
-		glEnableClientState( GL_VERTEX_ARRAY);
-		glEnableClientState( GL_NORMAL_ARRAY);
-		glVertexPointer(3, GL_FLOAT, 0, vdata);
-		glNormalPointer(GL_FLOAT, 0, ndata); // Always has 3 elements
-
-		glFrontFace(GL_CW);
-		glColor3f(0.309804f, 0.184314f, 0.184314f);
-		glDrawElements( GL_TRIANGLES, 94*3, GL_UNSIGNED_INT, GALLEONAFT_indices);
-		glColor3f(0.590000f, 0.410000f, 0.310000f);
-		glDrawElements( GL_TRIANGLES, 106*3, GL_UNSIGNED_INT, GALLEONDEC_indices);
-		glColor3f(0.309804f, 0.184314f, 0.184314f);
-		glDrawElements( GL_TRIANGLES, 300*3, GL_UNSIGNED_INT, GALLEONFLA_indices);
-		glColor3f(0.850000f, 0.530000f, 0.100000f);
-		glDrawElements( GL_TRIANGLES, 16*3, GL_UNSIGNED_INT, GALLEONLAM_indices);
-		glColor3f(0.850000f, 0.530000f, 0.100000f);
-		glDrawElements( GL_TRIANGLES, 20*3, GL_UNSIGNED_INT, GALLEONWIN_indices);
-		glColor3f(0.309804f, 0.184314f, 0.184314f);
-		glDrawElements( GL_TRIANGLES, 970*3, GL_UNSIGNED_INT, GALLEONSMO_indices); // Skeleton
-
-		glRotatef(m_fHeading, 0.0f, 0.0f, 1.0f);
-
-		glColor3f(0.100000f, 0.100000f, 0.100000f);
-		glDrawElements( GL_TRIANGLES, 112*3, GL_UNSIGNED_INT, GALLEONRIG_indices); // Ropes
-		glColor3f(0.435294f, 0.258824f, 0.258824f);
-		glDrawElements( GL_TRIANGLES, 1333*3, GL_UNSIGNED_INT, GALLEONMAS_indices); // Wood
-		if(!m_bSailsDown)
-		{
-			glColor3f(0.847059f, 0.847059f, 0.749020f);
-			glDrawElements( GL_TRIANGLES, 1530*3, GL_UNSIGNED_INT, GALLEONSAI_indices); // Kanvas
-		}
-
-		glDisableClientState(GL_VERTEX_ARRAY);	
-		glDisableClientState(GL_NORMAL_ARRAY);
-
-	glPopMatrix();
-}
-
 bool CShip::applyPhysics(float d, float u, float v, int x, int y)
 {
 	if(m_sideways)
@@ -166,7 +94,7 @@ bool CShip::applyPhysics(float d, float u, float v, int x, int y)
 	if((midships || starboard || port) && (Bulkheads[eBow] || Bulkheads[eBowy] || Bulkheads[eAmidships] || Bulkheads[eSterny] || Bulkheads[eStern]))
 	{
 		// Torrent :)
-		float absD = abs(d)/100;
+		float absD = fabs(d)/100;
 		m_fXdForce += u*absD;
 		m_fZdForce += v*absD;
 
@@ -214,7 +142,7 @@ bool CShip::applyPhysics(float d, float u, float v, int x, int y)
 			else if(midships)
 			{
 				// Buoyancy
-				m_fYdForce = abs(m_fY) - abs(d);
+				m_fYdForce = fabs(m_fY) - fabs(d);
 				if(d < 0)
 					m_fYdForce *= -1;
 			}
@@ -254,8 +182,26 @@ bool CShip::applyPhysics(float d, float u, float v, int x, int y)
 	return false;
 }
 
+void CShip::sample(const float *d, const float *u, const float *v)
+{
+	// applyPhysics takes the 3 by 5 cells around (m_fX, m_fZ) and ignores the rest, so only those are offered
+	int x0 = (int)m_fX, z0 = (int)m_fZ;
+	for(int x = x0-1; x <= x0+1; x++)
+	{
+		for(int z = z0-2; z <= z0+2; z++)
+		{
+			int i = m_sideways ? z : x;
+			int j = m_sideways ? x : z;
+			if(i < 0 || i > N || j < 0 || j > N)
+				continue;
+			applyPhysics(d[IX(i,j)], u[VIX(i,j)], v[VIX(i,j)], i, j);
+		}
+	}
+}
+
 void CShip::update(float dt)
 {
+	PROFILE_ZONE("ship update");
 	// Buoyancy
 	m_fY += m_fYdForce/5;
 
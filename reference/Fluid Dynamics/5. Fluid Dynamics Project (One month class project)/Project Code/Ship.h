@@ -1,18 +1,17 @@
 #pragma once
 
-#include <windows.h>    // windows crap
-#include <gl/gl.h>      // openGL 1.1
-#include <gl/glu.h>     // openGL utilities
-#include <gl/glut.h>    // openGL toolkit for demos
 #include "Def.h"	    // definitions
-#include "ShipData.h"	// model data
-#include "Math3d.h"		// Richard's stuff
+#include <math.h>
+
+class CRenderBackend;
 
 class CShip
 {
 
 private:
 
+	friend class CCheckpoint;
+
 	// Position
 	float m_fX;
 	float m_fZ;
@@ -50,8 +49,9 @@ public:
 	CShip(void);
 	virtual ~CShip(void);
 	
-	void render(float dt);
+	void render(CRenderBackend &renderer, float dt);	// ShipRender.cpp
 	bool applyPhysics(float d, float u, float v, int x, int y);
+	void sample(const float *d, const float *u, const float *v);	// applyPhysics for the cells under the hull
 	void update(float dt);
 	void resetPos(void);
 
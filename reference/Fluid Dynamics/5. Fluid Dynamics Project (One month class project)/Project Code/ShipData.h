@@ -37,7 +37,7 @@
  * want to adjust the color and material of the object.
  */
 
-static GLfloat vdata[2333][3] = {
+static float vdata[2333][3] = {
 	{-11.73597f, -325.39120f, -134.88767f}, {0.00000f, -325.39546f, -134.87123f}, {-0.00000f, -357.62909f, -131.53607f}, {-26.49700f, -352.97915f, -134.87123f}, 
 	{-26.48912f, -310.57200f, -134.89906f}, {-11.46993f, -310.57200f, -134.89884f}, {-86.02490f, -339.00335f, -146.21077f}, {-109.65715f, -333.88680f, -146.21077f}, 
 	{-102.44499f, -310.57200f, -146.23840f}, {-86.02481f, -310.57200f, -146.23840f}, {-41.85969f, -350.27710f, -134.87123f}, {-69.73790f, -346.12027f, -146.21077f}, 
@@ -624,7 +624,7 @@ static GLfloat vdata[2333][3] = {
 	{89.61346f, 135.74010f, -273.91297f}
 };
 
-static GLfloat ndata[2333][3] = {
+static float ndata[2333][3] = {
 	{-0.05390f, -2.34599f, 0.17189f}, {0.00000f, -2.37327f, 0.18628f}, {-0.00000f, -1.90439f, -5.71321f}, {-0.32812f, -4.32036f, -6.49409f}, 
 	{4.22856f, -0.00079f, -0.00064f}, {-14.20948f, 0.02688f, -0.00972f}, {-1.06794f, -4.41897f, -5.48226f}, {-0.98961f, -4.21933f, -4.84825f}, 
 	{1.55085f, -1.42226f, -0.47518f}, {-2.83487f, 0.00001f, -0.00000f}, {1.50063f, -4.41885f, -7.77821f}, {-0.07280f, -4.91100f, -5.44249f}, 
@@ -1212,7 +1212,7 @@ static GLfloat ndata[2333][3] = {
 };
 
 
-static GLuint GALLEONAFT_indices[94][3] = {
+static unsigned int GALLEONAFT_indices[94][3] = {
 	{2, 1, 0}, {5, 4, 3}, {0, 5, 3}, {0, 3, 2}, 
 	{8, 7, 6}, {8, 6, 9}, {12, 11, 10}, {12, 10, 13}, 
 	{7, 15, 14}, {7, 14, 6}, {16, 15, 7}, {14, 11, 6}, 
@@ -1240,7 +1240,7 @@ static GLuint GALLEONAFT_indices[94][3] = {
 };
 
 
-static GLuint GALLEONDEC_indices[106][3] = {
+static unsigned int GALLEONDEC_indices[106][3] = {
 	{82, 81, 80}, {85, 84, 83}, {84, 87, 86}, {90, 89, 88}, 
 	{93, 92, 91}, {96, 95, 94}, {96, 94, 97}, {100, 99, 98}, 
 	{103, 102, 101}, {97, 105, 104}, {97, 104, 96}, {108, 107, 106}, 
@@ -1271,7 +1271,7 @@ static GLuint GALLEONDEC_indices[106][3] = {
 };
 
 
-static GLuint GALLEONFLA_indices[300][3] = {
+static unsigned int GALLEONFLA_indices[300][3] = {
 	{151, 150, 149}, {151, 149, 152}, {155, 154, 153}, {155, 153, 156}, 
 	{152, 158, 157}, {152, 157, 151}, {161, 160, 159}, {161, 159, 162}, 
 	{165, 164, 163}, {165, 163, 166}, {162, 159, 167}, {162, 167, 168}, 
@@ -1350,7 +1350,7 @@ static GLuint GALLEONFLA_indices[300][3] = {
 };
 
 
-static GLuint GALLEONLAM_indices[16][3] = {
+static unsigned int GALLEONLAM_indices[16][3] = {
 	{416, 415, 414}, {416, 414, 417}, {417, 414, 418}, {417, 418, 419}, 
 	{419, 418, 420}, {419, 420, 421}, {421, 420, 422}, {421, 422, 423}, 
 	{423, 422, 424}, {423, 424, 425}, {425, 424, 426}, {425, 426, 427}, 
@@ -1358,7 +1358,7 @@ static GLuint GALLEONLAM_indices[16][3] = {
 };
 
 
-static GLuint GALLEONMAS_indices[1333][3] = {
+static unsigned int GALLEONMAS_indices[1333][3] = {
 	{432, 431, 430}, {432, 430, 433}, {432, 433, 434}, {432, 434, 435}, 
 	{432, 435, 436}, {432, 436, 437}, {440, 439, 438}, {440, 438, 441}, 
 	{440, 441, 442}, {440, 442, 443}, {440, 443, 444}, {440, 444, 445}, 
@@ -1696,7 +1696,7 @@ static GLuint GALLEONMAS_indices[1333][3] = {
 };
 
 
-static GLuint GALLEONRIG_indices[112][3] = {
+static unsigned int GALLEONRIG_indices[112][3] = {
 	{1200, 568, 583}, {1200, 583, 584}, {567, 1200, 584}, {567, 584, 585}, 
 	{569, 567, 585}, {569, 585, 586}, {568, 569, 586}, {568, 586, 583}, 
 	{565, 564, 579}, {565, 579, 580}, {567, 565, 580}, {567, 580, 581}, 
@@ -1728,7 +1728,7 @@ static GLuint GALLEONRIG_indices[112][3] = {
 };
 
 
-static GLuint GALLEONSAI_indices[1530][3] = {
+static unsigned int GALLEONSAI_indices[1530][3] = {
 	{1214, 1213, 1212}, {1214, 1215, 1213}, {1218, 1217, 1216}, {1217, 1218, 1219}, 
 	{1221, 1218, 1220}, {1218, 1221, 1222}, {1222, 1219, 1218}, {1219, 1222, 1223}, 
 	{1226, 1225, 1224}, {1226, 1227, 1225}, {1225, 1228, 1224}, {1228, 1225, 1229}, 
@@ -2115,7 +2115,7 @@ static GLuint GALLEONSAI_indices[1530][3] = {
 };
 
 
-static GLuint GALLEONSMO_indices[970][3] = {
+static unsigned int GALLEONSMO_indices[970][3] = {
 	{1982, 1981, 1980}, {1982, 1983, 1981}, {1985, 158, 1984}, {1985, 157, 158}, 
 	{1985, 1987, 1986}, {1987, 1985, 1984}, {1987, 1988, 1986}, {1988, 1987, 1989}, 
 	{1991, 1989, 1990}, {1991, 1988, 1989}, {1993, 1982, 1992}, {1993, 1983, 1982}, 
@@ -2362,7 +2362,7 @@ static GLuint GALLEONSMO_indices[970][3] = {
 };
 
 
-static GLuint GALLEONWIN_indices[20][3] = {
+static unsigned int GALLEONWIN_indices[20][3] = {
 	{18, 23, 63}, {18, 63, 58}, {58, 63, 59}, {58, 59, 55}, 
 	{55, 59, 60}, {55, 60, 56}, {17, 26, 23}, {17, 23, 18}, 
 	{14, 19, 26}, {14, 26, 17}, {15, 22, 19}, {15, 19, 14}, 
@@ -0,0 +1,91 @@
+#include "Ship.h"
+#include "ShipData.h"	// model data
+#include "Renderer.h"	// what it is drawn through
+#include "Mesh.h"		// packColor
+
+#include <string.h>
+
+extern int N;
+
+// The model's parts, in the order they are drawn, with their colours. The ones after the rigging turn with the heading
+struct tShipPart
+{
+	const unsigned int	*indices;
+	int					triangles;
+	tColor				color;
+	bool				turns;
+	bool				sail;		// Left out while the sails are down
+};
+
+static const tShipPart s_parts[] = {
+	{ &GALLEONAFT_indices[0][0],	94,		{ 0.309804f, 0.184314f, 0.184314f },	false,	false },
+	{ &GALLEONDEC_indices[0][0],	106,	{ 0.590000f, 0.410000f, 0.310000f },	false,	false },
+	{ &GALLEONFLA_indices[0][0],	300,	{ 0.309804f, 0.184314f, 0.184314f },	false,	false },
+	{ &GALLEONLAM_indices[0][0],	16,		{ 0.850000f, 0.530000f, 0.100000f },	false,	false },
+	{ &GALLEONWIN_indices[0][0],	20,		{ 0.850000f, 0.530000f, 0.100000f },	false,	false },
+	{ &GALLEONSMO_indices[0][0],	970,	{ 0.309804f, 0.184314f, 0.184314f },	false,	false },	// Skeleton
+	{ &GALLEONRIG_indices[0][0],	112,	{ 0.100000f, 0.100000f, 0.100000f },	true,	false },	// Ropes
+	{ &GALLEONMAS_indices[0][0],	1333,	{ 0.435294f, 0.258824f, 0.258824f },	true,	false },	// Wood
+	{ &GALLEONSAI_indices[0][0],	1530,	{ 0.847059f, 0.847059f, 0.749020f },	true,	true } };	// Kanvas
+
+void CShip::render(CRenderBackend &renderer, float dt)
+{
+	// Scaling and normalizing the ship model, once, the arrays are shared by every ship
+	static bool modelReady = false;
+	if(!modelReady)
+	{
+		for(int i = 0; i  < 2333; i++)
+		{
+			for(int j = 0; j < 3; j++)
+				vdata[i][j] *= 0.0035;
+			float length = sqrt(ndata[i][0]*ndata[i][0] + ndata[i][1]*ndata[i][1] + ndata[i][2]*ndata[i][2]);
+			if(length > 0.0f)
+				for(int j = 0; j < 3; j++)
+					ndata[i][j] /= length;
+		}
+		modelReady = true;
+	}
+
+	// Spanish Galeon
+	// Transformations (is this the right word? I think)
+	float model[16];
+	CRenderBackend::identity(model);
+	CRenderBackend::translate(model, (WATER_SCALE/N)*(m_fX), m_fY, (WATER_SCALE/N)*m_fZ);
+	static float sinNumber = 0;
+	sinNumber += dt;
+	CRenderBackend::translate(model, 0.0f, -0.8f + sin(sinNumber)/50, 0.0f);
+	CRenderBackend::rotate(model, 90.0f, 1.0f, 0.0f, 0.0f);
+	if(m_bXRoll)
+		CRenderBackend::rotate(model, -m_fXrForce, 0.0f, 1.0f, 0.0f);
+	else
+		CRenderBackend::rotate(model, m_fXrForce, 0.0f, 1.0f, 0.0f);
+	if(m_bZRoll)
+		CRenderBackend::rotate(model, m_fZrForce, 1.0f, 0.0f, 0.0f);
+	else
+		CRenderBackend::rotate(model, -m_fZrForce, 1.0f, 0.0f, 0.0f);
+
+	// Position light, a point source at the middle of the ship
+	float someLight[3] = { sin(sinNumber), sin(sinNumber), sin(sinNumber)/10 };
+	float whereLight[3] = { model[12], model[13], model[14] };
+	renderer.setLight(1, whereLight, someLight);
+
+	float turned[16];
+	memcpy ( turned, model, sizeof(turned) );
+	CRenderBackend::rotate(turned, m_fHeading, 0.0f, 0.0f, 1.0f);
+
+	tRenderMesh mesh;
+	mesh.vertices		= &vdata[0][0];
+	mesh.normals		= &ndata[0][0];
+	mesh.colors			= NULL;
+	mesh.colorStride	= 0;
+	mesh.vertexCount	= 2333;
+	for(int p = 0; p < (int)(sizeof(s_parts)/sizeof(s_parts[0])); p++)
+	{
+		if(s_parts[p].sail && m_bSailsDown)
+			continue;
+		mesh.indices	= (const int *)s_parts[p].indices;
+		mesh.indexCount	= s_parts[p].triangles*3;
+		mesh.color		= CWaterMesh::packColor(s_parts[p].color);
+		renderer.draw(mesh, s_parts[p].turns ? turned : model);
+	}
+}
@@ -0,0 +1,361 @@
+#include "Simulation.h"
+#include "Profiler.h"
+#include "Checkpoint.h"
+
+#include <stdlib.h>
+#include <math.h>
+
+int N; // Made global to comply with original source code
+
+CFluidSim::CFluidSim(void)
+{
+	m_diff   = 0.0001f;
+	m_visc   = 0.0f;
+	m_force  = 10.0f;
+	m_source = 50.0f;
+
+	m_decayRate = 0.0001f;
+
+	m_bDrawRain = false;
+	m_bDrawWind = false;
+	m_bDrawWaves = false;
+
+	m_scheduler.schedule(eSimEventDecay, DECAY_TIME);
+	m_scheduler.schedule(eSimEventShip, SHIP_TIME);
+	m_scheduler.schedule(eSimEventRain, RAIN_TIME);
+	m_scheduler.schedule(eSimEventWind, WIND_TIME);
+	m_scheduler.schedule(eSimEventWaves, WAVES_TIME);
+
+	m_u = m_v = m_u_prev = m_v_prev = m_dens = m_dens_prev = NULL;
+	m_times = NULL;
+
+	m_densitySources = m_velocitySources = NULL;
+	m_densityCount = m_densityCapacity = 0;
+	m_velocityCount = m_velocityCapacity = 0;
+
+	m_steps = 0;
+	m_checkpoint = NULL;
+}
+
+CFluidSim::~CFluidSim(void)
+{
+	freeFluid();
+	free ( m_densitySources );
+	free ( m_velocitySources );
+}
+
+void CFluidSim::freeFluid(void)
+{
+	if(m_checkpoint)
+	{
+		// Restored fields live in the checkpoint's mapping
+		delete m_checkpoint;
+		m_checkpoint = NULL;
+	}
+	else
+	{
+		free_velocity ( m_u, m_v );
+		free_velocity ( m_u_prev, m_v_prev );
+		free_field ( m_dens );
+		free_field ( m_dens_prev );
+	}
+
+	m_u = m_v = m_u_prev = m_v_prev = m_dens = m_dens_prev = NULL;
+}
+
+void CFluidSim::clearFluid(void)
+{
+	int i, size=FIELD_SIZE(N);
+
+	for ( i=0 ; i<size ; i++ ) {
+		m_dens[i] = m_dens_prev[i] = 0.0f;
+	}
+	clear_velocity ( N, m_u, m_v );
+	clear_velocity ( N, m_u_prev, m_v_prev );
+}
+
+// Appends to a source list, doubling it when full. A source that does not fit is dropped
+static void appendSource(tSource *&list, int &count, int &capacity, int cell, float a, float b)
+{
+	if(count == capacity)
+	{
+		int grown = capacity ? 2*capacity : 64;
+		tSource *bigger = (tSource *)realloc ( list, grown*sizeof(tSource) );
+		if(!bigger)
+			return;
+		list = bigger;
+		capacity = grown;
+	}
+	list[count].cell = cell;
+	list[count].a = a;
+	list[count].b = b;
+	count++;
+}
+
+void CFluidSim::addDensitySource(int i, int j, float amount)
+{
+	appendSource(m_densitySources, m_densityCount, m_densityCapacity, IX(i,j), amount, 0.0f);
+}
+
+void CFluidSim::addVelocitySource(int i, int j, float u, float v)
+{
+	appendSource(m_velocitySources, m_velocityCount, m_velocityCapacity, VIX(i,j), u, v);
+}
+
+int CFluidSim::allocateFluid(int n)
+{
+	freeFluid();
+
+	N = n;
+	m_steps = 0;
+	clearSources();
+	allocate_velocity ( N, &m_u, &m_v );
+	allocate_velocity ( N, &m_u_prev, &m_v_prev );
+	m_dens		= allocate_field ( N );
+	m_dens_prev	= allocate_field ( N );
+
+	if ( !m_u || !m_v || !m_u_prev || !m_v_prev || !m_dens || !m_dens_prev ) {
+		//fprintf ( stderr, "cannot allocate data\n" );
+		return ( 0 );
+	}
+
+	return ( 1 );
+}
+
+void CFluidSim::step(float dt)
+{
+	PROFILE_ZONE("sim step");
+	int k, dense = FIELD_SIZE(N)/SOURCE_DENSE_FRACTION;
+	{
+		CStageTimer stage(m_times, eStageVelocity);
+		if(m_velocityCount > dense)
+		{
+			// The article's way, the sources as a whole field
+			clear_velocity ( N, m_u_prev, m_v_prev );
+			for(k = 0; k < m_velocityCount; k++)
+			{
+				m_u_prev[m_velocitySources[k].cell] += m_velocitySources[k].a;
+				m_v_prev[m_velocitySources[k].cell] += m_velocitySources[k].b;
+			}
+			vel_step ( N, m_u, m_v, m_u_prev, m_v_prev, m_visc, dt );
+		}
+		else
+			vel_step_sparse ( N, m_u, m_v, m_u_prev, m_v_prev, m_velocitySources, m_velocityCount, m_visc, dt );
+	}
+	{
+		CStageTimer stage(m_times, eStageDensity);
+		if(m_densityCount > dense)
+		{
+			int i, size = FIELD_SIZE(N);
+			for(i = 0; i < size; i++)
+				m_dens_prev[i] = 0.0f;
+			for(k = 0; k < m_densityCount; k++)
+				m_dens_prev[m_densitySources[k].cell] += m_densitySources[k].a;
+			dens_step ( N, m_dens, m_dens_prev, m_u, m_v, m_diff, dt );
+		}
+		else
+			dens_step_sparse ( N, m_dens, m_dens_prev, m_densitySources, m_densityCount, m_u, m_v, m_diff, dt );
+	}
+	clearSources();
+	m_steps++;
+}
+
+void CFluidSim::measure(float dt, tFieldMetrics &metrics) const
+{
+	int i, j;
+	double mass = 0.0, divergence = 0.0, residual = 0.0;
+	float maxSpeed2 = 0.0f;
+
+	// project(u, v, p, div) runs last in vel_step with p and div in the previous velocity
+	const float *u = m_u, *v = m_v, *p = m_u_prev, *div = m_v_prev;
+
+	FOR_EACH_CELL
+		mass += m_dens[IX(i,j)];
+
+		float speed2 = u[VIX(i,j)]*u[VIX(i,j)] + v[VIX(i,j)]*v[VIX(i,j)];
+		if ( speed2 > maxSpeed2 ) maxSpeed2 = speed2;
+
+		float d = -0.5f*(u[VIX(i+1,j)]-u[VIX(i-1,j)]+v[VIX(i,j+1)]-v[VIX(i,j-1)])/N;
+		divergence += d*d;
+
+		// lin_solve ( N, 0, p, div, 1, 4 ) solves 4p - (the four neighbours) = div
+		float r = div[VIX(i,j)] - (4*p[VIX(i,j)] - (p[VIX(i-1,j)]+p[VIX(i+1,j)]+p[VIX(i,j-1)]+p[VIX(i,j+1)]));
+		residual += r*r;
+	END_FOR
+
+	double cells = (double)N*N;
+	metrics.mass		= mass;
+	metrics.maxSpeed	= sqrt((double)maxSpeed2);
+	metrics.cfl			= metrics.maxSpeed*dt*N;
+	metrics.divergence	= sqrt(divergence/cells);
+	metrics.residual	= sqrt(residual/cells);
+}
+
+long long CFluidSim::getFieldBytes(void) const
+{
+#if VELOCITY_LAYOUT == VELOCITY_LAYOUT_PLANAR
+	long long velocity = 2*(long long)VEL_SIZE(N);
+#else
+	long long velocity = VEL_SIZE(N);
+#endif
+	return (2*velocity + 2*(long long)FIELD_SIZE(N)) * sizeof(float);
+}
+
+void CFluidSim::applyForcing(float dt)
+{
+	PROFILE_ZONE("forcing");
+
+	// The weather is timed where it fires, the forcing stage is the rest (decay and ship)
+	CTimer forcing;
+	double weather = m_times ? m_times->stage[eStageRain] + m_times->stage[eStageWind] + m_times->stage[eStageWaves] : 0.0;
+
+	m_scheduler.advance(dt, onEvent, this);
+
+	if(m_times)
+	{
+		weather = m_times->stage[eStageRain] + m_times->stage[eStageWind] + m_times->stage[eStageWaves] - weather;
+		m_times->stage[eStageForcing] += forcing.GetElapsedSeconds() - weather;
+	}
+}
+
+void CFluidSim::onEvent(void *context, int event, float period)
+{
+	CFluidSim &sim = *(CFluidSim *)context;
+	switch(event)
+	{
+	case eSimEventDecay:
+		sim.decay();
+		break;
+	case eSimEventShip:
+		sim.m_ship.sample(sim.m_dens, sim.m_u, sim.m_v);
+		sim.m_ship.update(period);
+		break;
+	case eSimEventRain:
+		if(sim.m_bDrawRain)
+		{
+			CStageTimer stage(sim.m_times, eStageRain);
+			sim.m_weather.applyRain(sim.m_dens, sim.m_u, sim.m_v, sim.m_random);
+		}
+		break;
+	case eSimEventWind:
+		if(sim.m_bDrawWind)
+		{
+			CStageTimer stage(sim.m_times, eStageWind);
+			sim.m_weather.applyWind(sim.m_u, sim.m_v, sim.m_random);
+		}
+		break;
+	case eSimEventWaves:
+		if(sim.m_bDrawWaves)
+		{
+			CStageTimer stage(sim.m_times, eStageWaves);
+			sim.m_weather.applyWaves(sim.m_dens, sim.m_u, sim.m_v, sim.m_random);
+		}
+		break;
+	}
+}
+
+void CFluidSim::decay(void)
+{
+	PROFILE_ZONE("decay");
+	int i, j;
+
+	// Every cell with anything in it loses the rate, once a DECAY_TIME
+	FOR_EACH_CELL
+		if(m_dens[IX(i,j)] > 0.01f)
+			m_dens[IX(i,j)] -= m_decayRate;
+	END_FOR
+}
+
+void CFluidSim::injectDensity(void)
+{
+	// Keep the splat (3 cells out, plus the helper's ring) inside the grid
+	int i = m_random.below(N-7) + 4;
+	int j = m_random.below(N-7) + 4;
+	float x = m_random.below(100) / 100;
+
+	x+=0.1f;
+	injectDensityHelper(i-3,j-3, x);
+	injectDensityHelper(i+3,j-3, x);
+	injectDensityHelper(i-3,j+3, x);
+	injectDensityHelper(i+3,j+3, x);
+	x+=0.1f;
+	injectDensityHelper(i,j+3, x);
+	injectDensityHelper(i+3,j, x);
+	injectDensityHelper(i-3,j, x);
+	injectDensityHelper(i,j-3, x);
+	injectDensityHelper(i,j, x);
+}
+
+void CFluidSim::injectDensityHelper(int i, int j, float x)
+{
+	int it[totalDirectionCount];
+	it[center]		= IX(i,j);
+	it[up]			= IX(i-1,j);
+	it[rightUp]		= IX(i-1,j+1);
+	it[right]		= IX(i,j+1);
+	it[down]		= IX(i+1,j);
+	it[leftDown]	= IX(i+1,j-1);
+	it[left]		= IX(i,j-1);
+	it[leftUp]		= IX(i-1,j-1);
+	it[rightDown]	= IX(i+1,j+1);
+	for(int k = 0; k < 9; k++)
+	{
+		float *target = &(m_dens[it[k]]);
+		if(*target < LIMIT_CUT)
+			*target = m_source*sin(x)/2;
+	}
+}
+
+void CFluidSim::injectVelocity(void)
+{
+	// One draw per statement, the order of calls inside an expression is up to the compiler
+	int i = m_random.below(N);
+	int j = m_random.below(N);
+	m_u[VIX(i, j)] = m_force * m_random.below(50);
+	i = m_random.below(N);
+	j = m_random.below(N);
+	m_v[VIX(i, j)] = m_force * m_random.below(50);
+}
+
+void CFluidSim::thinOut(void)
+{
+	// Two draws a cell, 1000 cells, computed as one batch
+	unsigned int draws[2*THIN_OUT_CELLS];
+	m_random.fill(m_random.reserve(2*THIN_OUT_CELLS), draws, 2*THIN_OUT_CELLS);
+
+	for(int i = 0; i < THIN_OUT_CELLS; i++)
+	{
+		int x = CRandom::below(draws[2*i], N) + 1;
+		int y = CRandom::below(draws[2*i + 1], N) + 1;
+		float density = m_dens[IX(x, y)];
+
+		float thin = 0.0f;
+		if(density < 0.1f)
+			thin = 0.01f;
+		else if(density < 0.3f)
+			thin = 0.1f;
+		else if(density < 0.5f)
+			thin = 0.2f;
+		else if(density < 0.7f)
+			thin = 0.3f;
+		else if(density < 0.9f)
+			thin = 0.4f;
+		else if(density > 1.0f)
+			m_dens[IX(x, y)] = 0.5f;
+
+		m_dens[IX(x, y)] -= thin;
+
+		if(0.0f > density)
+			m_dens[IX(x, y)] = 0.0f;
+	}
+}
+
+void CFluidSim::rainSpreadIncreace(bool increace)
+{
+	// A tick further apart or closer together, one tick apart at the closest
+	float spacing = m_scheduler.getPeriod(eSimEventRain);
+	if(increace)
+		m_scheduler.setPeriod(eSimEventRain, spacing + SCHEDULER_TICK);
+	else if(spacing - SCHEDULER_TICK > 0.5f*SCHEDULER_TICK)
+		m_scheduler.setPeriod(eSimEventRain, spacing - SCHEDULER_TICK);
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include "Def.h"	    // definitions
+#include "Solver.h"		// Stam's solver
+#include "Ship.h"
+#include "Weather.h"
+#include "Random.h"		// counter-based draws
+#include "Scheduler.h"	// the forcing's timers
+#include "FrameStats.h"	// tFrameTimes
+
+class CCheckpoint;
+
+extern int N;
+
+#define SOURCE_DENSE_FRACTION	16	// A step with more sources than the cells/16 adds them as a field
+
+// How often the forcing fires, in sim seconds. The weather is the rate the demo's 128 grid had when the timers
+// counted every vertex of every frame
+#define SHIP_TIME		0.04f
+#define RAIN_TIME		0.00375f
+#define WIND_TIME		0.015f
+#define WAVES_TIME		0.003f
+
+// What applyForcing's scheduler runs, in the order they go when due on the same tick
+enum eSimEvent{eSimEventDecay = 0, eSimEventShip, eSimEventRain, eSimEventWind, eSimEventWaves, totalSimEventCount};
+
+// How healthy the fields are, from CFluidSim::measure
+struct tFieldMetrics
+{
+	double mass;		// Density summed over the grid
+	double maxSpeed;	// Largest |(u,v)|
+	double cfl;			// maxSpeed*dt*N, the most cells anything moves in a step
+	double divergence;	// RMS divergence of the velocity, what the last project left
+	double residual;	// RMS residual of the last project's pressure solve
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Class:	CFluidSim
+//
+// Purpose: Everything that moves the water, with no window or GL behind it: the fields and solver parameters, the
+//			weather forcing and the ship's physics. The demo renders one; the headless runner just steps it.
+//
+// Usage:	allocateFluid(n) sets the global N (the solver macros need it), so there is one grid size per process.
+//			Each frame: add the sources with addDensitySource and addVelocitySource, step(dt), then applyForcing(dt).
+//			applyForcing runs the decay, the ship and the weather at their own rates by sim time, not per cell.
+//			CCheckpoint saves and restores the whole thing.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class CFluidSim
+{
+
+private:
+
+	friend class CCheckpoint;
+
+	CShip		m_ship;
+	CWeather	m_weather;
+	CRandom		m_random;	// Every draw the sim makes, its counter is checkpointed
+
+	CScheduler	m_scheduler;	// The eSimEvent timers, by sim time
+	float	m_decayRate;
+
+	// Weather
+	bool	m_bDrawRain;
+	bool	m_bDrawWind;
+	bool	m_bDrawWaves;
+
+	// Fluid Simulation Variables
+	float	m_diff;
+	float	m_visc;
+	float	m_force;
+	float	m_source;
+
+	float *m_u;
+	float *m_v;
+	float *m_u_prev;
+	float *m_v_prev;
+	float *m_dens;
+	float *m_dens_prev;
+
+	tFrameTimes *m_times;	// Stage times go here when set
+
+	// Sources for the next step, step() takes them and empties the lists
+	tSource		*m_densitySources;
+	int			m_densityCount;
+	int			m_densityCapacity;
+	tSource		*m_velocitySources;
+	int			m_velocityCount;
+	int			m_velocityCapacity;
+
+	long long	m_steps;		// step() calls since the fields were allocated
+	CCheckpoint	*m_checkpoint;	// The mapping the fields point into after a restore, NULL when they are allocated
+
+	CFluidSim(const CFluidSim&);
+	CFluidSim&operator = (const CFluidSim&);
+
+	// The scheduler's handler, period is the event's own dt
+	static void onEvent(void *context, int event, float period);
+	void decay(void);
+
+public:
+
+	CFluidSim(void);
+	~CFluidSim(void);
+
+	int  allocateFluid(int n);
+	void freeFluid(void);
+	void clearFluid(void);
+
+	// Sources for the next step, added at the cell's value times dt. A few cells cost a few writes; past
+	// SOURCE_DENSE_FRACTION of the grid they are added as a field like the article does. clearSources drops them
+	void addDensitySource(int i, int j, float amount);
+	void addVelocitySource(int i, int j, float u, float v);
+	void clearSources(void)	{ m_densityCount = m_velocityCount = 0; }
+	int  getSourceCount(void) const	{ return m_densityCount + m_velocityCount; }
+
+	void step(float dt);
+	void applyForcing(float dt);
+	long long getSteps(void) const	{ return m_steps; }
+
+	// Starts the sim's own sequence over, other sims and rand() are not touched
+	void seedRandom(unsigned int seed)	{ m_random.seed(seed); }
+	unsigned int getSeed(void) const	{ return m_random.getSeed(); }
+	CRandom &getRandom(void)			{ return m_random; }
+
+	// The velocity, density, forcing and weather stages add their times here, NULL stops timing them
+	void setFrameTimes(tFrameTimes *times)	{ m_times = times; }
+
+	// One pass over the grid. The pressure and divergence of the last project are still in the previous velocity, so
+	// call it after step() and before the next one
+	void measure(float dt, tFieldMetrics &metrics) const;
+	long long getFieldBytes(void) const;
+
+	void thinOut(void);
+	void injectDensity(void);
+	void injectDensityHelper(int i, int j, float x);
+	void injectVelocity(void);
+
+	// Fields
+	float *getDensity(void)		{ return m_dens; }
+	float *getDensityPrev(void)	{ return m_dens_prev; }
+	float *getU(void)			{ return m_u; }
+	float *getV(void)			{ return m_v; }
+	float *getUPrev(void)		{ return m_u_prev; }
+	float *getVPrev(void)		{ return m_v_prev; }
+
+	// Parameters
+	void  setParams(float diff, float visc, float force, float source) { m_diff = diff; m_visc = visc; m_force = force; m_source = source; }
+	float getForce(void)		{ return m_force; }
+	float getSource(void)		{ return m_source; }
+
+	// Weather
+	void rainIntensityIncreace(bool increace)	{ m_weather.intensityIncreace(increace); }
+	void rainSpreadIncreace(bool increace);
+	void rainToggle(void)		{ m_bDrawRain = !m_bDrawRain; }
+	void windToggle(void)		{ m_bDrawWind = !m_bDrawWind; }
+	void wavesToggle(void)		{ m_bDrawWaves = !m_bDrawWaves; }
+	int getWindDirection(void)	{ return m_weather.getWindDirection(); }
+
+	// Ship
+	CShip &getShip(void)			{ return m_ship; }
+	void changeHeading(float there)	{ m_ship.changeHeading(there); }
+	void engage(float go)			{ m_ship.engage(go); }
+	void toTheSails(void)			{ m_ship.toTheSails(); }
+	void resetShip(void)			{ m_ship.resetPos(); }
+};
@@ -0,0 +1,735 @@
+#include "SoftRenderer.h"
+#include "Profiler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define BATCH_SHIFT		27	// A bin entry is the batch above this bit and its triangle below
+#define BATCH_TRIANGLES	(1 << BATCH_SHIFT)
+
+#define CLIP_NEAR		64	// Outcode bits, the near plane's is the one that needs clipping
+
+struct tRasterVertex
+{
+	float	clip[4];
+	float	color[3];	// Lit, 0 to 255
+};
+
+// A triangle as the tiles fill it, each value a plane a dx + b dy + c over the pixel centres' offsets from its first
+// corner. From there rather than the window's origin the c are the corner's own values, where a' x + b' y + c'
+// would lose a sliver reaching far off screen to the rounding of c'
+struct tRasterTriangle
+{
+	float	origin[2];
+	float	edge[3][3];		// The weight of each corner, all three >= 0 inside
+	float	depth[3];
+	float	color[3][3];
+	int		box[4];			// Pixels it may cover, x0, y0, x1, y1 inclusive
+};
+
+struct tRasterBin
+{
+	unsigned int	*refs;
+	int				count;
+	int				capacity;
+};
+
+struct tRasterBatch
+{
+	tRasterTriangle	*triangles;	// The frame's, from every draw
+	int				count;
+	int				capacity;
+	tRasterBin		*bins;		// Per tile, the current draw's, emptied into the frame's after it
+};
+
+// Room for needed, doubling. Returns false (the array as it was) when out of memory
+template<class T> static bool grow(T *&array, int &capacity, int needed)
+{
+	if(needed <= capacity)
+		return true;
+	int wanted = capacity ? capacity : 64;
+	while(wanted < needed)
+		wanted *= 2;
+	T *grown = (T *)realloc ( array, (size_t)wanted*sizeof(T) );
+	if(!grown)
+		return false;
+	array = grown;
+	capacity = wanted;
+	return true;
+}
+
+static inline void push(tRasterBin &bin, unsigned int ref)
+{
+	if(grow(bin.refs, bin.capacity, bin.count + 1))
+		bin.refs[bin.count++] = ref;
+}
+
+static inline int outcode(const float clip[4])
+{
+	float w = clip[3];
+	return (clip[0] < -w) | (clip[0] > w) << 1 | (clip[1] < -w) << 2 | (clip[1] > w) << 3 | (clip[2] > w) << 4 |
+		(clip[2] < -w ? CLIP_NEAR : 0);
+}
+
+CSoftRenderer::CSoftRenderer(void)
+{
+	m_color		= NULL;
+	m_depth		= NULL;
+	m_tilesX	= m_tilesY = 0;
+	m_vertices	= NULL;
+	m_used		= NULL;
+	m_vertexCapacity = 0;
+	m_batches	= (tRasterBatch *) calloc ( SOFT_BATCHES, sizeof(tRasterBatch) );
+	m_bins		= NULL;
+	resize(WINDOW_WIDTH, WINDOW_HEIGHT);
+}
+
+CSoftRenderer::~CSoftRenderer(void)
+{
+	freeTargets();
+	free ( m_batches );
+	free ( m_vertices );
+	free ( m_used );
+}
+
+void CSoftRenderer::freeTargets(void)
+{
+	int tiles = m_tilesX*m_tilesY;
+	for(int t = 0; m_bins && t < tiles; t++)
+		free ( m_bins[t].refs );
+	for(int b = 0; m_batches && b < SOFT_BATCHES; b++)
+	{
+		for(int t = 0; m_batches[b].bins && t < tiles; t++)
+			free ( m_batches[b].bins[t].refs );
+		free ( m_batches[b].bins );
+		free ( m_batches[b].triangles );
+		memset ( &m_batches[b], 0, sizeof(m_batches[b]) );
+	}
+	free ( m_bins );
+	free ( m_color );
+	free ( m_depth );
+	m_bins	= NULL;
+	m_color	= NULL;
+	m_depth	= NULL;
+	m_tilesX = m_tilesY = 0;
+}
+
+void CSoftRenderer::resize(int width, int height)
+{
+	CRenderBackend::resize(width, height);
+	freeTargets();
+	if(!m_batches)
+		return;
+
+	m_tilesX	= (m_width + SOFT_TILE - 1)/SOFT_TILE;
+	m_tilesY	= (m_height + SOFT_TILE - 1)/SOFT_TILE;
+	int tiles	= m_tilesX*m_tilesY;
+	m_color		= (unsigned int *) malloc ( (size_t)m_width*m_height*sizeof(*m_color) );
+	m_depth		= (float *) malloc ( (size_t)m_width*m_height*sizeof(*m_depth) );
+	m_bins		= (tRasterBin *) calloc ( tiles, sizeof(tRasterBin) );
+	bool ok = m_color && m_depth && m_bins;
+	for(int b = 0; b < SOFT_BATCHES; b++)
+	{
+		m_batches[b].bins = (tRasterBin *) calloc ( tiles, sizeof(tRasterBin) );
+		ok = ok && m_batches[b].bins;
+	}
+	if(!ok)
+		freeTargets();	// getPixels() says so, and every draw is skipped
+}
+
+void CSoftRenderer::beginFrame(void)
+{
+	CRenderBackend::beginFrame();
+	if(!m_color)
+		return;
+	int tiles = m_tilesX*m_tilesY;
+	for(int t = 0; t < tiles; t++)
+		m_bins[t].count = 0;
+	for(int b = 0; b < SOFT_BATCHES; b++)
+		m_batches[b].count = 0;
+}
+
+void CSoftRenderer::clipMatrix(const float model[16], float toClip[16]) const
+{
+	multiply(m_projection, m_view, toClip);
+	multiply(toClip, model, toClip);
+}
+
+bool CSoftRenderer::reserve(int vertices)
+{
+	if(!grow(m_vertices, m_vertexCapacity, vertices))
+		return false;
+	unsigned char *used = (unsigned char *) realloc ( m_used, m_vertexCapacity );
+	if(!used)
+		return false;
+	m_used = used;
+	return true;
+}
+
+void CSoftRenderer::transform(const tRenderMesh &mesh, const float model[16])
+{
+	PROFILE_ZONE("soft transform");
+	float toClip[16];
+	clipMatrix(model, toClip);
+
+	// Normals go through the inverse transpose of the model's 3x3, whose columns are the crossed columns over the
+	// determinant. Not renormalized, GL_NORMALIZE is off
+	const float *a = model, *b = model + 4, *c = model + 8;
+	float normal[3][3] = {
+		{ b[1]*c[2] - b[2]*c[1], b[2]*c[0] - b[0]*c[2], b[0]*c[1] - b[1]*c[0] },
+		{ c[1]*a[2] - c[2]*a[1], c[2]*a[0] - c[0]*a[2], c[0]*a[1] - c[1]*a[0] },
+		{ a[1]*b[2] - a[2]*b[1], a[2]*b[0] - a[0]*b[2], a[0]*b[1] - a[1]*b[0] } };
+	float det = a[0]*normal[0][0] + a[1]*normal[0][1] + a[2]*normal[0][2];
+	float invDet = det != 0.0f ? 1.0f/det : 0.0f;
+
+	unsigned char single[4];
+	memcpy ( single, &mesh.color, sizeof(single) );
+	bool lit = m_bLighting && mesh.normals;
+
+	// A level of detail index list reaches a fraction of the vertices, only light those
+	int n = mesh.vertexCount, v;
+	bool sparse = mesh.indexCount < n;
+	if(sparse)
+	{
+		memset ( m_used, 0, n );
+		for(int k = 0; k < mesh.indexCount; k++)
+		{
+			if((unsigned int)mesh.indices[k] < (unsigned int)n)
+				m_used[mesh.indices[k]] = 1;
+		}
+	}
+
+	#pragma omp parallel for schedule(static, 4096)
+	for (v = 0; v < n; v++)
+	{
+		if(sparse && !m_used[v])
+			continue;
+		const float *p = mesh.vertices + 3*v;
+		tRasterVertex &out = m_vertices[v];
+		for(int r = 0; r < 4; r++)
+			out.clip[r] = toClip[r]*p[0] + toClip[4 + r]*p[1] + toClip[8 + r]*p[2] + toClip[12 + r];
+
+		const unsigned char *rgba = mesh.colors ? mesh.colors + (size_t)v*mesh.colorStride : single;
+		if(!lit)
+		{
+			for(int k = 0; k < 3; k++)
+				out.color[k] = (float)rgba[k];
+			continue;
+		}
+
+		float world[3], n3[3], diffuse[3] = { 0.0f, 0.0f, 0.0f };
+		const float *q = mesh.normals + 3*v;
+		for(int r = 0; r < 3; r++)
+		{
+			world[r]	= model[r]*p[0] + model[4 + r]*p[1] + model[8 + r]*p[2] + model[12 + r];
+			n3[r]		= (normal[0][r]*q[0] + normal[1][r]*q[1] + normal[2][r]*q[2])*invDet;
+		}
+		for(int l = 0; l < RENDER_LIGHTS; l++)
+		{
+			const tRenderLight &light = m_lights[l];
+			float d[3] = { light.position[0] - world[0], light.position[1] - world[1], light.position[2] - world[2] };
+			float length = (float)sqrt(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]);
+			float facing = n3[0]*d[0] + n3[1]*d[1] + n3[2]*d[2];
+			if(facing <= 0.0f || length <= 0.0f)
+				continue;
+			facing /= length;
+			for(int k = 0; k < 3; k++)
+				diffuse[k] += light.diffuse[k]*facing;
+		}
+		for(int k = 0; k < 3; k++)
+		{
+			float channel = 255.0f*RENDER_AMBIENT + rgba[k]*diffuse[k];
+			out.color[k] = channel < 255.0f ? channel : 255.0f;
+		}
+	}
+}
+
+// The point s of the way from a to b, where the near plane crosses
+static inline void cut(const tRasterVertex &a, const tRasterVertex &b, float s, tRasterVertex &out)
+{
+	for(int c = 0; c < 4; c++)
+		out.clip[c] = a.clip[c] + s*(b.clip[c] - a.clip[c]);
+	for(int c = 0; c < 3; c++)
+		out.color[c] = a.color[c] + s*(b.color[c] - a.color[c]);
+}
+
+// Projects a triangle in clip space to the window and bins it into batch (number id), if its box holds a pixel centre
+static void emit(tRasterBatch &batch, int id, const tRasterVertex *v[3], int width, int height, int tilesX)
+{
+	float x[3], y[3], z[3];
+	for(int k = 0; k < 3; k++)
+	{
+		float invW = 1.0f/v[k]->clip[3];
+		x[k] = (v[k]->clip[0]*invW*0.5f + 0.5f)*width;
+		y[k] = (0.5f - v[k]->clip[1]*invW*0.5f)*height;
+		z[k] = v[k]->clip[2]*invW*0.5f + 0.5f;
+	}
+
+	float area = (x[2] - x[1])*(y[0] - y[1]) - (y[2] - y[1])*(x[0] - x[1]);
+	if(!(fabs(area) > 1e-8f))
+		return;
+
+	// The pixels whose centres are inside the box, clamped to the window before anything turns into an int
+	float lo[2] = { x[0], y[0] }, hi[2] = { x[0], y[0] };
+	for(int k = 1; k < 3; k++)
+	{
+		lo[0] = x[k] < lo[0] ? x[k] : lo[0];	hi[0] = x[k] > hi[0] ? x[k] : hi[0];
+		lo[1] = y[k] < lo[1] ? y[k] : lo[1];	hi[1] = y[k] > hi[1] ? y[k] : hi[1];
+	}
+	if(hi[0] < 0.0f || hi[1] < 0.0f || lo[0] > (float)width || lo[1] > (float)height)
+		return;
+	int box[4] = {
+		lo[0] > 0.0f ? (int)ceil(lo[0] - 0.5f) : 0,
+		lo[1] > 0.0f ? (int)ceil(lo[1] - 0.5f) : 0,
+		hi[0] < (float)width ? (int)floor(hi[0] - 0.5f) : width - 1,
+		hi[1] < (float)height ? (int)floor(hi[1] - 0.5f) : height - 1 };
+	if(box[0] > box[2] || box[1] > box[3] || batch.count >= BATCH_TRIANGLES ||
+		!grow(batch.triangles, batch.capacity, batch.count + 1))
+		return;
+
+	tRasterTriangle &t = batch.triangles[batch.count];
+	float scale = 1.0f/area;
+	for(int k = 0; k < 3; k++)
+	{
+		// The edge opposite corner k, as a function of the pixel that is area at the corner
+		int a = (k + 1) % 3, b = (k + 2) % 3;
+		t.edge[k][0] = -(y[b] - y[a])*scale;
+		t.edge[k][1] = (x[b] - x[a])*scale;
+		t.edge[k][2] = k == 0 ? 1.0f : 0.0f;
+	}
+	t.origin[0] = x[0];
+	t.origin[1] = y[0];
+	for(int c = 0; c < 3; c++)
+	{
+		t.depth[c] = z[0]*t.edge[0][c] + z[1]*t.edge[1][c] + z[2]*t.edge[2][c];
+		for(int k = 0; k < 3; k++)
+			t.color[k][c] = v[0]->color[k]*t.edge[0][c] + v[1]->color[k]*t.edge[1][c] + v[2]->color[k]*t.edge[2][c];
+	}
+	memcpy ( t.box, box, sizeof(box) );
+
+	// Into the tiles it reaches. A long thin one's box holds many it never touches: those have every pixel centre
+	// outside one of the edges, at the corner furthest inside it too. The tiles are taken a pixel wider each side
+	// for the rounding, as the fill's runs are
+	unsigned int ref = (unsigned int)id << BATCH_SHIFT | (unsigned int)batch.count;
+	for(int ty = box[1]/SOFT_TILE; ty <= box[3]/SOFT_TILE; ty++)
+	{
+		float top = ty*SOFT_TILE - 0.5f - t.origin[1], bottom = top + SOFT_TILE + 1.0f;
+		for(int tx = box[0]/SOFT_TILE; tx <= box[2]/SOFT_TILE; tx++)
+		{
+			float left = tx*SOFT_TILE - 0.5f - t.origin[0], right = left + SOFT_TILE + 1.0f;
+			bool touches = true;
+			for(int k = 0; k < 3 && touches; k++)
+			{
+				const float *e = t.edge[k];
+				touches = e[0]*(e[0] > 0.0f ? right : left) + e[1]*(e[1] > 0.0f ? bottom : top) + e[2] >= 0.0f;
+			}
+			if(touches)
+				push(batch.bins[ty*tilesX + tx], ref);
+		}
+	}
+	batch.count++;
+}
+
+void CSoftRenderer::setup(const tRenderMesh &mesh, int batch)
+{
+	tRasterBatch &out = m_batches[batch];
+	int triangles = mesh.indexCount/3;
+	int t0 = (int)((long long)triangles*batch/SOFT_BATCHES), t1 = (int)((long long)triangles*(batch + 1)/SOFT_BATCHES);
+	for(int t = t0; t < t1; t++)
+	{
+		const int *index = mesh.indices + 3*t;
+		if((unsigned int)index[0] >= (unsigned int)mesh.vertexCount || (unsigned int)index[1] >= (unsigned int)mesh.vertexCount ||
+			(unsigned int)index[2] >= (unsigned int)mesh.vertexCount)
+			continue;
+		const tRasterVertex *v[3] = { &m_vertices[index[0]], &m_vertices[index[1]], &m_vertices[index[2]] };
+		int codes[3] = { outcode(v[0]->clip), outcode(v[1]->clip), outcode(v[2]->clip) };
+		if(codes[0] & codes[1] & codes[2])
+			continue;	// Wholly outside one plane
+		if(!((codes[0] | codes[1] | codes[2]) & CLIP_NEAR))
+		{
+			emit(out, batch, v, m_width, m_height, m_tilesX);
+			continue;
+		}
+
+		// Cut at the near plane, z + w = 0, into a polygon of up to four corners and fan it
+		tRasterVertex polygon[4];
+		int corners = 0;
+		for(int k = 0; k < 3; k++)
+		{
+			const tRasterVertex *a = v[k], *b = v[(k + 1) % 3];
+			float da = a->clip[2] + a->clip[3], db = b->clip[2] + b->clip[3];
+			if(da >= 0.0f)
+				polygon[corners++] = *a;
+			if((da >= 0.0f) != (db >= 0.0f))
+				cut(*a, *b, da/(da - db), polygon[corners++]);
+		}
+		for(int k = 1; k + 1 < corners; k++)
+		{
+			const tRasterVertex *fan[3] = { &polygon[0], &polygon[k], &polygon[k + 1] };
+			emit(out, batch, fan, m_width, m_height, m_tilesX);
+		}
+	}
+}
+
+void CSoftRenderer::draw(const tRenderMesh &mesh, const float model[16])
+{
+	PROFILE_ZONE("soft draw");
+	count(mesh);
+	if(!m_color || !mesh.vertices || !mesh.indices || mesh.vertexCount <= 0 || mesh.indexCount < 3)
+		return;
+	if(!reserve(mesh.vertexCount))
+		return;
+
+	transform(mesh, model);
+
+	int batch;
+	#pragma omp parallel for schedule(dynamic)
+	for (batch = 0; batch < SOFT_BATCHES; batch++)
+		setup(mesh, batch);
+	gather();
+}
+
+void CSoftRenderer::setupLines(int lines, int batch)
+{
+	tRasterBatch &out = m_batches[batch];
+	int l0 = (int)((long long)lines*batch/SOFT_BATCHES), l1 = (int)((long long)lines*(batch + 1)/SOFT_BATCHES);
+	for(int l = l0; l < l1; l++)
+	{
+		tRasterVertex a = m_vertices[2*l], b = m_vertices[2*l + 1];
+		if(outcode(a.clip) & outcode(b.clip))
+			continue;
+		float da = a.clip[2] + a.clip[3], db = b.clip[2] + b.clip[3];
+		if(da < 0.0f)
+			cut(a, b, da/(da - db), a);
+		else if(db < 0.0f)
+			cut(b, a, db/(db - da), b);
+
+		// Half a pixel either side, square to the segment on the screen, moved in clip space by each end's w
+		float dx = (b.clip[0]/b.clip[3] - a.clip[0]/a.clip[3])*m_width;
+		float dy = (b.clip[1]/b.clip[3] - a.clip[1]/a.clip[3])*m_height;
+		float length = (float)sqrt(dx*dx + dy*dy);
+		if(!(length > 0.0f))
+			continue;
+		float across[2] = { -dy/length/m_width, dx/length/m_height };
+		tRasterVertex quad[4] = { a, a, b, b };
+		for(int c = 0; c < 2; c++)
+		{
+			quad[0].clip[c] += across[c]*a.clip[3];		quad[1].clip[c] -= across[c]*a.clip[3];
+			quad[2].clip[c] -= across[c]*b.clip[3];		quad[3].clip[c] += across[c]*b.clip[3];
+		}
+		const tRasterVertex *first[3] = { &quad[0], &quad[1], &quad[2] }, *second[3] = { &quad[0], &quad[2], &quad[3] };
+		emit(out, batch, first, m_width, m_height, m_tilesX);
+		emit(out, batch, second, m_width, m_height, m_tilesX);
+	}
+}
+
+void CSoftRenderer::drawLines(const tRenderLines &lines, const float model[16])
+{
+	PROFILE_ZONE("soft lines");
+	count(lines);
+	int n = lines.vertexCount & ~1, v, batch;
+	if(!m_color || !lines.vertices || n < 2 || !reserve(n))
+		return;
+
+	float toClip[16];
+	clipMatrix(model, toClip);
+	unsigned char rgba[4];
+	memcpy ( rgba, &lines.color, sizeof(rgba) );
+
+	#pragma omp parallel for schedule(static, 4096)
+	for (v = 0; v < n; v++)
+	{
+		const float *p = lines.vertices + 3*v;
+		tRasterVertex &out = m_vertices[v];
+		for(int r = 0; r < 4; r++)
+			out.clip[r] = toClip[r]*p[0] + toClip[4 + r]*p[1] + toClip[8 + r]*p[2] + toClip[12 + r];
+		for(int k = 0; k < 3; k++)
+			out.color[k] = (float)rgba[k];
+	}
+
+	#pragma omp parallel for schedule(dynamic)
+	for (batch = 0; batch < SOFT_BATCHES; batch++)
+		setupLines(n/2, batch);
+	gather();
+}
+
+void CSoftRenderer::gather(void)
+{
+	int tile, tiles = m_tilesX*m_tilesY;
+
+	// Into the frame's bins, batch after batch, which keeps every tile's triangles in the order they were drawn
+	#pragma omp parallel for schedule(dynamic)
+	for (tile = 0; tile < tiles; tile++)
+	{
+		tRasterBin &bin = m_bins[tile];
+		for(int b = 0; b < SOFT_BATCHES; b++)
+		{
+			tRasterBin &from = m_batches[b].bins[tile];
+			if(from.count && grow(bin.refs, bin.capacity, bin.count + from.count))
+			{
+				memcpy ( bin.refs + bin.count, from.refs, from.count*sizeof(*from.refs) );
+				bin.count += from.count;
+			}
+			from.count = 0;
+		}
+	}
+}
+
+void CSoftRenderer::fillTile(int tile)
+{
+	int x0 = (tile % m_tilesX)*SOFT_TILE, y0 = (tile / m_tilesX)*SOFT_TILE;
+	int x1 = x0 + SOFT_TILE < m_width ? x0 + SOFT_TILE : m_width;
+	int y1 = y0 + SOFT_TILE < m_height ? y0 + SOFT_TILE : m_height;
+	int x, y;
+
+	tColor background = m_background;
+	background.red *= 255.0f;	background.green *= 255.0f;	background.blue *= 255.0f;
+	unsigned char clear[4] = { (unsigned char)background.red, (unsigned char)background.green, (unsigned char)background.blue, 255 };
+	unsigned int packed;
+	memcpy ( &packed, clear, sizeof(packed) );
+	for (y = y0; y < y1; y++)
+	{
+		for (x = x0; x < x1; x++)
+		{
+			m_color[y*m_width + x] = packed;
+			m_depth[y*m_width + x] = 1.0f;
+		}
+	}
+
+	const tRasterBin &bin = m_bins[tile];
+	for(int r = 0; r < bin.count; r++)
+	{
+		unsigned int ref = bin.refs[r];
+		const tRasterTriangle &t = m_batches[ref >> BATCH_SHIFT].triangles[ref & (BATCH_TRIANGLES - 1)];
+		int bx0 = t.box[0] > x0 ? t.box[0] : x0, bx1 = t.box[2] < x1 - 1 ? t.box[2] : x1 - 1;
+		int by0 = t.box[1] > y0 ? t.box[1] : y0, by1 = t.box[3] < y1 - 1 ? t.box[3] : y1 - 1;
+
+		// The rows inside all three edges somewhere in the tile's columns, each edge taken at the column furthest
+		// inside it and a pixel more each side. A line crossing the tile reaches a few of its rows
+		float left = bx0 + 0.5f - t.origin[0], right = bx1 + 0.5f - t.origin[0];
+		float top = (float)by0, bottom = (float)by1;
+		for(int k = 0; k < 3; k++)
+		{
+			float a = t.edge[k][0], b = t.edge[k][1], best = a*(a > 0.0f ? right : left) + t.edge[k][2];
+			if(b > 0.0f)
+			{
+				float from = t.origin[1] - best/b - 1.5f;
+				top = from > top ? from : top;
+			}
+			else if(b < 0.0f)
+			{
+				float to = t.origin[1] - best/b + 0.5f;
+				bottom = to < bottom ? to : bottom;
+			}
+			else if(best < 0.0f)
+				bottom = top - 1.0f;
+		}
+		if(top > bottom)
+			continue;
+		by0 = (int)top;
+		by1 = (int)bottom;
+
+		float slope[3];
+		for(int k = 0; k < 3; k++)
+			slope[k] = t.edge[k][0] != 0.0f ? 1.0f/t.edge[k][0] : 0.0f;
+		for (y = by0; y <= by1; y++)
+		{
+			// The run of the row inside all three edges, a pixel wider each side for the rounding; the test below
+			// still decides each pixel. A sliver's box is mostly outside it
+			float fy = y + 0.5f - t.origin[1], lo = (float)bx0, hi = (float)bx1;
+			for(int k = 0; k < 3; k++)
+			{
+				float a = t.edge[k][0], rest = t.edge[k][1]*fy + t.edge[k][2];
+				if(a > 0.0f)
+				{
+					float from = t.origin[0] - rest*slope[k] - 1.5f;
+					lo = from > lo ? from : lo;
+				}
+				else if(a < 0.0f)
+				{
+					float to = t.origin[0] - rest*slope[k] + 0.5f;
+					hi = to < hi ? to : hi;
+				}
+				else if(rest < 0.0f)
+					hi = lo - 1.0f;
+			}
+			if(lo > hi)
+				continue;
+			int sx0 = (int)lo, sx1 = (int)hi;
+			float fx = sx0 + 0.5f - t.origin[0];
+			float e0 = t.edge[0][0]*fx + t.edge[0][1]*fy + t.edge[0][2];
+			float e1 = t.edge[1][0]*fx + t.edge[1][1]*fy + t.edge[1][2];
+			float e2 = t.edge[2][0]*fx + t.edge[2][1]*fy + t.edge[2][2];
+			float z  = t.depth[0]*fx + t.depth[1]*fy + t.depth[2];
+			float cr = t.color[0][0]*fx + t.color[0][1]*fy + t.color[0][2];
+			float cg = t.color[1][0]*fx + t.color[1][1]*fy + t.color[1][2];
+			float cb = t.color[2][0]*fx + t.color[2][1]*fy + t.color[2][2];
+			unsigned int *color = m_color + y*m_width;
+			float *depth = m_depth + y*m_width;
+			for (x = sx0; x <= sx1; x++)
+			{
+				if(e0 >= 0.0f && e1 >= 0.0f && e2 >= 0.0f && z < depth[x] && z >= 0.0f)
+				{
+					// Inside the triangle the colour stays between its corners', bar the rounding
+					unsigned char rgba[4] = { (unsigned char)(cr > 0.0f ? (cr < 255.0f ? cr + 0.5f : 255.0f) : 0.0f),
+											  (unsigned char)(cg > 0.0f ? (cg < 255.0f ? cg + 0.5f : 255.0f) : 0.0f),
+											  (unsigned char)(cb > 0.0f ? (cb < 255.0f ? cb + 0.5f : 255.0f) : 0.0f), 255 };
+					depth[x] = z;
+					memcpy ( &color[x], rgba, sizeof(rgba) );
+				}
+				e0 += t.edge[0][0];	e1 += t.edge[1][0];	e2 += t.edge[2][0];
+				z  += t.depth[0];
+				cr += t.color[0][0];	cg += t.color[1][0];	cb += t.color[2][0];
+			}
+		}
+	}
+}
+
+void CSoftRenderer::endFrame(void)
+{
+	PROFILE_ZONE("soft fill");
+	if(!m_color)
+		return;
+	int tile, tiles = m_tilesX*m_tilesY;
+	#pragma omp parallel for schedule(dynamic)
+	for (tile = 0; tile < tiles; tile++)
+		fillTile(tile);
+}
+
+static unsigned int crc32(unsigned int crc, const unsigned char *bytes, size_t count)
+{
+	static unsigned int table[256];
+	static bool ready = false;
+	if(!ready)
+	{
+		for(unsigned int n = 0; n < 256; n++)
+		{
+			unsigned int c = n;
+			for(int k = 0; k < 8; k++)
+				c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+			table[n] = c;
+		}
+		ready = true;
+	}
+	crc = ~crc;
+	for(size_t k = 0; k < count; k++)
+		crc = table[(crc ^ bytes[k]) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+
+static void putBigEndian(unsigned char *out, unsigned int value)
+{
+	out[0] = (unsigned char)(value >> 24);
+	out[1] = (unsigned char)(value >> 16);
+	out[2] = (unsigned char)(value >> 8);
+	out[3] = (unsigned char)value;
+}
+
+// A PNG chunk's length, type, data and CRC, data may be written in pieces after the head with the CRC carried along
+static int writeChunkHead(FILE *file, const char *type, unsigned int length, unsigned int &crc)
+{
+	unsigned char head[8];
+	putBigEndian(head, length);
+	memcpy ( head + 4, type, 4 );
+	crc = crc32(0, head + 4, 4);
+	return fwrite ( head, sizeof(head), 1, file ) == 1;
+}
+
+static int writeChunkData(FILE *file, const unsigned char *data, size_t count, unsigned int &crc)
+{
+	crc = crc32(crc, data, count);
+	return fwrite ( data, 1, count, file ) == count;
+}
+
+static int writeChunkEnd(FILE *file, unsigned int crc)
+{
+	unsigned char tail[4];
+	putBigEndian(tail, crc);
+	return fwrite ( tail, sizeof(tail), 1, file ) == 1;
+}
+
+int CSoftRenderer::save(const char *path) const
+{
+	if(!m_color)
+		return 0;
+	return save(path, m_color, m_width, m_height);
+}
+
+int CSoftRenderer::save(const char *path, const unsigned int *pixels, int width, int height)
+{
+	size_t length = strlen(path);
+	bool png = length >= 4 && !strcmp(path + length - 4, ".png");
+
+	// RGB rows, each with the PNG's filter byte in front (none) when it is one
+	int rowBytes = 3*width + (png ? 1 : 0);
+	unsigned char *rows = (unsigned char *) malloc ( (size_t)rowBytes*height );
+	if(!rows)
+		return 0;
+	for(int y = 0; y < height; y++)
+	{
+		unsigned char *out = rows + (size_t)y*rowBytes;
+		const unsigned char *in = (const unsigned char *)(pixels + (size_t)y*width);
+		if(png)
+			*out++ = 0;
+		for(int x = 0; x < width; x++, in += 4, out += 3)
+		{
+			out[0] = in[0];
+			out[1] = in[1];
+			out[2] = in[2];
+		}
+	}
+
+	FILE *file = fopen ( path, "wb" );
+	if(!file)
+	{
+		free ( rows );
+		return 0;
+	}
+	size_t raw = (size_t)rowBytes*height;
+	int ok;
+	if(!png)
+	{
+		ok = fprintf ( file, "P6\n%d %d\n255\n", width, height ) > 0;
+		ok = ok && fwrite ( rows, 1, raw, file ) == raw;
+	}
+	else
+	{
+		// zlib with stored deflate blocks, no compression needs no library
+		static const unsigned char signature[8] = { 137, 'P', 'N', 'G', '\r', '\n', 26, '\n' };
+		unsigned char header[13];
+		putBigEndian(header, width);
+		putBigEndian(header + 4, height);
+		header[8] = 8;	header[9] = 2;	header[10] = header[11] = header[12] = 0;	// 8 bit RGB
+
+		size_t blocks = (raw + 65534)/65535;
+		unsigned int crc, adlerA = 1, adlerB = 0;
+		ok = fwrite ( signature, sizeof(signature), 1, file ) == 1;
+		ok = ok && writeChunkHead(file, "IHDR", sizeof(header), crc) && writeChunkData(file, header, sizeof(header), crc) &&
+			writeChunkEnd(file, crc);
+
+		static const unsigned char zlib[2] = { 0x78, 0x01 };
+		ok = ok && writeChunkHead(file, "IDAT", (unsigned int)(2 + 5*blocks + raw + 4), crc) &&
+			writeChunkData(file, zlib, sizeof(zlib), crc);
+		for(size_t at = 0; ok && at < raw; at += 65535)
+		{
+			size_t count = raw - at < 65535 ? raw - at : 65535;
+			unsigned char block[5] = { (unsigned char)(at + count == raw), (unsigned char)count, (unsigned char)(count >> 8),
+									   (unsigned char)~count, (unsigned char)(~count >> 8) };
+			ok = writeChunkData(file, block, sizeof(block), crc) && writeChunkData(file, rows + at, count, crc);
+			for(size_t k = 0; k < count; k++)
+			{
+				adlerA = (adlerA + rows[at + k]) % 65521;
+				adlerB = (adlerB + adlerA) % 65521;
+			}
+		}
+		unsigned char adler[4];
+		putBigEndian(adler, adlerB << 16 | adlerA);
+		ok = ok && writeChunkData(file, adler, sizeof(adler), crc) && writeChunkEnd(file, crc);
+		ok = ok && writeChunkHead(file, "IEND", 0, crc) && writeChunkEnd(file, crc);
+	}
+	ok = fclose ( file ) == 0 && ok;
+	free ( rows );
+	return ok;
+}
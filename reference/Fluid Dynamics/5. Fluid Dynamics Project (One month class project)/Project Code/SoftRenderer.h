@@ -0,0 +1,74 @@
+#pragma once
+
+#include "Renderer.h"
+
+#define SOFT_TILE		64	// Pixels a side of the screen tiles the triangles are binned into and filled by
+#define SOFT_BATCHES	32	// Parts a draw's triangles are set up in, a power of two, whatever the thread count
+
+struct tRasterVertex;
+struct tRasterTriangle;
+struct tRasterBin;
+struct tRasterBatch;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Class:	"CSoftRenderer"
+//
+// Purpose: Draws the scene on the CPU into an RGBA8 image with a depth buffer, so the frames can be timed, compared and
+//			looked at on machines with no GL. It is a tiled rasterizer, all three stages run on every thread:
+//			draw() lights and projects the vertices the mesh uses (Gouraud, as fixed function GL), then sets up its
+//			triangles in SOFT_BATCHES parts, clipping at the near plane, and bins each one into the SOFT_TILE tiles
+//			its box covers. endFrame() clears and fills the tiles, one at a time on each thread, so no two threads
+//			ever write the same pixel. A tile fills its triangles in the order they were drawn, which makes the
+//			image the same whatever the number of threads. No back faces are culled and there is no wire frame,
+//			the demo enables neither. Lines go in as two triangles each, a pixel wide across the segment.
+//
+// Usage:	As any CRenderBackend, then getPixels() or save() after endFrame().
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class CSoftRenderer :
+	public CRenderBackend
+{
+
+private:
+
+	unsigned int	*m_color;		// RGBA8 rows, the top one first
+	float			*m_depth;		// Window depth, 0 to 1
+	int				m_tilesX;
+	int				m_tilesY;
+
+	tRasterVertex	*m_vertices;	// The current draw's, lit and in clip space
+	unsigned char	*m_used;		// Vertices the current draw's indices reach
+	int				m_vertexCapacity;
+
+	tRasterBatch	*m_batches;		// SOFT_BATCHES of them, each with its triangles and a bin per tile
+	tRasterBin		*m_bins;		// Per tile, the frame's triangles in draw order
+
+	void freeTargets(void);
+	bool reserve(int vertices);
+	void clipMatrix(const float model[16], float toClip[16]) const;
+	void transform(const tRenderMesh &mesh, const float model[16]);
+	void setup(const tRenderMesh &mesh, int batch);
+	void setupLines(int lines, int batch);
+	void gather(void);
+	void fillTile(int tile);
+
+	CSoftRenderer(const CSoftRenderer&);
+	CSoftRenderer&operator = (const CSoftRenderer&);
+
+public:
+
+	CSoftRenderer(void);
+	~CSoftRenderer(void);
+
+	void resize(int width, int height);
+	void beginFrame(void);
+	void endFrame(void);
+	void draw(const tRenderMesh &mesh, const float model[16]);
+	void drawLines(const tRenderLines &lines, const float model[16]);
+
+	// The last frame, RGBA8, getWidth() a row and the top row first. NULL when out of memory
+	const unsigned char *getPixels(void) const	{ return (const unsigned char *)m_color; }
+	// Binary PPM, or PNG (stored, uncompressed) when path ends in .png. Returns 0 if it cannot be written
+	int save(const char *path) const;
+	// The same for any RGBA8 image, width a row and the top row first, alpha left out
+	static int save(const char *path, const unsigned int *pixels, int width, int height);
+};
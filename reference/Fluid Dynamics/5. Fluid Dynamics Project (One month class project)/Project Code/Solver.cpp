@@ -0,0 +1,338 @@
+#include "Solver.h"
+#include "Profiler.h"
+
+#include <stdlib.h>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+// Scalar fields are indexed with IX, velocity components (and the scratch fields that share
+// their storage in vel_step) with VIX. The kernels are written once against either; in the
+// planar layout both are the same thing.
+struct tScalarIndex   { static inline int at(int N, int i, int j) { return IX(i,j); } };
+struct tVelocityIndex { static inline int at(int N, int i, int j) { return VIX(i,j); } };
+
+#define AT(i,j) I::at(N,i,j)
+
+////////////////////////////////////////////////////////////////
+// Kernels
+// Passes where every cell only reads the other fields (add_source, advect, the divergence and
+// gradient in project) are split across OpenMP threads, which gives the same result at any
+// thread count. Gauss-Seidel in lin_solve reads cells it has just written, so it and the O(N)
+// boundary passes stay serial.
+
+// The ghost rows are written as contiguous runs, then both ghost columns in one forward
+// sweep over the rows so each row's line is visited once rather than once per column
+template <class I>
+static void set_bnd_t ( int N, int b, float * x )
+{
+	int i, j;
+	float sx = b==1 ? -1.0f : 1.0f; // Across the left and right walls
+	float sy = b==2 ? -1.0f : 1.0f; // Across the top and bottom walls
+
+	for ( i=1 ; i<=N ; i++ ) {
+		x[AT(i,0  )] = sy*x[AT(i,1)];
+		x[AT(i,N+1)] = sy*x[AT(i,N)];
+	}
+	for ( j=1 ; j<=N ; j++ ) {
+		x[AT(0  ,j)] = sx*x[AT(1,j)];
+		x[AT(N+1,j)] = sx*x[AT(N,j)];
+	}
+	x[AT(0  ,0  )] = 0.5f*(x[AT(1,0  )]+x[AT(0  ,1)]);
+	x[AT(0  ,N+1)] = 0.5f*(x[AT(1,N+1)]+x[AT(0  ,N)]);
+	x[AT(N+1,0  )] = 0.5f*(x[AT(N,0  )]+x[AT(N+1,1)]);
+	x[AT(N+1,N+1)] = 0.5f*(x[AT(N,N+1)]+x[AT(N+1,N)]);
+}
+
+template <class I>
+static void lin_solve_t ( int N, int b, float * x, float * x0, float a, float c )
+{
+	int i, j, k;
+
+	for ( k=0 ; k<LIN_SOLVE_ITERATIONS ; k++ ) {
+		FOR_EACH_CELL
+			x[AT(i,j)] = (x0[AT(i,j)] + a*(x[AT(i-1,j)]+x[AT(i+1,j)]+x[AT(i,j-1)]+x[AT(i,j+1)]))/c;
+		END_FOR
+		set_bnd_t<I> ( N, b, x );
+	}
+}
+
+// Advects the field d (indexed by I) through the velocity (u,v)
+template <class I>
+static void advect_t ( int N, int b, float * d, float * d0, float * u, float * v, float dt )
+{
+	int i, j, i0, j0, i1, j1;
+	float x, y, s0, t0, s1, t1, dt0;
+
+	dt0 = dt*N;
+	#pragma omp parallel for private(i,j,i0,j0,i1,j1,x,y,s0,t0,s1,t1)
+	FOR_EACH_CELL
+		x = i-dt0*u[VIX(i,j)]; y = j-dt0*v[VIX(i,j)];
+		if (x<0.5f) x=0.5f; if (x>N+0.5f) x=N+0.5f; i0=(int)x; i1=i0+1;
+		if (y<0.5f) y=0.5f; if (y>N+0.5f) y=N+0.5f; j0=(int)y; j1=j0+1;
+		s1 = x-i0; s0 = 1-s1; t1 = y-j0; t0 = 1-t1;
+		d[AT(i,j)] = s0*(t0*d0[AT(i0,j0)]+t1*d0[AT(i0,j1)])+
+					 s1*(t0*d0[AT(i1,j0)]+t1*d0[AT(i1,j1)]);
+	END_FOR
+	set_bnd_t<I> ( N, b, d );
+}
+
+#undef AT
+
+////////////////////////////////////////////////////////////////
+// Solver Functions
+
+void add_source ( int N, float * RESTRICT x, float * RESTRICT s, float dt )
+{
+	PROFILE_ZONE("add_source");
+	int i, size=FIELD_SIZE(N);
+	#pragma omp parallel for
+	for ( i=0 ; i<size ; i++ ) x[i] += dt*s[i];
+}
+
+void set_bnd ( int N, int b, float * x )
+{
+	set_bnd_t<tScalarIndex> ( N, b, x );
+}
+
+void lin_solve ( int N, int b, float * x, float * x0, float a, float c )
+{
+	PROFILE_ZONE("lin_solve");
+	lin_solve_t<tScalarIndex> ( N, b, x, x0, a, c );
+}
+
+void diffuse ( int N, int b, float * x, float * x0, float diff, float dt )
+{
+	PROFILE_ZONE("diffuse");
+	float a=dt*diff*N*N;
+	lin_solve ( N, b, x, x0, a, 1+4*a );
+}
+
+void advect ( int N, int b, float * d, float * d0, float * u, float * v, float dt )
+{
+	PROFILE_ZONE("advect");
+	advect_t<tScalarIndex> ( N, b, d, d0, u, v, dt );
+}
+
+// p and div are the scratch components of the previous velocity field, so they share its layout
+void project ( int N, float * RESTRICT u, float * RESTRICT v, float * RESTRICT p, float * RESTRICT div )
+{
+	PROFILE_ZONE("project");
+	int i, j;
+
+	#pragma omp parallel for private(i,j)
+	FOR_EACH_CELL
+		div[VIX(i,j)] = -0.5f*(u[VIX(i+1,j)]-u[VIX(i-1,j)]+v[VIX(i,j+1)]-v[VIX(i,j-1)])/N;
+		p[VIX(i,j)] = 0;
+	END_FOR	
+	set_bnd_t<tVelocityIndex> ( N, 0, div ); set_bnd_t<tVelocityIndex> ( N, 0, p );
+
+	lin_solve_t<tVelocityIndex> ( N, 0, p, div, 1, 4 );
+
+	#pragma omp parallel for private(i,j)
+	FOR_EACH_CELL
+		u[VIX(i,j)] -= 0.5f*N*(p[VIX(i+1,j)]-p[VIX(i-1,j)]);
+		v[VIX(i,j)] -= 0.5f*N*(p[VIX(i,j+1)]-p[VIX(i,j-1)]);
+	END_FOR
+	set_bnd_t<tVelocityIndex> ( N, 1, u ); set_bnd_t<tVelocityIndex> ( N, 2, v );
+}
+
+////////////////////////////////////////////////////////////////
+// Velocity Functions
+// Both components in one pass. The components are independent until project, so these give
+// the same result as running the scalar kernel once per component.
+
+void add_source_velocity ( int N, float * RESTRICT u, float * RESTRICT v, float * RESTRICT u0, float * RESTRICT v0, float dt )
+{
+	PROFILE_ZONE("add_source_velocity");
+#if VELOCITY_LAYOUT == VELOCITY_LAYOUT_PLANAR
+	add_source ( N, u, u0, dt ); add_source ( N, v, v0, dt );
+#else
+	// One stream over the pairs, u and u0 are the bases of their allocations
+	int i, size=VEL_SIZE(N);
+	(void)v; (void)v0;
+	#pragma omp parallel for
+	for ( i=0 ; i<size ; i++ ) u[i] += dt*u0[i];
+#endif
+}
+
+void diffuse_velocity ( int N, float * u, float * v, float * u0, float * v0, float visc, float dt )
+{
+	PROFILE_ZONE("diffuse_velocity");
+	int i, j, k;
+	float a=dt*visc*N*N, c=1+4*a;
+
+	for ( k=0 ; k<LIN_SOLVE_ITERATIONS ; k++ ) {
+		FOR_EACH_CELL
+			u[VIX(i,j)] = (u0[VIX(i,j)] + a*(u[VIX(i-1,j)]+u[VIX(i+1,j)]+u[VIX(i,j-1)]+u[VIX(i,j+1)]))/c;
+			v[VIX(i,j)] = (v0[VIX(i,j)] + a*(v[VIX(i-1,j)]+v[VIX(i+1,j)]+v[VIX(i,j-1)]+v[VIX(i,j+1)]))/c;
+		END_FOR
+		set_bnd_t<tVelocityIndex> ( N, 1, u ); set_bnd_t<tVelocityIndex> ( N, 2, v );
+	}
+}
+
+// Self-advection, one backtrace for both components
+void advect_velocity ( int N, float * u, float * v, float * u0, float * v0, float dt )
+{
+	PROFILE_ZONE("advect_velocity");
+	int i, j, i0, j0, i1, j1;
+	float x, y, s0, t0, s1, t1, dt0;
+
+	dt0 = dt*N;
+	#pragma omp parallel for private(i,j,i0,j0,i1,j1,x,y,s0,t0,s1,t1)
+	FOR_EACH_CELL
+		x = i-dt0*u0[VIX(i,j)]; y = j-dt0*v0[VIX(i,j)];
+		if (x<0.5f) x=0.5f; if (x>N+0.5f) x=N+0.5f; i0=(int)x; i1=i0+1;
+		if (y<0.5f) y=0.5f; if (y>N+0.5f) y=N+0.5f; j0=(int)y; j1=j0+1;
+		s1 = x-i0; s0 = 1-s1; t1 = y-j0; t0 = 1-t1;
+		int k00 = VIX(i0,j0), k01 = VIX(i0,j1), k10 = VIX(i1,j0), k11 = VIX(i1,j1);
+		u[VIX(i,j)] = s0*(t0*u0[k00]+t1*u0[k01])+
+					  s1*(t0*u0[k10]+t1*u0[k11]);
+		v[VIX(i,j)] = s0*(t0*v0[k00]+t1*v0[k01])+
+					  s1*(t0*v0[k10]+t1*v0[k11]);
+	END_FOR
+	set_bnd_t<tVelocityIndex> ( N, 1, u ); set_bnd_t<tVelocityIndex> ( N, 2, v );
+}
+
+////////////////////////////////////////////////////////////////
+// Sparse Sources
+// add_source is x += dt*s over every cell, and the field of sources is
+// then the first guess of the diffuse solve. Here the sources go
+// straight into x, and the first guess is only rebuilt (zero but for
+// the sources, as the dense step leaves it) when the solve reads it,
+// which is whenever diff or visc is non-zero. CFluidSim's defaults
+// diffuse the density (diff 0.0001) and not the velocity, so a step
+// there still clears x0 over the whole grid; what it no longer sweeps
+// is the add_source into x, and u0 and v0's clear and add_source.
+
+void dens_step_sparse ( int N, float * x, float * x0, const tSource * s, int count, float * u, float * v, float diff, float dt )
+{
+	PROFILE_ZONE("dens_step_sparse");
+	int i, k, size=FIELD_SIZE(N);
+
+	for ( k=0 ; k<count ; k++ ) x[s[k].cell] += dt*s[k].a;
+	if ( diff != 0.0f ) {
+		for ( i=0 ; i<size ; i++ ) x0[i] = 0.0f;
+		for ( k=0 ; k<count ; k++ ) x0[s[k].cell] += s[k].a;
+	}
+	SWAP ( x0, x ); diffuse ( N, 0, x, x0, diff, dt );
+	SWAP ( x0, x ); advect ( N, 0, x, x0, u, v, dt );
+}
+
+void vel_step_sparse ( int N, float * u, float * v, float * u0, float * v0, const tSource * s, int count, float visc, float dt )
+{
+	PROFILE_ZONE("vel_step_sparse");
+	int k;
+
+	for ( k=0 ; k<count ; k++ ) {
+		u[s[k].cell] += dt*s[k].a;
+		v[s[k].cell] += dt*s[k].b;
+	}
+	if ( visc != 0.0f ) {
+		clear_velocity ( N, u0, v0 );
+		for ( k=0 ; k<count ; k++ ) {
+			u0[s[k].cell] += s[k].a;
+			v0[s[k].cell] += s[k].b;
+		}
+	}
+	SWAP ( u0, u ); SWAP ( v0, v ); diffuse_velocity ( N, u, v, u0, v0, visc, dt );
+	project ( N, u, v, u0, v0 );
+	SWAP ( u0, u ); SWAP ( v0, v );
+	advect_velocity ( N, u, v, u0, v0, dt );
+	project ( N, u, v, u0, v0 );
+}
+
+////////////////////////////////////////////////////////////////
+// Allocation
+// Fields start on a FIELD_ALIGN boundary, so in the padded layout every interior row
+// starts on a vector boundary.
+
+static float * aligned_floats ( int count )
+{
+	void * p = 0;
+#ifdef _WIN32
+	p = _aligned_malloc ( count*sizeof(float), FIELD_ALIGN );
+#else
+	if ( posix_memalign ( &p, FIELD_ALIGN, count*sizeof(float) ) ) p = 0;
+#endif
+	return (float *) p;
+}
+
+static void aligned_free ( float * p )
+{
+#ifdef _WIN32
+	_aligned_free ( p );
+#else
+	free ( p );
+#endif
+}
+
+float * allocate_field ( int N )
+{
+	return aligned_floats ( FIELD_SIZE(N) );
+}
+
+void free_field ( float * x )
+{
+	if ( x ) aligned_free ( x );
+}
+
+int allocate_velocity ( int N, float ** u, float ** v )
+{
+#if VELOCITY_LAYOUT == VELOCITY_LAYOUT_PLANAR
+	*u = aligned_floats ( VEL_SIZE(N) );
+	*v = aligned_floats ( VEL_SIZE(N) );
+#else
+	*u = aligned_floats ( VEL_SIZE(N) );
+	*v = *u ? *u + VEL_V_OFFSET : 0;
+#endif
+	return *u && *v;
+}
+
+void free_velocity ( float * u, float * v )
+{
+	if ( u ) aligned_free ( u );
+#if VELOCITY_LAYOUT == VELOCITY_LAYOUT_PLANAR
+	if ( v ) aligned_free ( v );
+#else
+	(void)v;
+#endif
+}
+
+void clear_velocity ( int N, float * u, float * v )
+{
+	int i, size=VEL_SIZE(N);
+
+#if VELOCITY_LAYOUT != VELOCITY_LAYOUT_PLANAR
+	(void)v;
+#endif
+	for ( i=0 ; i<size ; i++ ) {
+#if VELOCITY_LAYOUT == VELOCITY_LAYOUT_PLANAR
+		u[i] = v[i] = 0.0f;
+#else
+		u[i] = 0.0f;
+#endif
+	}
+}
+
+////////////////////////////////////////////////////////////////
+// Steps
+
+void dens_step ( int N, float * x, float * x0, float * u, float * v, float diff, float dt )
+{
+	PROFILE_ZONE("dens_step");
+	add_source ( N, x, x0, dt );
+	SWAP ( x0, x ); diffuse ( N, 0, x, x0, diff, dt );
+	SWAP ( x0, x ); advect ( N, 0, x, x0, u, v, dt );
+}
+
+void vel_step ( int N, float * u, float * v, float * u0, float * v0, float visc, float dt )
+{
+	PROFILE_ZONE("vel_step");
+	add_source_velocity ( N, u, v, u0, v0, dt );
+	SWAP ( u0, u ); SWAP ( v0, v ); diffuse_velocity ( N, u, v, u0, v0, visc, dt );
+	project ( N, u, v, u0, v0 );
+	SWAP ( u0, u ); SWAP ( v0, v );
+	advect_velocity ( N, u, v, u0, v0, dt );
+	project ( N, u, v, u0, v0 );
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Def.h"	// definitions
+
+////////////////////////////////////////////////////////////////
+// Solver Functions (Taken from original source code)
+//
+// Free functions so the solver can be driven without the demo
+// window (benchmarks, tools). Every scalar field is FIELD_SIZE(N)
+// floats from allocate_field. Velocities are (u,v) component pointers in VELOCITY_LAYOUT
+// and are indexed with VIX, so allocate them with allocate_velocity.
+#define LIN_SOLVE_ITERATIONS 20	// Gauss-Seidel sweeps, fixed as in the article
+
+void add_source	( int N, float * x, float * s, float dt );
+void set_bnd	( int N, int b, float * x );
+void lin_solve	( int N, int b, float * x, float * x0, float a, float c );
+void diffuse	( int N, int b, float * x, float * x0, float diff, float dt );
+void advect		( int N, int b, float * d, float * d0, float * u, float * v, float dt );
+void project	( int N, float * u, float * v, float * p, float * div );
+void dens_step	( int N, float * x, float * x0, float * u, float * v, float diff, float dt );
+void vel_step	( int N, float * u, float * v, float * u0, float * v0, float visc, float dt );
+
+////////////////////////////////////////////////////////////////
+// Sparse Sources
+// The same steps with the sources as a list of cells instead of a field
+// to add in full. x0, u0 and v0 come in holding whatever the last step
+// left and are only cleared when the diffuse solve starts from them
+// (diff or visc not 0). A cell listed twice gets both, one after the
+// other, where the dense step adds their sum.
+struct tSource
+{
+	int		cell;	// IX for density, VIX for velocity
+	float	a, b;	// The density, or the velocity's u and v
+};
+
+void dens_step_sparse	( int N, float * x, float * x0, const tSource * s, int count, float * u, float * v, float diff, float dt );
+void vel_step_sparse	( int N, float * u, float * v, float * u0, float * v0, const tSource * s, int count, float visc, float dt );
+
+////////////////////////////////////////////////////////////////
+// Velocity Functions (both components at once)
+void add_source_velocity	( int N, float * u, float * v, float * u0, float * v0, float dt );
+void diffuse_velocity		( int N, float * u, float * v, float * u0, float * v0, float visc, float dt );
+void advect_velocity		( int N, float * u, float * v, float * u0, float * v0, float dt );
+
+////////////////////////////////////////////////////////////////
+// Allocation (FIELD_ALIGN aligned)
+float * allocate_field	( int N );
+void free_field			( float * x );
+int  allocate_velocity	( int N, float ** u, float ** v );
+void free_velocity		( float * u, float * v );
+void clear_velocity		( int N, float * u, float * v );
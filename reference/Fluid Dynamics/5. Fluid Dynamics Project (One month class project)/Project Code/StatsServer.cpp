@@ -0,0 +1,459 @@
+#include "StatsServer.h"
+#include "Simulation.h"
+#include "Mesh.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <windows.h>
+#define closesocket_(s)		closesocket ( (SOCKET)(s) )
+#define STATS_BARRIER()		fence()
+// A locked exchange orders everything around it, and the 2003 SDK has no MemoryBarrier
+static void fence(void) { static volatile long dummy; InterlockedExchange ( (long *)&dummy, 0 ); }
+#define SEND_FLAGS			0
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#define closesocket_(s)		::close ( (int)(s) )
+#define STATS_BARRIER()		__sync_synchronize()
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS			MSG_NOSIGNAL	// A client that hung up is not worth a SIGPIPE
+#else
+#define SEND_FLAGS			0
+#endif
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Process numbers
+
+static double processCpuSeconds(void)
+{
+#ifdef _WIN32
+	FILETIME created, exited, kernel, user;
+	if(!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user))
+		return 0.0;
+	ULARGE_INTEGER k, u;
+	k.LowPart = kernel.dwLowDateTime; k.HighPart = kernel.dwHighDateTime;
+	u.LowPart = user.dwLowDateTime;	  u.HighPart = user.dwHighDateTime;
+	return (double)(k.QuadPart + u.QuadPart) * 1e-7;
+#else
+	rusage usage;
+	if(getrusage(RUSAGE_SELF, &usage))
+		return 0.0;
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + 1e-6*(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+#endif
+}
+
+static long long residentBytes(void)
+{
+#ifdef __linux__
+	FILE *file = fopen ( "/proc/self/statm", "r" );
+	if(!file)
+		return -1;
+	long pages = 0, resident = 0;
+	int read = fscanf ( file, "%ld %ld", &pages, &resident );
+	fclose ( file );
+	return read == 2 ? (long long)resident * sysconf(_SC_PAGESIZE) : -1;
+#else
+	return -1;
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Shared memory
+
+static void shmName(char *path, int size, const char *name)
+{
+#ifdef _WIN32
+	_snprintf ( path, size, "Local\\%s", name );
+#else
+	snprintf ( path, size, "/%s", name );
+#endif
+	path[size-1] = 0;
+}
+
+// Appends to text while there is room, length keeps counting past it
+static void append(char *text, int size, int &length, const char *format, ...)
+{
+	if(length >= size)
+		return;
+	va_list args;
+	va_start ( args, format );
+#ifdef _WIN32
+	int wrote = _vsnprintf ( text + length, size - length, format, args );
+#else
+	int wrote = vsnprintf ( text + length, size - length, format, args );
+#endif
+	va_end ( args );
+	length = wrote < 0 ? size : length + wrote;
+}
+
+int statsFormat(const tStatsBlock &block, char *text, int size)
+{
+	int length = 0;
+	text[0] = 0;
+
+	append ( text, size, length, "# Lumens fluid simulation, times in seconds\n" );
+	append ( text, size, length, "lumens_frame %.0f\n", (double)block.frame );
+	append ( text, size, length, "lumens_uptime_seconds %.3f\n", block.seconds );
+	append ( text, size, length, "lumens_grid_n %d\n", block.N );
+	for(int s = 0; s < totalFrameStageCount; s++)
+		append ( text, size, length, "lumens_stage_seconds{stage=\"%s\"} %.9f\n", CFrameStats::stageName(s), block.stage[s] );
+	append ( text, size, length, "lumens_frame_seconds{quantile=\"0.5\"} %.9f\n", block.frameP50 );
+	append ( text, size, length, "lumens_frame_seconds{quantile=\"0.99\"} %.9f\n", block.frameP99 );
+	append ( text, size, length, "lumens_frame_seconds_max %.9f\n", block.frameMax );
+	append ( text, size, length, "lumens_frames_over_budget %.0f\n", (double)block.overBudget );
+	append ( text, size, length, "lumens_solver_iterations %d\n", block.iterations );
+	append ( text, size, length, "lumens_solver_solves_per_step %d\n", block.solves );
+	append ( text, size, length, "lumens_pressure_residual_rms %g\n", block.residual );
+	append ( text, size, length, "lumens_divergence_rms %g\n", block.divergence );
+	append ( text, size, length, "lumens_max_speed %g\n", block.maxSpeed );
+	append ( text, size, length, "lumens_cfl %g\n", block.cfl );
+	append ( text, size, length, "lumens_mass %.6g\n", block.mass );
+	append ( text, size, length, "lumens_mesh_rebuilt_ratio %.4f\n", block.meshRebuilt );
+	append ( text, size, length, "lumens_mesh_triangles %.0f\n", (double)block.triangles );
+	append ( text, size, length, "lumens_mesh_triangles_full %.0f\n", (double)block.fullTriangles );
+	append ( text, size, length, "lumens_mesh_chunks %d\n", block.chunks );
+	append ( text, size, length, "lumens_mesh_chunks_drawn %d\n", block.chunksDrawn );
+	append ( text, size, length, "lumens_metrics_frame %.0f\n", (double)block.metricsFrame );
+	append ( text, size, length, "lumens_threads %d\n", block.threads );
+	append ( text, size, length, "lumens_thread_utilisation %.4f\n", block.utilisation );
+	append ( text, size, length, "lumens_field_bytes %.0f\n", (double)block.fieldBytes );
+	append ( text, size, length, "lumens_resident_bytes %.0f\n", (double)block.residentBytes );
+
+	return length < size ? length : size - 1;
+}
+
+int statsRead(const char *name, tStatsBlock &block)
+{
+	char path[80];
+	shmName(path, sizeof(path), name);
+
+#ifdef _WIN32
+	HANDLE mapping = OpenFileMappingA ( FILE_MAP_READ, FALSE, path );
+	if(!mapping)
+		return 0;
+	const tStatsBlock *shared = (const tStatsBlock *) MapViewOfFile ( mapping, FILE_MAP_READ, 0, 0, sizeof(tStatsBlock) );
+#else
+	int fd = shm_open ( path, O_RDONLY, 0 );
+	if(fd < 0)
+		return 0;
+	const tStatsBlock *shared = (const tStatsBlock *) mmap ( 0, sizeof(tStatsBlock), PROT_READ, MAP_SHARED, fd, 0 );
+	::close ( fd );
+	if(shared == MAP_FAILED)
+		shared = 0;
+#endif
+	int ok = 0;
+	if(shared && shared->magic == STATS_MAGIC && shared->version == STATS_VERSION)
+	{
+		// The writer never waits, so keep copying until a copy was not torn by a publish
+		for(int tries = 0; tries < 1000 && !ok; tries++)
+		{
+			unsigned int before = shared->sequence;
+			STATS_BARRIER();
+			memcpy ( &block, (const void *)shared, sizeof(block) );
+			STATS_BARRIER();
+			ok = !(before & 1) && before == shared->sequence;
+		}
+	}
+
+#ifdef _WIN32
+	if(shared)
+		UnmapViewOfFile ( shared );
+	CloseHandle ( mapping );
+#else
+	if(shared)
+		munmap ( (void *)shared, sizeof(tStatsBlock) );
+#endif
+	return ok;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// CStatsServer
+
+CStatsServer::CStatsServer(void)
+{
+	m_block		= &m_local;
+	m_mapping	= 0;
+	m_name[0]	= 0;
+	m_listener	= -1;
+	for(int c = 0; c < STATS_MAX_CLIENTS; c++)
+		m_clients[c].socket = -1;
+	memset ( &m_local, 0, sizeof(m_local) );
+	m_lastCpu = m_lastWall = 0.0;
+}
+
+CStatsServer::~CStatsServer(void)
+{
+	close();
+}
+
+int CStatsServer::open(int port, const char *name)
+{
+	close();
+	int opened = 0;
+
+	if(name)
+	{
+		char path[80];
+		shmName(path, sizeof(path), name);
+#ifdef _WIN32
+		HANDLE mapping = CreateFileMappingA ( INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(tStatsBlock), path );
+		void *view = mapping ? MapViewOfFile ( mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(tStatsBlock) ) : 0;
+		if(view)
+			m_mapping = mapping;
+		else if(mapping)
+			CloseHandle ( mapping );
+#else
+		void *view = 0;
+		int fd = shm_open ( path, O_CREAT | O_RDWR, 0644 );
+		if(fd >= 0)
+		{
+			if(!ftruncate ( fd, sizeof(tStatsBlock) ))
+				view = mmap ( 0, sizeof(tStatsBlock), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+			if(view == MAP_FAILED)
+				view = 0;
+			::close ( fd );
+		}
+#endif
+		if(view)
+		{
+			m_block = (tStatsBlock *) view;
+			strncpy ( m_name, name, sizeof(m_name)-1 );
+			m_name[sizeof(m_name)-1] = 0;
+			opened++;
+		}
+	}
+
+	if(port)
+	{
+#ifdef _WIN32
+		WSADATA data;
+		WSAStartup ( MAKEWORD(2,2), &data );
+#endif
+		long listener = (long) socket ( AF_INET, SOCK_STREAM, 0 );
+		sockaddr_in address;
+		memset ( &address, 0, sizeof(address) );
+		address.sin_family		= AF_INET;
+		address.sin_port		= htons ( (unsigned short)port );
+		address.sin_addr.s_addr	= htonl ( INADDR_LOOPBACK );	// Local only
+		int reuse = 1;
+		setsockopt ( listener, SOL_SOCKET, SO_REUSEADDR, (const char *)&reuse, sizeof(reuse) );
+
+		if(listener >= 0 && !bind ( listener, (sockaddr *)&address, sizeof(address) ) && !listen ( listener, 8 ))
+		{
+#ifdef _WIN32
+			u_long nonBlocking = 1;
+			ioctlsocket ( listener, FIONBIO, &nonBlocking );
+#else
+			fcntl ( listener, F_SETFL, fcntl ( listener, F_GETFL ) | O_NONBLOCK );
+#endif
+			m_listener = listener;
+			opened++;
+		}
+		else if(listener >= 0)
+			closesocket_ ( listener );
+	}
+
+	memset ( m_block, 0, sizeof(tStatsBlock) );
+	m_block->magic		= STATS_MAGIC;
+	m_block->version	= STATS_VERSION;
+	m_block->N			= N;
+	m_block->iterations	= LIN_SOLVE_ITERATIONS;
+	m_block->solves		= 5;	// diffuse_velocity 2, project 2, diffuse 1
+	m_block->residentBytes = -1;
+
+	m_clock.Reset();
+	m_lastWall	= 0.0;
+	m_lastCpu	= processCpuSeconds();
+	return opened;
+}
+
+void CStatsServer::close(void)
+{
+	for(int c = 0; c < STATS_MAX_CLIENTS; c++)
+	{
+		if(m_clients[c].socket >= 0)
+			closesocket_ ( m_clients[c].socket );
+		m_clients[c].socket = -1;
+	}
+	if(m_listener >= 0)
+	{
+		closesocket_ ( m_listener );
+		m_listener = -1;
+	}
+
+	if(m_block != &m_local)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile ( m_block );
+		CloseHandle ( (HANDLE)m_mapping );
+#else
+		char path[80];
+		shmName(path, sizeof(path), m_name);
+		munmap ( m_block, sizeof(tStatsBlock) );
+		shm_unlink ( path );
+#endif
+		m_block		= &m_local;
+		m_mapping	= 0;
+		m_name[0]	= 0;
+	}
+}
+
+void CStatsServer::publish(CFluidSim &sim, const tFrameTimes &times, const CFrameStats &stats, float dt, const tMeshStats *mesh)
+{
+	tStatsBlock &block = *m_block;
+	long long frame = block.frame + 1;
+
+	// The field pass and the process numbers are the only parts that cost anything, so not every frame
+	bool metrics = frame % STATS_METRICS_INTERVAL == 1 || STATS_METRICS_INTERVAL == 1;
+	tFieldMetrics fields;
+	long long resident = block.residentBytes;
+	if(metrics)
+	{
+		sim.measure(dt, fields);
+		resident = residentBytes();
+	}
+
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	double wall = m_clock.GetElapsedSeconds(), cpu = processCpuSeconds();
+	double utilisation = wall > m_lastWall ? (cpu - m_lastCpu)/((wall - m_lastWall)*threads) : 0.0;
+	m_lastWall	= wall;
+	m_lastCpu	= cpu;
+
+	block.sequence++;
+	STATS_BARRIER();
+
+	block.N			= N;
+	block.frame		= frame;
+	block.seconds	= wall;
+	for(int s = 0; s < totalFrameStageCount; s++)
+		block.stage[s] = times.stage[s];
+	block.frameP50		= stats.getFrame().percentile(50.0);
+	block.frameP99		= stats.getFrame().percentile(99.0);
+	block.frameMax		= stats.getFrame().getMax();
+	block.overBudget	= stats.getOverBudget();
+	if(mesh)
+	{
+		block.meshRebuilt	= mesh->rebuilt;
+		block.triangles		= mesh->triangles;
+		block.fullTriangles	= mesh->fullTriangles;
+		block.chunks		= mesh->chunks;
+		block.chunksDrawn	= mesh->chunksDrawn;
+	}
+	if(metrics)
+	{
+		block.metricsFrame	= frame;
+		block.mass			= fields.mass;
+		block.maxSpeed		= fields.maxSpeed;
+		block.cfl			= fields.cfl;
+		block.divergence	= fields.divergence;
+		block.residual		= fields.residual;
+		block.fieldBytes	= sim.getFieldBytes();
+		block.residentBytes	= resident;
+	}
+	block.threads		= threads;
+	block.utilisation	= utilisation;
+
+	STATS_BARRIER();
+	block.sequence++;
+
+	if(m_listener >= 0)
+		serve();
+}
+
+// Accepts new connections and answers every request that has arrived in full, all without blocking
+void CStatsServer::serve(void)
+{
+	fd_set readable;
+	FD_ZERO ( &readable );
+	FD_SET ( m_listener, &readable );
+	long highest = m_listener;
+	for(int c = 0; c < STATS_MAX_CLIENTS; c++)
+	{
+		if(m_clients[c].socket < 0)
+			continue;
+		FD_SET ( m_clients[c].socket, &readable );
+		if(m_clients[c].socket > highest)
+			highest = m_clients[c].socket;
+	}
+
+	timeval now = { 0, 0 };
+	if(select ( (int)highest + 1, &readable, 0, 0, &now ) <= 0)
+	{
+		// Nothing arrived, but still let go of clients that never finish asking
+		for(int c = 0; c < STATS_MAX_CLIENTS; c++)
+			if(m_clients[c].socket >= 0 && ++m_clients[c].age > 600)
+			{
+				closesocket_ ( m_clients[c].socket );
+				m_clients[c].socket = -1;
+			}
+		return;
+	}
+
+	if(FD_ISSET ( m_listener, &readable ))
+	{
+		for(int c = 0; c < STATS_MAX_CLIENTS; c++)
+		{
+			if(m_clients[c].socket >= 0)
+				continue;
+			long client = (long) accept ( m_listener, 0, 0 );
+			if(client < 0)
+				break;
+			m_clients[c].socket	= client;
+			m_clients[c].length	= 0;
+			m_clients[c].age	= 0;
+		}
+	}
+
+	for(int c = 0; c < STATS_MAX_CLIENTS; c++)
+	{
+		tClient &client = m_clients[c];
+		if(client.socket < 0)
+			continue;
+		client.age++;
+		if(!FD_ISSET ( client.socket, &readable ))
+			continue;
+
+		int got = recv ( client.socket, client.request + client.length, STATS_REQUEST_SIZE - 1 - client.length, 0 );
+		if(got > 0)
+		{
+			client.length += got;
+			client.request[client.length] = 0;
+		}
+
+		// Any path gets the stats, once the headers are in (or the buffer is full of them)
+		bool complete = strstr ( client.request, "\r\n\r\n" ) || strstr ( client.request, "\n\n" ) ||
+						client.length >= STATS_REQUEST_SIZE - 1;
+		if(got > 0 && !complete)
+			continue;
+
+		if(complete)
+		{
+			char body[STATS_TEXT_SIZE], header[160];
+			int length = statsFormat(*m_block, body, sizeof(body));
+			int headerLength = sprintf ( header, "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+				"Content-Length: %d\r\nConnection: close\r\n\r\n", length );
+			send ( client.socket, header, headerLength, SEND_FLAGS );
+			send ( client.socket, body, length, SEND_FLAGS );
+		}
+		closesocket_ ( client.socket );
+		client.socket = -1;
+	}
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "FrameStats.h"	// stages and frame histograms
+
+class CFluidSim;
+struct tMeshStats;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Class:	"CStatsServer"
+//
+// Purpose: Live stats from a running simulation without attaching a debugger. Every frame the numbers are written to a
+//			tStatsBlock in shared memory (read it with fluid_stats) and served as plain text, in the Prometheus format,
+//			over HTTP on 127.0.0.1 (curl localhost:7007). Nothing runs on another thread: publish() writes the block
+//			under a sequence count and answers waiting requests after a zero timeout select, so an endpoint nobody is
+//			reading costs one syscall a frame. The pass over the fields (mass, speed, divergence, residual) only runs
+//			every STATS_METRICS_INTERVAL frames.
+//
+// Usage:	open(port, name) once, a port of 0 or a NULL name leaves that half off. publish() at the end of every frame,
+//			after the step, with the frame's stage times and the mesh's CWaterMesh::getStats() (NULL without one).
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define STATS_MAGIC				0x5354464C	// "LFTS" in memory
+#define STATS_VERSION			3
+#define STATS_PORT				7007
+#define STATS_SHM_NAME			"lumens_stats"	// /lumens_stats under /dev/shm, Local\lumens_stats on Windows
+#define STATS_METRICS_INTERVAL	8		// Frames between passes over the fields
+#define STATS_MAX_CLIENTS		4		// Requests being read at once, more wait in the listen queue
+#define STATS_REQUEST_SIZE		1024
+#define STATS_TEXT_SIZE			4096
+
+// Shared memory layout, fixed size types only so every reader sees the same thing
+struct tStatsBlock
+{
+	unsigned int			magic;
+	unsigned int			version;
+	volatile unsigned int	sequence;	// Odd while being written, copy until it is even and the same either side
+	int						N;
+
+	long long	frame;
+	double		seconds;					// Since open
+	double		stage[totalFrameStageCount];	// The last frame, in seconds
+	double		frameP50;
+	double		frameP99;
+	double		frameMax;
+	long long	overBudget;
+
+	// Solver
+	int			iterations;		// Gauss-Seidel sweeps per solve
+	int			solves;			// Solves per step
+	long long	metricsFrame;	// The frame the field metrics are from
+	double		mass;
+	double		maxSpeed;
+	double		cfl;
+	double		divergence;		// RMS, after the last project
+	double		residual;		// RMS of the last pressure solve
+
+	// Render
+	double		meshRebuilt;	// Fraction of the mesh the last frame rebuilt
+	long long	triangles;		// Drawn by the last frame, after the LOD and culling
+	long long	fullTriangles;	// The whole mesh at full detail
+	int			chunks;
+	int			chunksDrawn;
+
+	// Process
+	int			threads;
+	int			pad;
+	double		utilisation;	// CPU time over wall time times threads, since the last publish
+	long long	fieldBytes;
+	long long	residentBytes;	// -1 where the platform does not say
+};
+
+// Prints a block as the text the endpoint serves, returns the length
+int statsFormat(const tStatsBlock &block, char *text, int size);
+
+// Takes a consistent copy of the block another process publishes, returns false if there is none
+int statsRead(const char *name, tStatsBlock &block);
+
+class CStatsServer
+{
+
+private:
+
+	struct tClient
+	{
+		long	socket;		// -1 when free
+		int		length;
+		int		age;		// Frames since it connected
+		char	request[STATS_REQUEST_SIZE];
+	};
+
+	tStatsBlock	*m_block;	// Shared, or m_local
+	tStatsBlock	m_local;
+	void		*m_mapping;
+	char		m_name[64];
+
+	long		m_listener;
+	tClient		m_clients[STATS_MAX_CLIENTS];
+
+	CTimer		m_clock;
+	double		m_lastCpu;
+	double		m_lastWall;
+
+	void serve(void);
+
+	CStatsServer(const CStatsServer&);
+	CStatsServer&operator = (const CStatsServer&);
+
+public:
+
+	CStatsServer(void);
+	~CStatsServer(void);
+
+	// Returns how many of the two opened
+	int  open(int port, const char *name);
+	void close(void);
+
+	void publish(CFluidSim &sim, const tFrameTimes &times, const CFrameStats &stats, float dt, const tMeshStats *mesh);
+
+	const tStatsBlock &getBlock(void) const { return *m_block; }
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+// Portable high resolution timer with the same interface as Richard's CStopWatch, which it
+// replaces, so the same code builds away from windows.h (benchmarks, headless tools).
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+class CTimer
+{
+
+private:
+
+#ifdef _WIN32
+	LARGE_INTEGER m_frequency;
+	LARGE_INTEGER m_lastCount;
+#else
+	timespec	  m_lastCount;
+#endif
+
+public:
+
+	CTimer(void)
+	{
+#ifdef _WIN32
+		QueryPerformanceFrequency(&m_frequency);
+#endif
+		Reset();
+	}
+
+	// Resets timer (difference) to zero
+	inline void Reset(void)
+	{
+#ifdef _WIN32
+		QueryPerformanceCounter(&m_lastCount);
+#else
+		clock_gettime(CLOCK_MONOTONIC, &m_lastCount);
+#endif
+	}
+
+	// Get elapsed time in seconds
+	inline double GetElapsedSeconds(void) const
+	{
+#ifdef _WIN32
+		LARGE_INTEGER now;
+		QueryPerformanceCounter(&now);
+		return double(now.QuadPart - m_lastCount.QuadPart) / double(m_frequency.QuadPart);
+#else
+		timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		return double(now.tv_sec - m_lastCount.tv_sec) + double(now.tv_nsec - m_lastCount.tv_nsec) * 1e-9;
+#endif
+	}
+};
@@ -0,0 +1,133 @@
+#include "VelocityGlyphs.h"
+#include "Renderer.h"	// what they are drawn through
+#include "Mesh.h"		// packColor
+#include "Profiler.h"
+
+#include <stdlib.h>
+#include <math.h>
+
+CVelocityGlyphs::CVelocityGlyphs(void)
+{
+	m_samples	= NULL;
+	m_rowStarts	= NULL;
+	m_vertices	= NULL;
+	m_n = m_side = m_stride = m_lines = 0;
+}
+
+CVelocityGlyphs::~CVelocityGlyphs(void)
+{
+	freeGlyphs();
+}
+
+void CVelocityGlyphs::freeGlyphs(void)
+{
+	free ( m_samples );
+	free ( m_rowStarts );
+	free ( m_vertices );
+	m_samples	= NULL;
+	m_rowStarts	= NULL;
+	m_vertices	= NULL;
+	m_n = m_side = m_stride = m_lines = 0;
+}
+
+int CVelocityGlyphs::allocate(int n)
+{
+	freeGlyphs();
+
+	int stride	= (n + GLYPH_SIDE - 1)/GLYPH_SIDE;
+	int side	= (n + stride - 1)/stride;
+	m_samples	= (float (*)[2]) malloc ( (size_t)side*side*sizeof(*m_samples) );
+	m_rowStarts	= (int *) malloc ( (side + 1)*sizeof(*m_rowStarts) );
+	m_vertices	= (float (*)[3]) malloc ( (size_t)2*side*side*sizeof(*m_vertices) );
+	if ( !m_samples || !m_rowStarts || !m_vertices ) {
+		freeGlyphs();
+		return ( 0 );
+	}
+
+	m_n			= n;
+	m_side		= side;
+	m_stride	= stride;
+	return ( 1 );
+}
+
+int CVelocityGlyphs::build(const float *u, const float *v)
+{
+	PROFILE_ZONE("velocity glyphs");
+	if(m_n != N && !allocate(N))
+		return ( 0 );
+
+	int side = m_side, stride = m_stride, row;
+	float h = 1.0f/N;
+	float shortest = GLYPH_MIN_LENGTH*stride*h;
+
+	// The squares' means, and how many of each row are long enough to keep. The last square of a row or column is
+	// cut short at N
+	#pragma omp parallel for
+	for (row = 0; row < side; row++)
+	{
+		int j0 = 1 + row*stride, j1 = j0 + stride - 1 < N ? j0 + stride - 1 : N;
+		int kept = 0;
+		for (int col = 0; col < side; col++)
+		{
+			int i0 = 1 + col*stride, i1 = i0 + stride - 1 < N ? i0 + stride - 1 : N;
+			float su = 0.0f, sv = 0.0f;
+			for (int j = j0; j <= j1; j++)
+			{
+				for (int i = i0; i <= i1; i++)
+				{
+					su += u[VIX(i,j)];
+					sv += v[VIX(i,j)];
+				}
+			}
+			float cells = (float)((i1 - i0 + 1)*(j1 - j0 + 1));
+			float *sample = m_samples[row*side + col];
+			sample[0] = su/cells;
+			sample[1] = sv/cells;
+			kept += sample[0]*sample[0] + sample[1]*sample[1] >= shortest*shortest;
+		}
+		m_rowStarts[row + 1] = kept;
+	}
+
+	m_rowStarts[0] = 0;
+	for (row = 0; row < side; row++)
+		m_rowStarts[row + 1] += m_rowStarts[row];
+	m_lines = m_rowStarts[side];
+
+	// Each row writes its own run of the list, from the centre of each square kept along its velocity
+	#pragma omp parallel for
+	for (row = 0; row < side; row++)
+	{
+		int j0 = 1 + row*stride, j1 = j0 + stride - 1 < N ? j0 + stride - 1 : N;
+		float z = (0.5f*(j0 + j1) - 0.5f)*h;
+		float (*out)[3] = m_vertices + 2*m_rowStarts[row];
+		for (int col = 0; col < side; col++)
+		{
+			const float *sample = m_samples[row*side + col];
+			if(sample[0]*sample[0] + sample[1]*sample[1] < shortest*shortest)
+				continue;
+			int i0 = 1 + col*stride, i1 = i0 + stride - 1 < N ? i0 + stride - 1 : N;
+			float x = (0.5f*(i0 + i1) - 0.5f)*h;
+			out[0][0] = x;				out[0][1] = 0.0f;	out[0][2] = z;
+			out[1][0] = x + sample[0];	out[1][1] = 0.0f;	out[1][2] = z + sample[1];
+			out += 2;
+		}
+	}
+	return ( 1 );
+}
+
+void CVelocityGlyphs::render(CRenderBackend &renderer)
+{
+	if(!m_lines)
+		return;
+
+	tColor blue = { 0.0f, 0.0f, 1.0f };
+	tRenderLines lines;
+	lines.vertices		= &m_vertices[0][0];
+	lines.vertexCount	= 2*m_lines;
+	lines.color			= CWaterMesh::packColor(blue);
+
+	float model[16];
+	CRenderBackend::identity(model);
+	CRenderBackend::scale(model, WATER_SCALE, 1.0f, WATER_SCALE);
+	renderer.drawLines(lines, model);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Def.h"	    // definitions
+
+extern int N;
+
+class CRenderBackend;
+
+#define GLYPH_SIDE			128		// Glyphs a side at most, past it each one stands for a square of cells
+#define GLYPH_MIN_LENGTH	0.1f	// Glyphs shorter than this much of the spacing between them are left out
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Class:	"CVelocityGlyphs"
+//
+// Purpose: The velocity debug view, a line from each cell's centre along its velocity, as one line list for a
+//			single draw. Above GLYPH_SIDE cells a side the glyphs are decimated: each stands for a square of
+//			getStride() cells, with their mean velocity, at the square's centre, so the view is at most GLYPH_SIDE^2
+//			lines whatever N is. The ones too short to see are culled. build() is two passes over the glyph rows,
+//			both in parallel: the means and how many of each row are kept, then, once the rows' starts are summed,
+//			the lines themselves. No GL in here.
+//
+// Usage:	build from the solver's velocity each frame the view is on, then render.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class CVelocityGlyphs
+{
+
+private:
+
+	float	(*m_samples)[2];	// The glyphs' mean velocity, m_side rows of m_side
+	int		*m_rowStarts;		// First line of each glyph row, and the count after the last
+	float	(*m_vertices)[3];	// Two a line
+	int		m_n;				// The N the arrays are for
+	int		m_side;
+	int		m_stride;
+	int		m_lines;
+
+	int allocate(int n);
+	void freeGlyphs(void);
+
+	CVelocityGlyphs(const CVelocityGlyphs&);
+	CVelocityGlyphs&operator = (const CVelocityGlyphs&);
+
+public:
+
+	CVelocityGlyphs(void);
+	~CVelocityGlyphs(void);
+
+	// The lines for velocity u, v (VIX indexed), 0 when out of memory
+	int build(const float *u, const float *v);
+	// Draws them in the surface's frame, x and z scaled by WATER_SCALE
+	void render(CRenderBackend &renderer);
+
+	int getLineCount(void) const	{ return m_lines; }
+	int getStride(void) const		{ return m_stride; }	// Cells a side each glyph stands for
+	const float *getVertices(void) const	{ return m_vertices ? &m_vertices[0][0] : 0; }
+};
@@ -1,6 +1,7 @@
-#include ".\weather.h"
+#include "Weather.h"
+#include "Profiler.h"
 
-extern N;
+extern int N;
 
 #include <cmath>
 
@@ -22,8 +23,9 @@ CWeather::~CWeather(void)
 {
 }
 
-void CWeather::applyWind(float *u, float *v)
+void CWeather::applyWind(float *u, float *v, CRandom &random)
 {	
+	PROFILE_ZONE("weather wind");
 	switch(m_windDirection)
 	{
 	case center:
@@ -36,20 +38,21 @@ void CWeather::applyWind(float *u, float *v)
 		break;
 	case down:
 		{
-			int i = rand() % N;
-			int j = rand() % N;
-
-			v[IX(i,j)] -= (rand() % (m_windIntensity + 1)) / 10.0f;
-			v[IX(i+1,j+1)] -= (rand() % (m_windIntensity + 1)) / 10.0f;
-			v[IX(i,j+2)] -= (rand() % (m_windIntensity + 1)) / 10.0f;
-			v[IX(i+1,j+3)] -= (rand() % (m_windIntensity + 1)) / 10.0f;
-			v[IX(i,j+4)] -= (rand() % (m_windIntensity + 1)) / 10.0f;
-			v[IX(i+1,j+5)] -= (rand() % (m_windIntensity + 1)) / 10.0f;
-
-			if(rand()%2==0)
-				u[IX(i,j)] += (rand() % (m_windTurbulence + 1)) / 10.0f;
+			// Keep the streak (one cell across, five down) inside the grid
+			int i = random.below(N-1);
+			int j = random.below(N-4);
+
+			v[VIX(i,j)] -= random.below(m_windIntensity + 1) / 10.0f;
+			v[VIX(i+1,j+1)] -= random.below(m_windIntensity + 1) / 10.0f;
+			v[VIX(i,j+2)] -= random.below(m_windIntensity + 1) / 10.0f;
+			v[VIX(i+1,j+3)] -= random.below(m_windIntensity + 1) / 10.0f;
+			v[VIX(i,j+4)] -= random.below(m_windIntensity + 1) / 10.0f;
+			v[VIX(i+1,j+5)] -= random.below(m_windIntensity + 1) / 10.0f;
+
+			if(random.below(2) == 0)
+				u[VIX(i,j)] += random.below(m_windTurbulence + 1) / 10.0f;
 			else
-				u[IX(i,j)] -= (rand() % (m_windTurbulence + 1)) / 10.0f;
+				u[VIX(i,j)] -= random.below(m_windTurbulence + 1) / 10.0f;
 		}
 		break;
 	case leftDown:
@@ -63,18 +66,20 @@ void CWeather::applyWind(float *u, float *v)
 	}
 }
 
-void CWeather::applyRain(float *d, float *u, float *v)
+void CWeather::applyRain(float *d, float *u, float *v, CRandom &random)
 {	
-	int i = rand() % N;
-	int j = rand() % N;
+	PROFILE_ZONE("weather rain");
+	int i = random.below(N);
+	int j = random.below(N);
 
-	u[IX(i,j)] -= ((rand() % m_rainIntensity) + 1) / 100.0f;
-	v[IX(i,j)] -= ((rand() % m_rainIntensity) + 1) / 100.0f;
-	d[IX(i,j)] += ((rand() % m_rainIntensity) + 1) / 100.0f;
+	u[VIX(i,j)] -= (random.below(m_rainIntensity) + 1) / 100.0f;
+	v[VIX(i,j)] -= (random.below(m_rainIntensity) + 1) / 100.0f;
+	d[IX(i,j)] += (random.below(m_rainIntensity) + 1) / 100.0f;
 }
 
-void CWeather::applyWaves(float *d, float *u, float *v)
+void CWeather::applyWaves(float *d, float *u, float *v, CRandom &random)
 {	
+	PROFILE_ZONE("weather waves");
 	int i, j;
 	switch(m_waveDirection)
 	{
@@ -91,21 +96,27 @@ void CWeather::applyWaves(float *d, float *u, float *v)
 			m_waveIntensity += 0.005f;		
 
 			int i = N-1;
-			int j = rand() % N + 1;
+
+			// A draw per row, fetched RANDOM_BATCH at a time. Row j gets draw first + j however they are computed
+			unsigned int draws[RANDOM_BATCH];
+			long long first = random.reserve(N);
 
 			for(j = 0; j < N; j++)
 			{
+				if(j % RANDOM_BATCH == 0)
+					random.fill(first + j, draws, N - j < RANDOM_BATCH ? N - j : RANDOM_BATCH);
+
 				if(m_deepWaves)
 					d[IX(i,j)] = (wave)*3;
 				else
-					d[IX(i,j)] = abs(wave)*2.5;
-
-				float push = -(rand() % m_waveTurbulence);
-				u[IX(i,j)] = push;
-				//u[IX(i-1,j)] = push;
-				//u[IX(i-2,j)] = push;
-				//u[IX(i-3,j)] = push;
-				//u[IX(i-4,j)] = push;
+					d[IX(i,j)] = fabs(wave)*2.5;
+
+				float push = -CRandom::below(draws[j % RANDOM_BATCH], m_waveTurbulence);
+				u[VIX(i,j)] = push;
+				//u[VIX(i-1,j)] = push;
+				//u[VIX(i-2,j)] = push;
+				//u[VIX(i-3,j)] = push;
+				//u[VIX(i-4,j)] = push;
 			}
 		}
 		break;
@@ -1,11 +1,13 @@
 #pragma once
 
 #include "Def.h"
-#include <windows.h>    // windows crap, I need that for the rand() function
+#include "Random.h"	    // counter-based draws
 
 class CWeather
 {
 
+	friend class CCheckpoint;
+
 	int m_windDirection;
 	int m_windIntensity;
 	int m_windTurbulence;
@@ -22,9 +24,10 @@ public:
 	CWeather(void);
 	virtual ~CWeather(void);
 
-	void applyWind(float *u, float *v);
-	void applyRain(float *d, float *u, float *v);
-	void applyWaves(float *d, float *u, float *v);
+	// The draws come from the sim's generator
+	void applyWind(float *u, float *v, CRandom &random);
+	void applyRain(float *d, float *u, float *v, CRandom &random);
+	void applyWaves(float *d, float *u, float *v, CRandom &random);
 
 	void intensityIncreace(bool increace) {if(increace) m_rainIntensity++; else if(m_rainIntensity - 1 > 0) m_rainIntensity--;}
 	int getWindDirection(void)	{ return m_windDirection; }
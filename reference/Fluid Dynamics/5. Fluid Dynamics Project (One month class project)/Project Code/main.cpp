@@ -5,7 +5,6 @@
 #include "Def.h"	  // definitions
 #include "Demo.h"	  // demo class
 
-int N; // Made global to comply with original source code
 
 //----------------------------------------------------------------------
 // GLUT callback routines
@@ -85,6 +84,28 @@ static void key_func ( unsigned char key, int x, int y )
 		case 'W':
 			pDemo->toggleWireFrame();
 			break;
+		case 'o':
+		case 'O':
+			pDemo->toggleLod();
+			break;
+		// Flow view
+		case 'n':
+		case 'N':
+			pDemo->toggleFlow();
+			break;
+		case 'm':
+		case 'M':
+			pDemo->saveFlow();
+			break;
+		// Mesh resolution
+		case 'u':
+		case 'U':
+			pDemo->cycleMeshSize();
+			break;
+		case 'y':
+		case 'Y':
+			pDemo->toggleResampleFilter();
+			break;
 		// Rain toggle
 		case 'r':
 		case 'R':
@@ -109,6 +130,38 @@ static void key_func ( unsigned char key, int x, int y )
 			pDemo->rainSpreadIncreace(true);
 			break;
 
+		// Profiler
+		case 'f':
+		case 'F':
+			pDemo->exportTrace();
+			break;
+		case 'h':
+		case 'H':
+			pDemo->dumpFrameStats();
+			break;
+
+		// Checkpoint
+		case 'k':
+		case 'K':
+			pDemo->saveCheckpoint();
+			break;
+		case 'l':
+		case 'L':
+			pDemo->loadCheckpoint();
+			break;
+
+		// Field recording
+		case 'e':
+		case 'E':
+			pDemo->toggleRecording();
+			break;
+
+		// Input log
+		case 'i':
+		case 'I':
+			pDemo->toggleInputLog();
+			break;
+
 		case 'q':
 		case 'Q':
 			// The data is being freed in the demo destructor
@@ -122,14 +175,9 @@ static void reshape_func ( int width, int height )
 	if(0 == height)
 		height = 1;
 
-	glViewport(0, 0, width, height);
-
-	glMatrixMode(GL_PROJECTION);
-	glLoadIdentity();
-	gluPerspective(35.0f, float(width) / float(height), 1.0f, 500.0f);
-
-	glMatrixMode(GL_MODELVIEW);
-	glLoadIdentity();
+	// Viewport and perspective
+	CDemo *pDemo = &(CDemo::get());
+	pDemo->resize(width, height);
 
 	glutReshapeWindow ( width, height );
 }
@@ -144,10 +192,7 @@ static void idle_func ( void )
 
 static void display_func ( void )
 {
-	// I know that I am already in model view mode and in the identity matrix (because of the end of ChangeSize)
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-	// Render
+	// Render, clearing included
 	CDemo *pDemo = &(CDemo::get());
 	pDemo->render();
 
@@ -158,7 +203,6 @@ static void display_func ( void )
 // One time setup
 void SetupGL(void)
 {
-	glClearColor(0.3f, 0.3f, 0.3f, 0.0f);
 	//glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 	glEnable(GL_DEPTH_TEST);
 
@@ -204,6 +248,7 @@ void ShutdownGL(void)
 
 int main(int argc, char *argv[])
 {
+	PROFILE_THREAD_NAME("main");
 	glutInit(&argc, argv);
 	glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
 	glutInitWindowSize(WINDOW_WIDTH, WINDOW_HEIGHT);
@@ -227,11 +272,20 @@ int main(int argc, char *argv[])
 	printf ( "\t Clear the simulation by pressing the 'c' key\n\n" );
 	printf ( "\t Decrease densities randomly by pressing the 't' key\n\n" );
 	printf ( "\t Toggle wireframe mode with the 'w' key\n\n" );
+	printf ( "\t Toggle the surface's level of detail with the 'o' key (wireframe shows it)\n\n" );
 	printf ( "\t Toggle rain with the 'r' key\n\n" );
 	printf ( "\t Press 'p', ';', '[' and ''' to affect the rain\n\n" );
 	printf ( "\t Press 'a' to lower the sails and stop the ship\n\n" );
 	printf ( "\t Press backspace to turn on vector lines (visible on 2D mode)\n\n" );
+	printf ( "\t Press 'n' to colour the water with the flow's streaks and 'm' to write them to flow.png\n\n" );
+	printf ( "\t Press 'u' to draw the water at 1/2, 1, 2 or 4 times the grid's resolution, 'y' for bicubic or bilinear\n\n" );
 	printf ( "\t Use '/'. '*' and 0987654321 on the numpad to move the camera\n\n" );
+	printf ( "\t Press 'f' to write the profiler zones to trace.json (Debug builds)\n\n" );
+	printf ( "\t Press 'h' for the frame time percentiles and slow frames (also in frame_stats.txt)\n\n" );
+	printf ( "\t Press 'k' to save the simulation to checkpoint.lck and 'l' to load it back\n\n" );
+	printf ( "\t Press 'e' to start and stop recording the fields to recording.lrec (see field_player)\n\n" );
+	printf ( "\t Press 'i' to start and stop logging your input to session.llog (see input_replay)\n\n" );
+	printf ( "\t Live stats: curl http://127.0.0.1:7007/ or fluid_stats\n\n" );
 
 	SetupGL();
 	glutMainLoop();